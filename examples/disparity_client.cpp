@@ -0,0 +1,75 @@
+// local client of the disparity daemon (light-field-disparity --serve <socket>), only needs utils/daemon_protocol.hpp
+#include "utils/daemon_protocol.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::printf("usage: %s <socket> [--repeat N] [--concurrency C] <request...>\n", argv[0]);
+        std::printf("  e.g. %s /tmp/lfd.sock compute scene=benchmark/training/cotton output=cotton.pfm\n", argv[0]);
+        std::printf("       %s /tmp/lfd.sock query scene=benchmark/training/cotton points=100,120;240,64 rects=0,0,32,32\n", argv[0]);
+        std::printf("       %s /tmp/lfd.sock metrics\n", argv[0]);
+        return 1;
+    }
+    std::string socketPath = argv[1];
+    uint32_t nRepeats = 1, nConcurrent = 1;
+    std::string request;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc) nRepeats = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--concurrency" && i + 1 < argc) nConcurrent = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else request += (request.empty() ? "" : " ") + arg;
+    }
+
+    // every client thread keeps its own connection and sends its requests one after another
+    std::mutex mutex;
+    std::vector<double> latencies;
+    uint32_t nErrors = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (uint32_t iClient = 0; iClient < nConcurrent; iClient++) {
+        clients.emplace_back([&]() {
+            int fd = DaemonSocket::connect_to(socketPath);
+            if (fd < 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::printf("no daemon on %s\n", socketPath.c_str());
+                nErrors += nRepeats;
+                return;
+            }
+            std::string buffer, reply;
+            for (uint32_t i = 0; i < nRepeats; i++) {
+                auto sent = std::chrono::steady_clock::now();
+                if (!DaemonSocket::write_line(fd, request) || !DaemonSocket::read_line(fd, buffer, reply)) reply = "error connection closed";
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (nConcurrent * nRepeats == 1) std::printf("%s\n", reply.c_str());
+                if (reply.compare(0, 2, "ok") == 0) latencies.push_back(ms);
+                else {
+                    if (nConcurrent * nRepeats > 1) std::printf("%s\n", reply.c_str());
+                    nErrors++;
+                }
+                if (reply == "error connection closed") break;
+            }
+            close(fd);
+        });
+    }
+    for (std::thread& client : clients) client.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (nConcurrent * nRepeats > 1 && !latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        double sum = 0.0;
+        for (double ms : latencies) sum += ms;
+        std::printf("%zu requests (%u failed) in %.3f s, %.1f requests/s, latency mean %.3f ms, p50 %.3f ms, p99 %.3f ms\n",
+            latencies.size(), nErrors, seconds, latencies.size() / seconds, sum / latencies.size(),
+            latencies[latencies.size() / 2], latencies[std::min(latencies.size() - 1, (size_t)(0.99 * latencies.size()))]);
+    }
+    return nErrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,58 @@
+// example consumer of published disparity maps (light-field-disparity --publish <name>), only needs utils/shm_ring.hpp
+#include "utils/shm_ring.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::printf("usage: %s <name> [frames]\n", argv[0]);
+        return 1;
+    }
+    uint64_t nFrames = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0;
+
+    // wait for the publisher to create the ring
+    ShmRingReader reader;
+    for (uint32_t i = 0; i < 100 && !reader.open(argv[1]); i++) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (!reader.is_open()) {
+        std::printf("no disparity published as %s\n", argv[1]);
+        return 1;
+    }
+    const ShmRing::Header* pHeader = reader.get_header();
+    std::printf("%s: %ux%u, %u slots\n", argv[1], pHeader->width, pHeader->height, pHeader->nSlots);
+
+    uint64_t iPublished = 0, nRead = 0, nTorn = 0, nSkipped = 0;
+    double ageSum = 0.0, ageMax = 0.0;
+    ShmRingReader::Frame frame;
+    while ((nFrames == 0 || nRead < nFrames) && reader.wait_next(frame, iPublished, 5000)) {
+        double ageUs = (ShmRing::get_time_ns() - frame.timestampNs) / 1000.0;
+
+        // texels are float4: raw estimate, confidence, uncertain (> 0.5) and the filtered disparity, read in place
+        const float* pTexels = reinterpret_cast<const float*>(frame.pData);
+        double sum = 0.0;
+        uint64_t nCertain = 0;
+        for (uint64_t i = 0; i < (uint64_t)frame.width * frame.height; i++) {
+            if (pTexels[4 * i + 2] > 0.5f) continue;
+            sum += pTexels[4 * i + 3];
+            nCertain++;
+        }
+        // the ring wrapped around while reading, the next frame is newer anyway
+        if (!reader.is_intact(frame)) {
+            nTorn++;
+            continue;
+        }
+
+        if (iPublished > 0) nSkipped += frame.iPublished - iPublished - 1;
+        iPublished = frame.iPublished;
+        nRead++;
+        ageSum += ageUs;
+        ageMax = std::max(ageMax, ageUs);
+        std::printf("frame %llu: mean disparity %.4f (%llu certain pixels), published %.1f us ago\n",
+            (unsigned long long)frame.iFrame, nCertain > 0 ? sum / nCertain : 0.0, (unsigned long long)nCertain, ageUs);
+    }
+    if (nRead > 0) {
+        std::printf("read %llu frames (%llu skipped, %llu torn), age when picked up mean %.1f us, max %.1f us\n",
+            (unsigned long long)nRead, (unsigned long long)nSkipped, (unsigned long long)nTorn, ageSum / nRead, ageMax);
+    }
+    return 0;
+}
@@ -4,54 +4,324 @@
 #include "window/input.hpp"
 #include "device/device_manager.hpp"
 #include "renderer/renderer.hpp"
+#include "renderer/render_thread.hpp"
+#include "renderer/multi_device_compute.hpp"
+#include "renderer/disparity_server.hpp"
 #include "renderer/push_constants.hpp"
+#include "utils/arguments.hpp"
+#include "utils/job_graph.hpp"
 
 class Application
 {
 public:
-	Application() {
+	Application(Arguments args) : args(args) {
+		if (!args.traceFile.empty()) Trace::enable();
+		TRACE_SCOPE("Application::startup");
 		VMI_LOG("[Initializing] Independent vulkan functions...");
 		vk::DynamicLoader dl;
 		PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = dl.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
 		VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
 
-		window.init(512, 512);
-		deviceManager.init(window.get_vulkan_instance(), window.get_vulkan_surface());
-		renderer.init(deviceManager.get_device_wrapper(), window);
+		JobGraph startup = create_startup_jobs();
+		startup.run(std::clamp(std::thread::hardware_concurrency(), 1u, 4u));
+		startup.log_critical_path("Startup");
+		pcs.nSteps = args.nSteps;
+		pcs.filterRadius = args.filterRadius;
+		pcs.filterEdges = args.filterEdges;
+		if (!args.headless) {
+			// ui side copy of the estimator state, the renderer only receives it through snapshots
+			estimatorName = renderer.get_estimator().get_name();
+			estimatorParameters = renderer.get_estimator().get_parameters();
+			windowSize = window.get_size();
+		}
 		VMI_LOG("[Initialization Complete]" << std::endl);
 	}
 	~Application() {
-		deviceManager.get_logical_device().waitIdle();
-		renderer.destroy(deviceManager.get_device_wrapper());
+		renderThread.stop();
+		deviceManager.wait_idle();
+		if (args.multiDevice) multiDeviceCompute.destroy();
+		else renderer.destroy(deviceManager.get_device_wrapper());
 
 		deviceManager.destroy();
 		window.destroy();
+
+		if (!args.traceFile.empty()) Trace::write(args.traceFile);
 	}
 
 public:
 	void run() {
-		while (update()) {}
+		if (args.multiDevice) run_multi_device();
+		else if (!args.serveSocket.empty()) run_daemon();
+		else if (!args.batchFile.empty()) run_batch();
+		else if (!args.reportFile.empty()) run_report();
+		else if (!args.streamSource.empty()) run_stream();
+		else if (args.autotune) run_autotune();
+		else if (args.headless) run_headless();
+		else {
+			// from here on only the render thread touches the device
+			renderThread.start(deviceManager.get_device_wrapper(), renderer, window);
+			while (update()) {}
+			renderThread.stop();
+		}
 	}
 
 private:
+	// independent startup steps run concurrently: the scene is decoded while the device is created,
+	// compute and display pipelines compile while the light field uploads, and imgui sets up next to them
+	JobGraph create_startup_jobs() {
+		JobGraph jobs;
+		// SDL windows belong to the main thread, the headless window only holds the instance and its surface stays null
+		JobGraph::JobId windowJob = jobs.add("Window::init", {}, [this]() {
+			if (args.headless) window.init_headless(512, 512);
+			else window.init(512, 512);
+		}, true);
+		if (args.multiDevice) {
+			// bands of one disparity map on every suitable device, the renderer stays unused
+			JobGraph::JobId devicesJob = jobs.add("DeviceManager::init_multi", { windowJob }, [this]() {
+				deviceManager.init_multi(window.get_vulkan_instance(), args.nDevices);
+			});
+			jobs.add("MultiDeviceCompute::init", { devicesJob }, [this]() { multiDeviceCompute.init(deviceManager.get_device_wrappers(), window, args); });
+			return jobs;
+		}
+
+		// the light field is decoded on the host while the device is created, batches, streams and the daemon load their light fields later
+		bool scene = args.batchFile.empty() && args.streamSource.empty() && args.serveSocket.empty();
+		JobGraph::JobId decodeJob = scene ? jobs.add("Renderer::decode_light_field", {}, [this]() { renderer.decode_light_field(); }) : 0;
+		JobGraph::JobId deviceJob = jobs.add("DeviceManager::init", { windowJob }, [this]() {
+			deviceManager.init(window.get_vulkan_instance(), window.get_vulkan_surface());
+		});
+		JobGraph::JobId setupJob = jobs.add("Renderer::init_setup", { deviceJob }, [this]() {
+			renderer.init_setup(deviceManager.get_device_wrapper(), window, args);
+		});
+		if (!scene) return jobs;
+
+		// exports are always computed at the native light field resolution
+		JobGraph::JobId framesJob = jobs.add("Renderer::create_frames", { setupJob }, [this]() {
+			renderer.create_frames(deviceManager.get_device_wrapper(), args.headless ? 1.0f : args.previewScale);
+		});
+		JobGraph::JobId uploadJob = jobs.add("Renderer::upload_light_field", { decodeJob, framesJob }, [this]() {
+			renderer.upload_light_field(deviceManager.get_device_wrapper());
+		});
+		JobGraph::JobId computeJob = jobs.add("Renderer::create_compute_pipelines", { framesJob }, [this]() {
+			renderer.create_compute_pipelines(deviceManager.get_device_wrapper());
+		});
+		if (args.headless) {
+			jobs.add("Renderer::create_metrics", { uploadJob, computeJob }, [this]() { renderer.create_metrics(deviceManager.get_device_wrapper()); });
+			return jobs;
+		}
+		JobGraph::JobId displayJob = jobs.add("Renderer::create_display", { framesJob }, [this]() {
+			renderer.create_display(deviceManager.get_device_wrapper());
+		});
+		// the font upload submits to the graphics queue, which the light field upload may share (queues are externally synchronized)
+		jobs.add("Renderer::create_ui", { displayJob, uploadJob }, [this]() { renderer.create_ui(deviceManager.get_device_wrapper(), window); });
+		return jobs;
+	}
+	void run_headless() {
+		DeviceWrapper& device = deviceManager.get_device_wrapper();
+
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < args.nFrames; i++) {
+			TRACE_SCOPE("Application::compute");
+			renderer.compute(device, pcs);
+		}
+		device.logicalDevice.waitIdle();
+		auto end = std::chrono::steady_clock::now();
+
+		double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		VMI_LOG("Computed " << args.nFrames << " frames in " << ms << " ms (" << ms / args.nFrames << " ms/frame, " << args.nFramesInFlight << " in flight)");
+
+		if (!args.outputPath.empty()) renderer.export_disparity(device, args.outputPath);
+		if (renderer.has_ground_truth()) {
+			DisparityMetrics::Metrics metrics = renderer.evaluate(device);
+			VMI_LOG("MSE*100 " << metrics.mseX100 << ", BadPix(0.01) " << metrics.badPix[0] << "%, BadPix(0.03) " << metrics.badPix[1]
+				<< "%, BadPix(0.07) " << metrics.badPix[2] << "%");
+		}
+		renderer.log_memory_usage(device);
+
+		renderer.collect_profiler(device);
+		for (const ProfilerStats::Pass& pass : renderer.get_profiler_stats().get_passes()) {
+			VMI_LOG("    " << pass.name << ": min " << pass.min() << " ms, mean " << pass.mean() << " ms, p99 " << pass.p99() << " ms");
+		}
+	}
+	void run_autotune() {
+		renderer.autotune(deviceManager.get_device_wrapper(), pcs, std::max(args.nFrames, 10u), args.tuningFile);
+	}
+	void run_batch() {
+		DeviceWrapper& device = deviceManager.get_device_wrapper();
+		if (!args.outputPath.empty()) std::filesystem::create_directories(args.outputPath);
+		renderer.process_batch(device, Arguments::read_scenes(args.batchFile), pcs, args.outputPath);
+
+		for (const ProfilerStats::Pass& pass : renderer.get_profiler_stats().get_passes()) {
+			VMI_LOG("    " << pass.name << ": min " << pass.min() << " ms, mean " << pass.mean() << " ms, p99 " << pass.p99() << " ms");
+		}
+	}
+	void run_stream() {
+		DeviceWrapper& device = deviceManager.get_device_wrapper();
+		std::unique_ptr<LightFieldSource> pSource;
+		if (args.streamSource.rfind("unix:", 0) == 0) {
+			auto pSocket = std::make_unique<SocketSource>();
+			if (!pSocket->init(args.streamSource.substr(5))) return;
+			pSource = std::move(pSocket);
+		}
+		else {
+			auto pFolder = std::make_unique<FolderSource>();
+			if (!pFolder->init(args.streamSource, renderer.get_light_field_indices())) return;
+			pSource = std::move(pFolder);
+		}
+		if (!args.outputPath.empty()) std::filesystem::create_directories(args.outputPath);
+		LightFieldStream::Policy policy = args.streamDropOldest ? LightFieldStream::Policy::eDropOldest : LightFieldStream::Policy::eBlock;
+		renderer.process_stream(device, std::move(pSource), pcs, args.nStreamSlots, policy, args.nDecoders, args.outputPath);
+
+		renderer.collect_profiler(device);
+		for (const ProfilerStats::Pass& pass : renderer.get_profiler_stats().get_passes()) {
+			VMI_LOG("    " << pass.name << ": min " << pass.min() << " ms, mean " << pass.mean() << " ms, p99 " << pass.p99() << " ms");
+		}
+	}
+	// device, pipelines and caches stay initialized while requests come and go, requests that arrive together share one bindless submission
+	void run_daemon() {
+		DeviceWrapper& device = deviceManager.get_device_wrapper();
+		if (!renderer.init_batch(device)) return;
+		DisparityServer server;
+		if (!server.init(args.serveSocket, renderer.get_light_field_indices(), pcs)) return;
+
+		uint32_t nMaxJobs = DisparityBatch::get_max_scenes(device);
+		while (true) {
+			std::vector<std::shared_ptr<DisparityServer::Job>> jobs = server.next_batch(args.batchWindowMs, nMaxJobs);
+			if (jobs.empty()) break;
+			TRACE_SCOPE("Application::daemon_batch");
+
+			// push constants apply to a whole dispatch, so requests with different parameters are computed in separate batches,
+			// queries only run the groups covering their points and rectangles, one after another
+			std::map<uint64_t, std::vector<std::shared_ptr<DisparityServer::Job>>> groups;
+			for (std::shared_ptr<DisparityServer::Job>& pJob : jobs) {
+				if (!pJob->is_query()) {
+					groups[Hash::combine(Hash::seed, pJob->pcs)].push_back(pJob);
+					continue;
+				}
+				Renderer::BatchScene scene = { "", pJob->lightField.data(), pJob->extent };
+				std::vector<DisparityQuery::Result> results = renderer.query_disparity(device, pJob->points, pJob->rects, &scene, &pJob->computeMs);
+				pJob->disparity.resize(results.size() * 4);
+				if (!results.empty()) memcpy(pJob->disparity.data(), results.data(), results.size() * sizeof(DisparityQuery::Result));
+				pJob->disparityExtent = vk::Extent3D((uint32_t)results.size(), 1, 1);
+				pJob->batchSize = 1;
+			}
+			for (auto& group : groups) {
+				std::vector<Renderer::BatchScene> scenes;
+				for (std::shared_ptr<DisparityServer::Job>& pJob : group.second) scenes.push_back({ "", pJob->lightField.data(), pJob->extent });
+				Renderer::BatchStats stats = renderer.compute_batch(device, scenes, group.second[0]->pcs, [&](size_t i, const std::vector<float>& data, vk::Extent3D extent) {
+					group.second[i]->disparity = data;
+					group.second[i]->disparityExtent = extent;
+				});
+				for (std::shared_ptr<DisparityServer::Job>& pJob : group.second) {
+					pJob->batchSize = (uint32_t)group.second.size();
+					pJob->computeMs = stats.computeMs;
+				}
+			}
+			server.complete(jobs);
+		}
+		server.destroy();
+	}
+	// accuracy and speed of every listed scene with ground truth, as one table
+	void run_report() {
+		DeviceWrapper& device = deviceManager.get_device_wrapper();
+		std::vector<std::string> scenes = Arguments::read_scenes(args.reportFile);
+
+		std::ostringstream header;
+		header << std::left << std::setw(24) << "scene" << std::right << std::setw(12) << "ms/frame" << std::setw(12) << "MSE*100";
+		for (float threshold : DisparityMetrics::badPixThresholds) header << std::setw(16) << "BadPix(" + std::to_string(threshold).substr(0, 4) + ")";
+		VMI_LOG(header.str());
+
+		uint32_t nEvaluated = 0;
+		double msSum = 0.0;
+		DisparityMetrics::Metrics sum = {};
+		for (const std::string& scene : scenes) {
+			renderer.load_scene(device, scene);
+			std::filesystem::path scenePath = std::filesystem::path(scene).lexically_normal();
+			std::string sceneName = scenePath.has_filename() ? scenePath.filename().string() : scenePath.parent_path().filename().string();
+			if (!renderer.has_ground_truth()) {
+				VMI_WARN("No ground truth for scene, skipped: " << scene);
+				continue;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < args.nFrames; i++) {
+				TRACE_SCOPE("Application::compute");
+				renderer.compute(device, pcs);
+			}
+			device.logicalDevice.waitIdle();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / std::max(args.nFrames, 1u);
+			DisparityMetrics::Metrics metrics = renderer.evaluate(device);
+
+			std::ostringstream row;
+			row << std::fixed << std::setprecision(3) << std::left << std::setw(24) << sceneName << std::right << std::setw(12) << ms << std::setw(12) << metrics.mseX100;
+			for (uint32_t i = 0; i < DisparityMetrics::nThresholds; i++) row << std::setw(16) << metrics.badPix[i];
+			VMI_LOG(row.str());
+
+			nEvaluated++;
+			msSum += ms;
+			sum.mseX100 += metrics.mseX100;
+			for (uint32_t i = 0; i < DisparityMetrics::nThresholds; i++) sum.badPix[i] += metrics.badPix[i];
+		}
+		if (nEvaluated == 0) return;
+
+		std::ostringstream row;
+		row << std::fixed << std::setprecision(3) << std::left << std::setw(24) << "mean" << std::right << std::setw(12) << msSum / nEvaluated << std::setw(12) << sum.mseX100 / nEvaluated;
+		for (uint32_t i = 0; i < DisparityMetrics::nThresholds; i++) row << std::setw(16) << sum.badPix[i] / nEvaluated;
+		VMI_LOG(row.str());
+	}
+	void run_multi_device() {
+		if (!multiDeviceCompute.is_ready()) return;
+		// one calibration run measures each device, the bands are then sized by throughput
+		multiDeviceCompute.compute(pcs);
+		multiDeviceCompute.rebalance();
+
+		double ms = 0.0;
+		for (uint32_t i = 0; i < args.nFrames; i++) {
+			TRACE_SCOPE("Application::compute");
+			ms += multiDeviceCompute.compute(pcs);
+		}
+		VMI_LOG("Computed " << args.nFrames << " frames in " << ms << " ms (" << ms / std::max(args.nFrames, 1u) << " ms/frame)");
+		multiDeviceCompute.log_bands();
+
+		if (!args.outputPath.empty()) multiDeviceCompute.export_disparity(args.outputPath);
+	}
+	// ui thread: input and ui of one frame, handed to the render thread as a snapshot
 	bool update() {
+		TRACE_SCOPE("Application::update");
 		// ImGui begin
 		ImGui_ImplVulkan_NewFrame();
 		ImGui_ImplSDL3_NewFrame();
 		ImGui::NewFrame();
 		
-		if (!poll_inputs()) return false;
+		if (!poll_inputs()) {
+			ImGui::EndFrame();
+			return false;
+		}
 		handle_inputs();
 		draw_ui();
 
-		renderer.render(deviceManager.get_device_wrapper(), pcs);
-		
 		// ImGui end
-		ImGui::EndFrame();
+		ImGui::Render();
+
+		// when every snapshot is still in flight, this ui frame is dropped and the next one carries its changes
+		uint64_t nFrames = renderThread.get_frame_count();
+		std::unique_ptr<FrameSnapshot> pSnapshot = renderThread.acquire();
+		if (pSnapshot) {
+			pSnapshot->pcs = pcs;
+			pSnapshot->estimator = estimatorName;
+			pSnapshot->estimatorParameters.clear();
+			for (const DisparityEstimator::Parameter& parameter : estimatorParameters) pSnapshot->estimatorParameters.push_back(parameter.value);
+			pSnapshot->windowSize = windowSize;
+			pSnapshot->ui.capture(ImGui::GetDrawData());
+			renderThread.submit(std::move(pSnapshot));
+		}
 
+		// no more ui frames than presented frames, but input is handled as soon as it arrives
+		renderThread.wait_for_frame(nFrames, 100);
 		return true;
 	}
 	bool poll_inputs() {
+		TRACE_SCOPE("poll_inputs");
 		input.flush();
 		SDL_Event sdlEvent;
 		while (SDL_PollEvent(&sdlEvent)) {
@@ -60,6 +330,11 @@ private:
 
 			switch (sdlEvent.type) {
 				case SDL_EVENT_QUIT: return false;
+				case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED: {
+					// applied by the render thread, which owns the swapchain
+					windowSize = { (uint32_t)sdlEvent.window.data1, (uint32_t)sdlEvent.window.data2 };
+					break;
+				}
 
 				case SDL_EVENT_MOUSE_BUTTON_DOWN:
 				case SDL_EVENT_MOUSE_BUTTON_UP: input.register_mouse_button_event(sdlEvent.button); break;
@@ -72,6 +347,7 @@ private:
 		return true;
 	}
 	void handle_inputs() {
+		if (input.keysPressed.count(SDLK_0)) pcs.nSteps = 0;
 		if (input.keysPressed.count(SDLK_1)) pcs.nSteps = 1;
 		if (input.keysPressed.count(SDLK_2)) pcs.nSteps = 2;
 		if (input.keysPressed.count(SDLK_3)) pcs.nSteps = 3;
@@ -81,17 +357,79 @@ private:
 		if (input.keysPressed.count(SDLK_7)) pcs.nSteps = 7;
 		if (input.keysPressed.count(SDLK_8)) pcs.nSteps = 8;
 		if (input.keysPressed.count(SDLK_9)) pcs.nSteps = 9;
+
+		// write the trace recorded so far
+		if (input.keysPressed.count(SDLK_F11) && !args.traceFile.empty()) Trace::write(args.traceFile);
 	}
 	void draw_ui() {
+		TRACE_SCOPE("draw_ui");
 		ImGui::Begin("Render Info");
 		ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+		ImGui::Text("Render thread: %.3f ms/iteration", renderThread.get_render_ms());
+		vk::Extent3D disparityExtent = renderer.get_disparity_extent();
+		ImGui::Text("Disparity: %ux%u (preview scale %.2f)", disparityExtent.width, disparityExtent.height, args.previewScale);
+
+		// estimator of phases 0 and 1, changing it or its parameters recomputes all phases
+		if (ImGui::BeginCombo("Estimator", estimatorName.c_str())) {
+			for (const std::string& name : EstimatorRegistry::get_names()) {
+				if (!ImGui::Selectable(name.c_str(), name == estimatorName) || name == estimatorName) continue;
+				// defaults of the new estimator, an instance without device resources is enough to query them
+				estimatorName = name;
+				estimatorParameters = EstimatorRegistry::create(name)->get_parameters();
+			}
+			ImGui::EndCombo();
+		}
+		for (DisparityEstimator::Parameter& parameter : estimatorParameters) {
+			ImGui::SliderFloat(parameter.name.c_str(), &parameter.value, parameter.min, parameter.max);
+		}
+
+		// post filter parameters, only the filter passes are recomputed when these change
+		int filterRadius = (int)pcs.filterRadius;
+		if (ImGui::SliderInt("Filter radius", &filterRadius, 0, (int)DisparityCompute::maxFilterRadius)) pcs.filterRadius = (uint32_t)filterRadius;
+		ImGui::SliderFloat("Filter edges", &pcs.filterEdges, 0.0f, 500.0f);
+
+		// pipeline image pool and the usage of every heap this process allocated from
+		ImGui::Text("Image pool: %.1f MiB", MemoryPools::to_mib(renderer.get_pool_size()));
+		std::vector<vma::Budget> budgets = renderer.get_memory_budgets(deviceManager.get_device_wrapper());
+		for (uint32_t i = 0; i < budgets.size(); i++) {
+			if (budgets[i].statistics.blockBytes == 0) continue;
+			ImGui::Text("Heap %u: %.1f MiB (%.1f / %.1f MiB used / budget)", i, MemoryPools::to_mib(budgets[i].statistics.blockBytes),
+				MemoryPools::to_mib(budgets[i].usage), MemoryPools::to_mib(budgets[i].budget));
+		}
+
+		// gpu timings over the most recent frames
+		if (ImGui::BeginTable("GPU passes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			ImGui::TableSetupColumn("Pass");
+			ImGui::TableSetupColumn("min ms");
+			ImGui::TableSetupColumn("mean ms");
+			ImGui::TableSetupColumn("p99 ms");
+			ImGui::TableSetupColumn("invocations");
+			ImGui::TableHeadersRow();
+			for (const ProfilerStats::Pass& pass : renderThread.get_passes()) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(pass.name.c_str());
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", pass.min());
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", pass.mean());
+				ImGui::TableNextColumn(); ImGui::Text("%.3f", pass.p99());
+				ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)pass.invocations);
+			}
+			ImGui::EndTable();
+		}
 		ImGui::End();
 	}
 
 private:
+	Arguments args;
 	Window window;
 	Input input;
 	DeviceManager deviceManager;
 	Renderer renderer;
+	RenderThread renderThread;
+	MultiDeviceCompute multiDeviceCompute;
 	PushConstants pcs;
+
+	// ui thread state that reaches the render thread through snapshots
+	std::string estimatorName;
+	std::vector<DisparityEstimator::Parameter> estimatorParameters;
+	std::pair<uint32_t, uint32_t> windowSize;
 };
\ No newline at end of file
@@ -6,6 +6,7 @@ class DeviceManager
 {
 public:
 	void init(vk::Instance& instance, vk::SurfaceKHR& surface) {
+		TRACE_SCOPE("DeviceManager::init");
 		VMI_LOG("[Initializing] Device manager...");
 		std::vector<vk::PhysicalDevice> physicalDevices = instance.enumeratePhysicalDevices();
 		if (physicalDevices.empty()) VMI_ERR("Failed to find a GPUs with Vulkan support.");
@@ -26,13 +27,60 @@ public:
 		get_device_wrapper().create_logical_device();
 
 	}
+	// one compute-only logical device per suitable adapter, adapters are reused in turn until there are at least nMinDevices,
+	// so two logical devices on a single (software) driver exercise the same path as a multi gpu system
+	void init_multi(vk::Instance& instance, uint32_t nMinDevices) {
+		TRACE_SCOPE("DeviceManager::init_multi");
+		VMI_LOG("[Initializing] Device manager (multi-device)...");
+		std::vector<vk::PhysicalDevice> physicalDevices = instance.enumeratePhysicalDevices();
+		if (physicalDevices.empty()) VMI_ERR("Failed to find a GPUs with Vulkan support.");
+
+		vk::SurfaceKHR surface = nullptr;
+		std::vector<DeviceWrapper> suitableDevices;
+		for (vk::PhysicalDevice physicalDevice : physicalDevices) {
+			DeviceWrapper device(physicalDevice, surface);
+			if (device.get_compute_score() >= 0) suitableDevices.push_back(device);
+		}
+		if (suitableDevices.empty()) {
+			VMI_ERR("Failed to find a suitable GPU.");
+			return;
+		}
+		std::stable_sort(suitableDevices.begin(), suitableDevices.end(),
+			[](DeviceWrapper& a, DeviceWrapper& b) { return a.get_compute_score() > b.get_compute_score(); });
+
+		devices = suitableDevices;
+		while (devices.size() < nMinDevices) devices.push_back(suitableDevices[devices.size() % suitableDevices.size()]);
+
+		std::string spacing = "    ";
+		VMI_LOG(spacing << "Chosen devices:");
+		for (DeviceWrapper& device : devices) {
+			VMI_LOG(spacing << "- " << device.deviceProperties.deviceName);
+			device.create_logical_device(false);
+		}
+		iCurrentDevice = 0;
+	}
 	void destroy() {
-		get_device_wrapper().destroy_logical_device();
+		for (DeviceWrapper& device : devices) {
+			if (device.logicalDevice) device.destroy_logical_device();
+		}
+	}
+	void wait_idle() {
+		for (DeviceWrapper& device : devices) {
+			if (device.logicalDevice) device.logicalDevice.waitIdle();
+		}
 	}
 
 	inline vk::PhysicalDevice get_physical_device() { return devices[iCurrentDevice].physicalDevice; }
 	inline vk::Device get_logical_device() { return devices[iCurrentDevice].logicalDevice; }
 	inline DeviceWrapper& get_device_wrapper() { return devices[iCurrentDevice]; }
+	// every device with a logical device (all of them after init_multi)
+	std::vector<DeviceWrapper*> get_device_wrappers() {
+		std::vector<DeviceWrapper*> wrappers;
+		for (DeviceWrapper& device : devices) {
+			if (device.logicalDevice) wrappers.push_back(&device);
+		}
+		return wrappers;
+	}
 
 private:
 	void pick_best_physical_device(vk::SurfaceKHR& surface)
@@ -3,18 +3,21 @@
 class DeviceWrapper
 {
 public:
+	// a null surface creates a headless (compute-only) device without presentation support
 	DeviceWrapper(vk::PhysicalDevice& physicalDevice, vk::SurfaceKHR& surface) :
-		physicalDevice(physicalDevice), iGraphicsQueue(UINT32_MAX), iComputeQueue(UINT32_MAX), iTransferQueue(UINT32_MAX)
+		physicalDevice(physicalDevice), iGraphicsQueue(UINT32_MAX), iComputeQueue(UINT32_MAX), iTransferQueue(UINT32_MAX),
+		headless(!surface)
 	{
 		physicalDevice.getProperties(&deviceProperties);
 		physicalDevice.getFeatures(&deviceFeatures);
 		physicalDevice.getMemoryProperties(&deviceMemProperties);
 
-		query_swapchain_support_details(surface);
+		if (!headless) query_swapchain_support_details(surface);
 		assign_queue_family_index(surface);
 	}
 
 	int32_t get_device_score() {
+		if (headless) return get_compute_score();
 		int32_t deviceScore = 0;
 
 		// Discrete GPUs have a significant performance advantage
@@ -27,17 +30,38 @@ public:
 		else if (formats.empty() || presentModes.empty()) return -1;
 		else return deviceScore;
 	}
-	void create_logical_device() {
+	int32_t get_compute_score() {
+		if (iComputeQueue == UINT32_MAX) return -1;
+		int32_t deviceScore = 0;
+
+		// software rasterizers are valid fallbacks, but should never win against actual hardware
+		if (deviceProperties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu) deviceScore += 1000;
+		if (deviceProperties.deviceType == vk::PhysicalDeviceType::eCpu) deviceScore -= 1000;
+
+		// larger workgroups and shared memory allow for bigger compute patches
+		deviceScore += deviceProperties.limits.maxComputeWorkGroupInvocations;
+		deviceScore += deviceProperties.limits.maxComputeSharedMemorySize / 1024;
+		return std::max(deviceScore, 0);
+	}
+	// device level functions are only loaded into the global dispatcher for a single device,
+	// with several devices (possibly from different drivers) all calls go through the loader instead
+	void create_logical_device(bool loadDeviceFunctions = true) {
+		TRACE_SCOPE("vkCreateDevice");
 		std::string spacing = "    ";
 		VMI_LOG(spacing << "Required device extensions:");
-		std::vector<const char*> requiredDeviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+		std::vector<const char*> requiredDeviceExtensions;
+		if (!headless) requiredDeviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 		for (const auto& extension : requiredDeviceExtensions) VMI_LOG(spacing << "- " << extension);
 		VMI_LOG("");
 
 		VMI_LOG(spacing << "Optional device extensions:");
 		std::vector<const char*> optionalDeviceExtensions = {
 			VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
-			VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME
+			VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME,
+			VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, // bindless batch processing
+			VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, // actual heap usage and budget for the memory reports
+			VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME, // copies straight into shared memory for published disparity maps
+			VK_EXT_HOST_QUERY_RESET_EXTENSION_NAME // upload timings on transfer families, which can't reset query pools themselves
 		};
 		for (const auto& extension : optionalDeviceExtensions) VMI_LOG(spacing << "- " << extension);
 		VMI_LOG("");
@@ -55,7 +79,50 @@ public:
 		for (const auto& extension : requiredDeviceExtensions) VMI_LOG(spacing << "- " << extension);
 
 		vk::PhysicalDeviceFeatures deviceFeatures = vk::PhysicalDeviceFeatures()
-			.setShaderStorageImageReadWithoutFormat(true);
+			.setShaderStorageImageReadWithoutFormat(true)
+			.setPipelineStatisticsQuery(this->deviceFeatures.pipelineStatisticsQuery) // optional, used by the gpu profiler
+			.setShaderSampledImageArrayDynamicIndexing(this->deviceFeatures.shaderSampledImageArrayDynamicIndexing)
+			.setShaderStorageImageArrayDynamicIndexing(this->deviceFeatures.shaderStorageImageArrayDynamicIndexing);
+
+		// runtime sized, partially bound image arrays for the batched disparity pipeline
+		vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures;
+		vk::PhysicalDeviceHostQueryResetFeaturesEXT hostQueryResetFeatures;
+		descriptorIndexing = false;
+		hostQueryReset = false;
+		memoryBudget = false;
+		externalMemoryHost = false;
+		for (const char* extension : requiredDeviceExtensions) {
+			if (std::string(extension) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) memoryBudget = true;
+			if (std::string(extension) == VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) {
+				auto properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>();
+				minImportedHostPointerAlignment = properties.get<vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>().minImportedHostPointerAlignment;
+				externalMemoryHost = true;
+			}
+			if (std::string(extension) == VK_EXT_HOST_QUERY_RESET_EXTENSION_NAME) {
+				auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceHostQueryResetFeaturesEXT>();
+				hostQueryReset = features.get<vk::PhysicalDeviceHostQueryResetFeaturesEXT>().hostQueryReset;
+			}
+			if (std::string(extension) != VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) continue;
+			auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+			vk::PhysicalDeviceDescriptorIndexingFeaturesEXT& supported = features.get<vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+			descriptorIndexing = supported.runtimeDescriptorArray && supported.descriptorBindingPartiallyBound &&
+				this->deviceFeatures.shaderSampledImageArrayDynamicIndexing && this->deviceFeatures.shaderStorageImageArrayDynamicIndexing;
+		}
+		if (descriptorIndexing) {
+			indexingFeatures
+				.setRuntimeDescriptorArray(true)
+				.setDescriptorBindingPartiallyBound(true);
+		}
+		// feature structures of the enabled extensions, chained in front of each other
+		void* pFeatures = nullptr;
+		if (descriptorIndexing) {
+			indexingFeatures.setPNext(pFeatures);
+			pFeatures = &indexingFeatures;
+		}
+		if (hostQueryReset) {
+			hostQueryResetFeatures.setHostQueryReset(true).setPNext(pFeatures);
+			pFeatures = &hostQueryResetFeatures;
+		}
 
 
 		std::vector<vk::DeviceQueueCreateInfo> queueInfos;
@@ -79,7 +146,8 @@ public:
 		vk::DeviceCreateInfo createInfo = vk::DeviceCreateInfo()
 			.setEnabledExtensionCount((uint32_t)requiredDeviceExtensions.size()).setPpEnabledExtensionNames(requiredDeviceExtensions.data())
 			.setQueueCreateInfos(queueInfos)
-			.setPEnabledFeatures(&deviceFeatures);
+			.setPEnabledFeatures(&deviceFeatures)
+			.setPNext(pFeatures);
 
 		// Create logical device
 		logicalDevice = physicalDevice.createDevice(createInfo);
@@ -89,8 +157,10 @@ public:
 		computeQueue = iComputeQueue == iGraphicsQueue ? graphicsQueue : logicalDevice.getQueue(iComputeQueue, 0);
 		transferQueue = iTransferQueue == iGraphicsQueue ? graphicsQueue : logicalDevice.getQueue(iTransferQueue, 0);
 
-		VMI_LOG("[Initializing] Device-specific vulkan functions...");
-		VULKAN_HPP_DEFAULT_DISPATCHER.init(logicalDevice);
+		if (loadDeviceFunctions) {
+			VMI_LOG("[Initializing] Device-specific vulkan functions...");
+			VULKAN_HPP_DEFAULT_DISPATCHER.init(logicalDevice);
+		}
 	}
 	void destroy_logical_device() { logicalDevice.destroy(); }
 
@@ -117,11 +187,11 @@ private:
 		VMI_LOG("");
 #endif
 
-		// get optimal graphics queue
+		// get optimal graphics queue (presentation support is irrelevant when headless)
 		for (int i = 0; i < queueFamilies.size(); i++) {
 
 			if (queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics &&
-				physicalDevice.getSurfaceSupportKHR(i, surface)) {
+				(headless || physicalDevice.getSurfaceSupportKHR(i, surface))) {
 
 				iGraphicsQueue = i;
 				break;
@@ -149,6 +219,16 @@ private:
 			}
 		}
 
+		// compute-only devices can still run headless, using any compute family as the main queue
+		if (headless && iGraphicsQueue == UINT32_MAX) {
+			for (int i = 0; i < queueFamilies.size(); i++) {
+				if (queueFamilies[i].queueFlags & vk::QueueFlagBits::eCompute) {
+					iGraphicsQueue = i;
+					break;
+				}
+			}
+		}
+
 		// if no dedicated queues are not found, use graphics queue
 		if (iComputeQueue == UINT32_MAX) iComputeQueue = iGraphicsQueue;
 		if (iTransferQueue == UINT32_MAX) iTransferQueue = iGraphicsQueue;
@@ -165,6 +245,12 @@ public:
 
 	vk::Queue graphicsQueue, computeQueue, transferQueue;
 	uint32_t iGraphicsQueue, iComputeQueue, iTransferQueue;
+	bool headless;
+	bool descriptorIndexing = false; // enabled VK_EXT_descriptor_indexing with everything the batch pipeline needs
+	bool memoryBudget = false; // enabled VK_EXT_memory_budget
+	bool externalMemoryHost = false; // enabled VK_EXT_external_memory_host
+	bool hostQueryReset = false; // enabled VK_EXT_host_query_reset
+	vk::DeviceSize minImportedHostPointerAlignment = 0;
 
 	// some properties of the device
 	vk::SurfaceCapabilitiesKHR capabilities;
@@ -1,13 +1,27 @@
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <array>
 #include <vector>
 #include <queue>
 #include <optional>
 #include <set>
+#include <list>
 #include <cstdint>
+#include <cerrno>
+#include <cmath>
 #include <algorithm>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <filesystem>
+#include <type_traits>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
 
 // load vulkan functions dynamically
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
@@ -25,4 +39,6 @@
 #include <backends/imgui_impl_vulkan.h>
 
 // Utils
-#include "utils/logging.hpp"
\ No newline at end of file
+#include "utils/logging.hpp"
+#include "utils/hash.hpp"
+#include "utils/trace.hpp"
\ No newline at end of file
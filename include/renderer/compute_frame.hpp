@@ -0,0 +1,144 @@
+#pragma once
+
+#include "device/device_wrapper.hpp"
+#include "renderer/image_wrapper.hpp"
+#include "renderer/memory_pools.hpp"
+#include "renderer/pipelines/disparity_compute.hpp"
+
+// resources of a single disparity computation on the compute queue,
+// multiple of these allow the compute of frame N+1 to overlap with the display of frame N
+// (images are created without memory, the owner places them with MemoryPools)
+class ComputeFrame
+{
+public:
+	void init(DeviceWrapper& device, vma::Allocator allocator, vk::Extent2D extent)
+	{
+		phaseHashes = {};
+		recorded = {};
+		displayPending = false;
+		create_images(device, extent);
+		create_stats_buffer(device, allocator, extent);
+		create_semaphores(device);
+		create_fence(device);
+		create_command_pools(device);
+		create_command_buffers(device);
+	}
+	void destroy(DeviceWrapper& device, vma::Allocator allocator)
+	{
+		gradientImage.destroy(device, allocator);
+		estimateImage.destroy(device, allocator);
+		cutoffImage.destroy(device, allocator);
+		filterImage.destroy(device, allocator);
+		disparityImage.destroy(device, allocator);
+		allocator.destroyBuffer(statsBuffer, statsAllocation);
+
+		device.logicalDevice.destroySemaphore(computeFinished);
+		device.logicalDevice.destroySemaphore(displayFinished);
+		device.logicalDevice.destroyFence(commandBufferFence);
+		device.logicalDevice.destroyCommandPool(commandPool);
+	}
+
+private:
+	void create_images(DeviceWrapper& device, vk::Extent2D extent)
+	{
+		// intermediates never leave the compute queue
+		vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eStorage;
+		gradientImage.init_unbound(device, vk::Extent3D(extent, 1), usage);
+		estimateImage.init_unbound(device, vk::Extent3D(extent, 1), usage);
+		cutoffImage.init_unbound(device, vk::Extent3D(extent, 1), usage);
+		filterImage.init_unbound(device, vk::Extent3D(extent, 1), usage);
+
+		usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc;
+		disparityImage.init_unbound(device, vk::Extent3D(extent, 1), usage);
+	}
+	void create_stats_buffer(DeviceWrapper& device, vma::Allocator allocator, vk::Extent2D extent)
+	{
+		// written by the compute queue and read by the display pass, without ownership transfers
+		std::array<uint32_t, 2> queueFamilies = { device.iComputeQueue, device.iGraphicsQueue };
+		bool concurrent = device.iComputeQueue != device.iGraphicsQueue;
+		vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+			.setSize(DisparityCompute::get_stats_size(extent))
+			.setUsage(vk::BufferUsageFlagBits::eStorageBuffer)
+			.setSharingMode(concurrent ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive)
+			.setQueueFamilyIndexCount(concurrent ? 2 : 0)
+			.setPQueueFamilyIndices(queueFamilies.data());
+
+		// only ever initialized by the clear passes on the gpu
+		vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+			.setUsage(vma::MemoryUsage::eAutoPreferDevice);
+		std::tie(statsBuffer, statsAllocation) = allocator.createBuffer(bufferInfo, allocCreateInfo);
+	}
+	void create_semaphores(DeviceWrapper& device)
+	{
+		vk::SemaphoreCreateInfo semaphoreInfo = vk::SemaphoreCreateInfo();
+
+		computeFinished = device.logicalDevice.createSemaphore(semaphoreInfo);
+		displayFinished = device.logicalDevice.createSemaphore(semaphoreInfo);
+	}
+	void create_fence(DeviceWrapper& device)
+	{
+		vk::FenceCreateInfo fenceInfo = vk::FenceCreateInfo()
+			.setFlags(vk::FenceCreateFlagBits::eSignaled);
+
+		commandBufferFence = device.logicalDevice.createFence(fenceInfo);
+	}
+	void create_command_pools(DeviceWrapper& device)
+	{
+		// buffers are reused across frames and re-recorded individually
+		vk::CommandPoolCreateInfo commandPoolInfo = vk::CommandPoolCreateInfo()
+			.setQueueFamilyIndex(device.iComputeQueue)
+			.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+		commandPool = device.logicalDevice.createCommandPool(commandPoolInfo);
+	}
+	void create_command_buffers(DeviceWrapper& device)
+	{
+		vk::CommandBufferAllocateInfo commandBufferInfo = vk::CommandBufferAllocateInfo()
+			.setCommandPool(commandPool)
+			.setLevel(vk::CommandBufferLevel::ePrimary)
+			.setCommandBufferCount(DisparityCompute::nPhases);
+		std::vector<vk::CommandBuffer> buffers = device.logicalDevice.allocateCommandBuffers(commandBufferInfo);
+		std::copy(buffers.begin(), buffers.end(), commandBuffers.begin());
+	}
+
+public:
+	inline DisparityCompute::PhaseOutputs get_phase_outputs() { return { &gradientImage, &estimateImage, &cutoffImage, &filterImage, &disparityImage }; }
+	// outputs of phase 0 and 3 are only read by the following phase of the same submission (phases 1 and 4 have no parameters
+	// of their own, so they never run alone), so they share memory within each frame while the other outputs must persist.
+	// frames in flight run concurrently and get a region each
+	static void place_images(DeviceWrapper& device, std::vector<ComputeFrame*> frames, MemoryPools& memoryPools) {
+		for (size_t i = 0; i < frames.size(); i++) {
+			memoryPools.add_aliased(device, { &frames[i]->gradientImage, &frames[i]->filterImage }, "phase_0 and phase_3 outputs " + std::to_string(i));
+			memoryPools.add(device, frames[i]->estimateImage, "phase_1 output " + std::to_string(i));
+			memoryPools.add(device, frames[i]->cutoffImage, "phase_2 output " + std::to_string(i));
+			memoryPools.add(device, frames[i]->disparityImage, "phase_4 output " + std::to_string(i));
+		}
+	}
+	// first phase whose stored output does not match the given input hashes (nPhases if all are up to date)
+	inline uint32_t get_first_stale_phase(const std::array<uint64_t, DisparityCompute::nPhases>& hashes) {
+		for (uint32_t i = 0; i < DisparityCompute::nPhases; i++) {
+			if (phaseHashes[i] != hashes[i]) return i;
+		}
+		return DisparityCompute::nPhases;
+	}
+
+public:
+	ImageWrapper gradientImage = { vk::Format::eR32G32B32A32Sfloat };
+	ImageWrapper estimateImage = { vk::Format::eR32G32B32A32Sfloat };
+	ImageWrapper cutoffImage = { vk::Format::eR32G32B32A32Sfloat };
+	ImageWrapper filterImage = { vk::Format::eR32G32B32A32Sfloat };
+	ImageWrapper disparityImage = { vk::Format::eR32G32B32A32Sfloat };
+	vk::Buffer statsBuffer; // DisparityCompute::Stats of the outputs above, followed by partial sums
+	vma::Allocation statsAllocation;
+	std::array<uint64_t, DisparityCompute::nPhases> phaseHashes = {}; // inputs the phase outputs were computed with
+
+	vk::Semaphore computeFinished; // compute -> display
+	vk::Semaphore displayFinished; // display -> next compute into the same image
+	vk::Fence commandBufferFence;
+	bool displayPending = false; // displayFinished was signaled and still has to be waited on
+
+	vk::CommandPool commandPool;
+	// one pre-recorded buffer per first phase, replayed as long as the recorded parameters stay the same
+	std::array<vk::CommandBuffer, DisparityCompute::nPhases> commandBuffers;
+	std::array<uint64_t, DisparityCompute::nPhases> recordedHashes = {};
+	std::array<bool, DisparityCompute::nPhases> recorded = {};
+};
@@ -0,0 +1,238 @@
+#pragma once
+
+#include "vk_mem_alloc.hpp"
+#include "device/device_wrapper.hpp"
+#include "image_wrapper.hpp"
+#include "utils/ring_buffer.hpp"
+#include "utils/shm_ring.hpp"
+
+// publishes every computed disparity map into a posix shared memory ring (ShmRing) that other processes map and read in place.
+// with VK_EXT_external_memory_host each slot's shared pages are imported as device memory and the gpu copies straight into them,
+// otherwise into a host visible readback buffer that is copied into the slot once the frame completed.
+// a completion thread waits for the copies and publishes each slot as soon as its fence signaled
+class DisparityPublisher
+{
+public:
+	void init(DeviceWrapper& device, vma::Allocator allocator, const std::string& name, vk::Extent3D extent, uint32_t texelSize, uint32_t nSlots) {
+		TRACE_SCOPE("DisparityPublisher::init");
+		this->allocator = allocator;
+		this->extent = extent;
+		this->texelSize = texelSize;
+		uint64_t alignment = device.externalMemoryHost ? device.minImportedHostPointerAlignment : 0;
+		if (!writer.create(name, extent.width, extent.height, texelSize, std::max(nSlots, 2u), alignment)) {
+			VMI_ERR("Could not create shared memory for publishing: " << name);
+			return;
+		}
+
+		vk::CommandPoolCreateInfo commandPoolInfo = vk::CommandPoolCreateInfo()
+			.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+			.setQueueFamilyIndex(device.iComputeQueue);
+		commandPool = device.logicalDevice.createCommandPool(commandPoolInfo);
+		vk::CommandBufferAllocateInfo commandBufferInfo = vk::CommandBufferAllocateInfo()
+			.setCommandPool(commandPool)
+			.setLevel(vk::CommandBufferLevel::ePrimary)
+			.setCommandBufferCount(writer.get_slot_count());
+		std::vector<vk::CommandBuffer> commandBuffers = device.logicalDevice.allocateCommandBuffers(commandBufferInfo);
+
+		// imports either work for every slot or the whole ring falls back to readback buffers
+		zeroCopy = device.externalMemoryHost;
+		slots.set_size(writer.get_slot_count());
+		for (uint32_t i = 0; i < slots.size() && zeroCopy; i++) zeroCopy = import_slot(device, slots[i], writer.get_slot_data(i));
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			if (!zeroCopy) {
+				slots[i].destroy(device, allocator);
+				create_readback(slots[i]);
+			}
+			slots[i].commandBuffer = commandBuffers[i];
+			slots[i].fence = device.logicalDevice.createFence(vk::FenceCreateInfo());
+		}
+		VMI_LOG("    Publishing disparity to " << ShmRing::get_object_name(name) << " (" << slots.size() << " slots, "
+			<< (zeroCopy ? "imported shared memory" : "readback buffers") << ")");
+
+		enabled = true;
+		completion = std::thread([this, &device]() { complete(device); });
+	}
+	void destroy(DeviceWrapper& device) {
+		if (!enabled) return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			condition.notify_all();
+		}
+		completion.join();
+		for (uint32_t i = 0; i < slots.size(); i++) device.logicalDevice.destroyFence(slots[i].fence);
+		slots.destroy(device, allocator);
+		device.logicalDevice.destroyCommandPool(commandPool);
+		writer.destroy();
+		if (nPublished > 0) {
+			VMI_LOG("Published " << nPublished << " frames, handoff after the copy mean " << handoffUsSum / nPublished << " us, max " << handoffUsMax << " us");
+		}
+		enabled = false;
+	}
+
+	inline bool is_enabled() { return enabled; }
+	inline vk::Extent3D get_extent() { return extent; }
+	// copies the image (in the shader read only layout, written on the compute queue before) into the next slot on the compute queue,
+	// waits if the completion thread still holds that slot
+	void publish(DeviceWrapper& device, ImageWrapper& image, uint64_t iFrame) {
+		TRACE_SCOPE("DisparityPublisher::publish");
+		Slot& slot = slots.get_current();
+		uint32_t iSlot = slots.get_current_index();
+		slots.get_next();
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [&]() { return !slot.pending; });
+		}
+		writer.begin_write(iSlot);
+		device.logicalDevice.resetFences(slot.fence);
+		if (slot.recordedImage != image.get_image()) {
+			record(slot, image);
+			slot.recordedImage = image.get_image();
+		}
+
+		vk::SubmitInfo submitInfo = vk::SubmitInfo().setCommandBufferCount(1).setPCommandBuffers(&slot.commandBuffer);
+		device.computeQueue.submit(submitInfo, slot.fence);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.pending = true;
+		slot.iFrame = iFrame;
+		pending.push({ &slot, iSlot });
+		condition.notify_all();
+	}
+
+private:
+	struct Slot
+	{
+		void destroy(DeviceWrapper& device, vma::Allocator& allocator) {
+			if (alloc) allocator.destroyBuffer(buffer, alloc);
+			else device.logicalDevice.destroyBuffer(buffer);
+			device.logicalDevice.freeMemory(memory);
+			buffer = nullptr;
+			memory = nullptr;
+			alloc = nullptr;
+		}
+
+		vk::Buffer buffer;
+		vk::DeviceMemory memory; // imported shared pages
+		vma::Allocation alloc; // or a readback buffer
+		vma::AllocationInfo allocInfo;
+		vk::CommandBuffer commandBuffer;
+		vk::Image recordedImage; // source of the recorded copy
+		vk::Fence fence;
+		bool pending = false; // submitted and not published yet
+		uint64_t iFrame = 0;
+	};
+
+	// the host reads the shared pages without mapping them, so only coherent memory types qualify
+	bool import_slot(DeviceWrapper& device, Slot& slot, void* pData) {
+		vk::ExternalMemoryBufferCreateInfo externalInfo = vk::ExternalMemoryBufferCreateInfo()
+			.setHandleTypes(vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT);
+		vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+			.setSize(writer.get_slot_stride())
+			.setUsage(vk::BufferUsageFlagBits::eTransferDst)
+			.setPNext(&externalInfo);
+		slot.buffer = device.logicalDevice.createBuffer(bufferInfo);
+
+		vk::MemoryHostPointerPropertiesEXT hostProperties;
+		vk::Result result = device.logicalDevice.getMemoryHostPointerPropertiesEXT(vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT, pData, &hostProperties);
+		uint32_t typeBits = result == vk::Result::eSuccess ? device.logicalDevice.getBufferMemoryRequirements(slot.buffer).memoryTypeBits & hostProperties.memoryTypeBits : 0;
+		vk::MemoryPropertyFlags flags = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+		uint32_t iMemoryType = UINT32_MAX;
+		for (uint32_t i = 0; i < device.deviceMemProperties.memoryTypeCount && iMemoryType == UINT32_MAX; i++) {
+			if ((typeBits & (1u << i)) && (device.deviceMemProperties.memoryTypes[i].propertyFlags & flags) == flags) iMemoryType = i;
+		}
+
+		vk::ImportMemoryHostPointerInfoEXT importInfo = vk::ImportMemoryHostPointerInfoEXT()
+			.setHandleType(vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT)
+			.setPHostPointer(pData);
+		vk::MemoryAllocateInfo allocInfo = vk::MemoryAllocateInfo()
+			.setAllocationSize(writer.get_slot_stride())
+			.setMemoryTypeIndex(iMemoryType)
+			.setPNext(&importInfo);
+		// drivers may refuse shared file mappings, which is not an error here
+		if (iMemoryType == UINT32_MAX || device.logicalDevice.allocateMemory(&allocInfo, nullptr, &slot.memory) != vk::Result::eSuccess) {
+			VMI_WARN("Shared memory could not be imported, falling back to readback buffers");
+			return false;
+		}
+		device.logicalDevice.bindBufferMemory(slot.buffer, slot.memory, 0);
+		return true;
+	}
+	void create_readback(Slot& slot) {
+		vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+			.setSize(get_frame_size())
+			.setUsage(vk::BufferUsageFlagBits::eTransferDst);
+		vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+			.setUsage(vma::MemoryUsage::eAuto)
+			.setFlags(vma::AllocationCreateFlagBits::eHostAccessRandom | vma::AllocationCreateFlagBits::eMapped);
+		auto buffer = allocator.createBuffer(bufferInfo, allocCreateInfo, slot.allocInfo);
+		slot.buffer = buffer.first;
+		slot.alloc = buffer.second;
+	}
+	void record(Slot& slot, ImageWrapper& image) {
+		vk::CommandBuffer commandBuffer = slot.commandBuffer;
+		commandBuffer.begin(vk::CommandBufferBeginInfo());
+		// the transfer stage orders this transition after the one at the end of Renderer::record_disparity
+		image.barrier(commandBuffer, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferSrcOptimal,
+			vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eShaderWrite,
+			vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead);
+		image.record_download(commandBuffer, slot.buffer);
+		// the next computation into this image waits for the copy
+		image.barrier(commandBuffer, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+			vk::PipelineStageFlagBits::eTransfer, {},
+			vk::PipelineStageFlagBits::eComputeShader, {});
+		vk::MemoryBarrier memoryBarrier = vk::MemoryBarrier().setSrcAccessMask(vk::AccessFlagBits::eTransferWrite).setDstAccessMask(vk::AccessFlagBits::eHostRead);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, memoryBarrier, {}, {});
+		commandBuffer.end();
+	}
+	inline vk::DeviceSize get_frame_size() { return (vk::DeviceSize)extent.width * extent.height * extent.depth * texelSize; }
+	// completion thread: slots complete in submission order
+	void complete(DeviceWrapper& device) {
+		while (true) {
+			std::pair<Slot*, uint32_t> entry;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [&]() { return stopping || !pending.empty(); });
+				if (pending.empty()) return;
+				entry = pending.front();
+				pending.pop();
+			}
+			Slot& slot = *entry.first;
+			vk::Result result = device.logicalDevice.waitForFences(slot.fence, VK_TRUE, UINT64_MAX);
+			if (result != vk::Result::eSuccess) assert(false);
+
+			auto start = std::chrono::steady_clock::now();
+			if (!zeroCopy) {
+				allocator.invalidateAllocation(slot.alloc, 0, VK_WHOLE_SIZE);
+				memcpy(writer.get_slot_data(entry.second), slot.allocInfo.pMappedData, get_frame_size());
+			}
+			writer.end_write(entry.second, slot.iFrame);
+			double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			handoffUsSum += us;
+			handoffUsMax = std::max(handoffUsMax, us);
+			nPublished++;
+			slot.pending = false;
+			condition.notify_all();
+		}
+	}
+
+private:
+	vma::Allocator allocator;
+	vk::Extent3D extent;
+	uint32_t texelSize = 0;
+	ShmRingWriter writer;
+	bool enabled = false;
+	bool zeroCopy = false;
+	vk::CommandPool commandPool;
+	RingBuffer<Slot> slots; // the current element receives the next frame
+
+	std::thread completion;
+	std::queue<std::pair<Slot*, uint32_t>> pending; // submitted slots and their index in the ring
+	bool stopping = false; // pending slots are still published
+	std::mutex mutex;
+	std::condition_variable condition;
+	uint64_t nPublished = 0;
+	double handoffUsSum = 0.0;
+	double handoffUsMax = 0.0;
+};
@@ -0,0 +1,376 @@
+#pragma once
+
+#include "image_wrapper.hpp"
+#include "gpu_profiler.hpp"
+#include "light_field_stream.hpp"
+#include "push_constants.hpp"
+#include "pipelines/disparity_query.hpp"
+#include "utils/daemon_protocol.hpp"
+#include "utils/shm_ring.hpp"
+#include "utils/pfm.hpp"
+
+// socket side of the disparity daemon (DaemonRequest): a thread per connection parses requests and decodes their light fields,
+// the device thread takes whatever arrived within a short window as one batch (next_batch) and hands the results back (complete),
+// the connection threads then write them out and reply
+class DisparityServer
+{
+public:
+	struct Job
+	{
+		DaemonRequest request;
+		PushConstants pcs;
+		std::vector<uint8_t> lightField; // rgba8 views one after another
+		vk::Extent2D extent;
+		std::chrono::steady_clock::time_point arrival; // request received
+		std::chrono::steady_clock::time_point queued; // decoded and waiting for the device
+		std::chrono::steady_clock::time_point completed; // results handed back by the device thread
+		// of query requests
+		std::vector<vk::Offset2D> points;
+		std::vector<vk::Rect2D> rects;
+
+		// filled by the device thread
+		std::vector<float> disparity; // rgba32f texels of the final phase, DisparityQuery::Result one after another for queries
+		vk::Extent3D disparityExtent; // number of query results as its width
+		uint32_t batchSize = 0;
+		double computeMs = 0.0;
+		bool done = false;
+
+		inline bool is_query() const { return request.command == "query"; }
+	};
+
+public:
+	// listens on the socket, requests use the given push constants unless they override them
+	bool init(const std::string& path, std::vector<int> indices, PushConstants pcs) {
+#ifdef _WIN32
+		VMI_ERR("The daemon is not supported on this platform");
+		return false;
+#else
+		this->indices = indices;
+		this->pcs = pcs;
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path)) {
+			VMI_ERR("Socket path too long: " << path);
+			return false;
+		}
+		path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+		unlink(path.c_str());
+		server = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (server < 0 || bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(server, 64) != 0) {
+			VMI_ERR("Could not listen on " << path);
+			return false;
+		}
+		this->path = path;
+		start = std::chrono::steady_clock::now();
+		acceptor = std::thread([this]() { accept_connections(); });
+		VMI_LOG("Serving disparity requests on " << path);
+		return true;
+#endif
+	}
+	void destroy() {
+#ifndef _WIN32
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			condition.notify_all();
+		}
+		// unblocks accept and the pending reads of every connection
+		if (server >= 0) shutdown(server, SHUT_RDWR);
+		if (acceptor.joinable()) acceptor.join();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (int client : clients) shutdown(client, SHUT_RDWR);
+		}
+		for (Connection& connection : connections) connection.thread.join();
+		connections.clear();
+		if (server >= 0) close(server);
+		server = -1;
+		if (!path.empty()) unlink(path.c_str());
+		for (auto& writer : shmWriters) writer.second.writer.destroy();
+		shmWriters.clear();
+		VMI_LOG(get_metrics());
+#endif
+	}
+
+	// waits for the first job, then collects more until the window closed or maxJobs arrived,
+	// empty once the daemon stops and every queued job was handed out
+	std::vector<std::shared_ptr<Job>> next_batch(uint32_t windowMs, uint32_t maxJobs) {
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [&]() { return stopping || !queue.empty(); });
+		if (queue.empty()) return {};
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(windowMs);
+		condition.wait_until(lock, deadline, [&]() { return stopping || queue.size() >= maxJobs; });
+
+		std::vector<std::shared_ptr<Job>> jobs;
+		while (!queue.empty() && jobs.size() < maxJobs) {
+			jobs.push_back(queue.front());
+			queue.pop();
+		}
+		return jobs;
+	}
+	void complete(const std::vector<std::shared_ptr<Job>>& jobs) {
+		std::lock_guard<std::mutex> lock(mutex);
+		nBatches++;
+		nBatchedJobs += jobs.size();
+		auto now = std::chrono::steady_clock::now();
+		for (const std::shared_ptr<Job>& pJob : jobs) {
+			pJob->completed = now;
+			pJob->done = true;
+		}
+		condition.notify_all();
+	}
+	// requests served, batching and latencies over the most recent requests
+	std::string get_metrics() {
+		std::lock_guard<std::mutex> lock(mutex);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::ostringstream line;
+		line << std::fixed << std::setprecision(3) << "ok requests=" << nServed << " errors=" << nErrors << " batches=" << nBatches
+			<< " mean_batch=" << (nBatches > 0 ? (double)nBatchedJobs / nBatches : 0.0) << " requests_per_s=" << nServed / std::max(seconds, 1e-3);
+		for (const ProfilerStats::Pass& pass : latencies.get_passes()) {
+			line << " " << pass.name << "_mean_ms=" << pass.mean() << " " << pass.name << "_p99_ms=" << pass.p99();
+		}
+		return line.str();
+	}
+
+private:
+	struct ShmResult
+	{
+		ShmRingWriter writer;
+		vk::Extent3D extent;
+	};
+	struct Connection
+	{
+		std::thread thread;
+		bool done = false; // set by the thread as it exits, joined on the next accept
+	};
+
+	void accept_connections() {
+		while (true) {
+			int client = accept(server, nullptr, nullptr);
+			int error = errno;
+			std::lock_guard<std::mutex> lock(mutex);
+			if (client >= 0 && stopping) close(client);
+			if (stopping) return;
+			if (client < 0) {
+				// interrupted or a client that gave up before it was accepted, anything else will not go away by retrying
+				if (error == EINTR || error == ECONNABORTED) continue;
+				VMI_ERR("Could not accept connections on " << path << " (errno " << error << "), stopping the daemon");
+				stopping = true;
+				condition.notify_all();
+				return;
+			}
+			// threads of closed connections only hold their stack until here
+			for (auto it = connections.begin(); it != connections.end();) {
+				if (!it->done) it++;
+				else {
+					it->thread.join();
+					it = connections.erase(it);
+				}
+			}
+			clients.insert(client);
+			Connection& connection = connections.emplace_back();
+			connection.thread = std::thread([this, client, &connection]() { serve(client, connection.done); });
+		}
+	}
+	void serve(int client, bool& done) {
+		std::string buffer, line;
+		while (DaemonSocket::read_line(client, buffer, line, DaemonRequest::maxLength)) {
+			if (line.empty()) continue;
+			std::string reply = handle(line);
+			if (!DaemonSocket::write_line(client, reply)) break;
+		}
+		// the rest of an overlong line can't be told apart from the next request, so the connection ends here
+		if (buffer.size() > DaemonRequest::maxLength) DaemonSocket::write_line(client, fail("request exceeds " + std::to_string(DaemonRequest::maxLength) + " bytes"));
+		std::lock_guard<std::mutex> lock(mutex);
+		clients.erase(client);
+		close(client);
+		done = true;
+	}
+	std::string handle(const std::string& line) {
+		TRACE_SCOPE("DisparityServer::handle");
+		DaemonRequest request;
+		if (!DaemonRequest::parse(line, request)) return fail("malformed request");
+		if (request.command == "metrics") return get_metrics();
+		if (request.command == "shutdown") {
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			condition.notify_all();
+			return "ok";
+		}
+		if (request.command != "compute" && request.command != "query") return fail("unknown command " + request.command);
+
+		auto pJob = std::make_shared<Job>();
+		pJob->arrival = std::chrono::steady_clock::now();
+		pJob->request = request;
+		pJob->pcs = pcs;
+		std::string error = decode(*pJob);
+		if (!error.empty()) return fail(error);
+		// jobs queued before a shutdown are still computed
+		bool queued = false;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!stopping) {
+				pJob->queued = std::chrono::steady_clock::now();
+				queue.push(pJob);
+				queued = true;
+				condition.notify_all();
+				condition.wait(lock, [&]() { return pJob->done; });
+			}
+		}
+		if (!queued) return fail("daemon is shutting down");
+		if (pJob->disparity.empty()) return fail("disparity computation failed");
+		return finish(*pJob);
+	}
+	// push constant overrides and the light field, on the connection thread
+	std::string decode(Job& job) {
+		TRACE_SCOPE("DisparityServer::decode");
+		const DaemonRequest& request = job.request;
+		if (!request.get_uint("steps", maxSteps, job.pcs.nSteps)) return "steps needs an integer in [0, " + std::to_string(maxSteps) + "]";
+		if (!request.get_uint("radius", DisparityCompute::maxFilterRadius, job.pcs.filterRadius)) {
+			return "radius needs an integer in [0, " + std::to_string(DisparityCompute::maxFilterRadius) + "]";
+		}
+		if (!request.get_float("edges", maxEdges, job.pcs.filterEdges)) return "edges needs a number in [0, " + std::to_string((int)maxEdges) + "]";
+		if (job.is_query()) {
+			std::string error = decode_query(job);
+			if (!error.empty()) return error;
+		}
+
+		if (request.has("scene")) {
+			std::string folder = request.get("scene");
+			job.extent = ImageWrapper::get_file_extent(folder.c_str(), "input_Cam", indices);
+			if (job.extent.width == 0) return "no light field in " + folder;
+			job.lightField.resize((size_t)job.extent.width * job.extent.height * 4 * indices.size());
+			if (!ImageWrapper::decode_files(folder.c_str(), "input_Cam", indices, job.extent, job.lightField.data())) return "could not decode " + folder;
+			return "";
+		}
+		if (request.has("packed")) {
+			std::ifstream file(request.get("packed"), std::ios::binary);
+			SocketSource::FrameHeader header = {};
+			file.read(reinterpret_cast<char*>(&header), sizeof(header));
+			if (!file || header.magic != SocketSource::frameMagic) return "not a packed light field: " + request.get("packed");
+			if (header.nViews != indices.size()) return "packed light fields need " + std::to_string(indices.size()) + " views";
+			// the header is untrusted, its payload has to be exactly the rest of the file (this also bounds the allocation)
+			std::streamoff headerEnd = file.tellg();
+			file.seekg(0, std::ios::end);
+			uint64_t remaining = (uint64_t)(file.tellg() - headerEnd);
+			file.seekg(headerEnd);
+			uint64_t viewSize = 4ull * header.nViews;
+			if (header.width == 0 || header.height == 0 || (uint64_t)header.width * header.height > remaining / viewSize ||
+				(uint64_t)header.width * header.height * viewSize != remaining) {
+				return "packed light field size does not match its header: " + request.get("packed");
+			}
+			job.extent = vk::Extent2D(header.width, header.height);
+			job.lightField.resize((size_t)header.width * header.height * 4 * header.nViews);
+			file.read(reinterpret_cast<char*>(job.lightField.data()), (std::streamsize)job.lightField.size());
+			if (!file) return "truncated packed light field: " + request.get("packed");
+			return "";
+		}
+		return request.command + " needs scene=<folder> or packed=<file>";
+	}
+	// points and rectangles of a query, before its light field is decoded
+	std::string decode_query(Job& job) {
+		std::vector<std::vector<int32_t>> tuples;
+		if (!job.request.get_tuples("points", 2, tuples)) return "points need x,y;x,y;...";
+		for (const std::vector<int32_t>& tuple : tuples) job.points.push_back(vk::Offset2D(tuple[0], tuple[1]));
+		if (!job.request.get_tuples("rects", 4, tuples)) return "rects need x,y,width,height;...";
+		uint64_t nTexels = job.points.size();
+		for (const std::vector<int32_t>& tuple : tuples) {
+			if (tuple[2] <= 0 || tuple[3] <= 0) return "empty rectangle";
+			job.rects.push_back(vk::Rect2D(vk::Offset2D(tuple[0], tuple[1]), vk::Extent2D(tuple[2], tuple[3])));
+			nTexels += (uint64_t)tuple[2] * tuple[3];
+		}
+		if (nTexels == 0) return "query needs points=<x,y;...> or rects=<x,y,width,height;...>";
+		if (nTexels > DisparityQuery::maxResults) return "query exceeds " + std::to_string(DisparityQuery::maxResults) + " texels";
+		return "";
+	}
+	// writes the outputs the request asked for and records its latencies
+	std::string finish(Job& job) {
+		if (job.is_query()) return finish_query(job);
+		const DaemonRequest& request = job.request;
+		vk::Extent3D extent = job.disparityExtent;
+		if (request.has("output")) PfmFile::write(request.get("output"), extent.width, extent.height, job.disparity.data() + 3, 4);
+		if (request.has("shm") && !publish(request.get("shm"), job)) return fail("could not create shared memory " + request.get("shm"));
+
+		// waiting for the batch window and earlier batches (including the uploads and readbacks of its batch), compute is the batch's submission
+		double queueMs = std::max(std::chrono::duration<double, std::milli>(job.completed - job.queued).count() - job.computeMs, 0.0);
+		double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.arrival).count();
+		std::ostringstream reply;
+		reply << std::fixed << std::setprecision(3) << "ok width=" << extent.width << " height=" << extent.height << " batch=" << job.batchSize
+			<< " total_ms=" << totalMs << " queue_ms=" << queueMs << " compute_ms=" << job.computeMs;
+		if (request.has("output")) reply << " output=" << request.get("output");
+		if (request.has("shm")) reply << " shm=" << request.get("shm");
+
+		add_latencies(totalMs, queueMs, job.computeMs);
+		return reply.str();
+	}
+	// disparity and confidence of every queried texel in the reply
+	std::string finish_query(Job& job) {
+		double queueMs = std::max(std::chrono::duration<double, std::milli>(job.completed - job.queued).count() - job.computeMs, 0.0);
+		double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - job.arrival).count();
+		std::ostringstream reply, disparities, confidences;
+		reply << std::fixed << std::setprecision(3) << "ok points=" << job.points.size() << " rects=" << job.rects.size()
+			<< " texels=" << job.disparityExtent.width << " total_ms=" << totalMs << " queue_ms=" << queueMs << " compute_ms=" << job.computeMs;
+		disparities << std::setprecision(6);
+		confidences << std::setprecision(6);
+		for (size_t i = 0; i < job.disparityExtent.width; i++) {
+			disparities << (i > 0 ? "," : "") << job.disparity[4 * i + 2];
+			confidences << (i > 0 ? "," : "") << job.disparity[4 * i + 1];
+		}
+		reply << " disparity=" << disparities.str() << " confidence=" << confidences.str();
+
+		add_latencies(totalMs, queueMs, job.computeMs);
+		return reply.str();
+	}
+	void add_latencies(double totalMs, double queueMs, double computeMs) {
+		std::lock_guard<std::mutex> lock(mutex);
+		nServed++;
+		latencies.add_sample(nServed, "total", totalMs, 1);
+		latencies.add_sample(nServed, "queue", queueMs, 1);
+		latencies.add_sample(nServed, "compute", computeMs, 1);
+	}
+	// single slot ring per name, kept until the daemon stops so clients can map it after the reply
+	bool publish(const std::string& name, Job& job) {
+		std::lock_guard<std::mutex> lock(mutex);
+		ShmResult& result = shmWriters[name];
+		if (result.extent != job.disparityExtent) {
+			result.writer.destroy();
+			result.extent = job.disparityExtent;
+			if (!result.writer.create(name, job.disparityExtent.width, job.disparityExtent.height, 4 * sizeof(float), 1)) {
+				shmWriters.erase(name);
+				return false;
+			}
+		}
+		result.writer.begin_write(0);
+		memcpy(result.writer.get_slot_data(0), job.disparity.data(), job.disparity.size() * sizeof(float));
+		result.writer.end_write(0, nServed);
+		return true;
+	}
+	std::string fail(const std::string& message) {
+		std::lock_guard<std::mutex> lock(mutex);
+		nErrors++;
+		return "error " + message;
+	}
+
+private:
+	// bounds of the push constant overrides, 20 steps already mark every pixel as uncertain
+	static constexpr uint32_t maxSteps = 20;
+	static constexpr float maxEdges = 1000.0f;
+
+	std::string path;
+	int server = -1;
+	std::vector<int> indices;
+	PushConstants pcs;
+	std::thread acceptor;
+	std::list<Connection> connections; // list elements stay in place while their threads run
+	std::set<int> clients; // open connections, shut down to stop their threads
+
+	std::queue<std::shared_ptr<Job>> queue;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::map<std::string, ShmResult> shmWriters;
+
+	std::chrono::steady_clock::time_point start;
+	uint64_t nServed = 0, nErrors = 0, nBatches = 0, nBatchedJobs = 0;
+	ProfilerStats latencies; // total, queue and compute ms per request
+};
@@ -0,0 +1,209 @@
+#pragma once
+
+#include "device/device_wrapper.hpp"
+
+// rolling gpu timings per pass, optionally streamed to a .csv or .json file
+class ProfilerStats
+{
+public:
+	struct Pass
+	{
+		std::string name;
+		std::vector<double> samples; // ring of the most recent timings in ms
+		size_t iNext = 0;
+		double last = 0.0;
+		uint64_t invocations = 0;
+
+		double min() const { return samples.empty() ? 0.0 : *std::min_element(samples.begin(), samples.end()); }
+		double mean() const {
+			double sum = 0.0;
+			for (double sample : samples) sum += sample;
+			return samples.empty() ? 0.0 : sum / samples.size();
+		}
+		double p99() const {
+			if (samples.empty()) return 0.0;
+			std::vector<double> sorted = samples;
+			size_t i = std::min(sorted.size() - 1, (size_t)(0.99 * sorted.size()));
+			std::nth_element(sorted.begin(), sorted.begin() + i, sorted.end());
+			return sorted[i];
+		}
+	};
+
+public:
+	void init(const std::string& filename) {
+		if (filename.empty()) return;
+		json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+		file.open(filename, std::ios::trunc);
+		if (!file) {
+			VMI_ERR("Could not open profiler output: " << filename);
+			return;
+		}
+		if (json) file << "[\n";
+		else file << "frame,pass,gpu_ms,invocations\n";
+	}
+	void destroy() {
+		if (!file.is_open()) return;
+		if (json) file << "\n]\n";
+		file.close();
+	}
+
+	void add_sample(uint64_t iFrame, const std::string& passName, double ms, uint64_t invocations) {
+		Pass& pass = get_pass(passName);
+		if (pass.samples.size() < nSamples) pass.samples.push_back(ms);
+		else pass.samples[pass.iNext] = ms;
+		pass.iNext = (pass.iNext + 1) % nSamples;
+		pass.last = ms;
+		pass.invocations = invocations;
+
+		if (!file.is_open()) return;
+		if (json) {
+			file << (firstEntry ? "" : ",\n");
+			file << "  { \"frame\": " << iFrame << ", \"pass\": \"" << passName << "\", \"gpu_ms\": " << ms << ", \"invocations\": " << invocations << " }";
+		}
+		else file << iFrame << "," << passName << "," << ms << "," << invocations << "\n";
+		firstEntry = false;
+	}
+	const std::vector<Pass>& get_passes() { return passes; }
+	// forgets the rolling timings (the output file keeps everything), e.g. between configurations that are compared
+	void clear() { passes.clear(); }
+
+private:
+	Pass& get_pass(const std::string& passName) {
+		for (Pass& pass : passes) {
+			if (pass.name == passName) return pass;
+		}
+		passes.push_back(Pass());
+		passes.back().name = passName;
+		return passes.back();
+	}
+
+private:
+	static constexpr size_t nSamples = 256;
+	std::vector<Pass> passes;
+	std::ofstream file;
+	bool json = false;
+	bool firstEntry = true;
+};
+
+// timestamp and pipeline statistics queries for a set of named passes on one queue family,
+// with a separate query pool slot per frame so results are read back without stalling
+class GpuProfiler
+{
+public:
+	void init(DeviceWrapper& device, uint32_t iQueueFamily, uint32_t nSlots, std::vector<std::string> passNames, vk::QueryPipelineStatisticFlags statistics) {
+		this->passNames = passNames;
+		timestampPeriod = device.deviceProperties.limits.timestampPeriod;
+		uint32_t validBits = device.physicalDevice.getQueueFamilyProperties()[iQueueFamily].timestampValidBits;
+		timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+		timestampsEnabled = validBits > 0;
+		statisticsEnabled = device.deviceFeatures.pipelineStatisticsQuery && statistics;
+		if (!timestampsEnabled) VMI_WARN("Queue family " << iQueueFamily << " does not support timestamps, gpu timings disabled");
+
+		slots.resize(nSlots);
+		for (Slot& slot : slots) {
+			if (timestampsEnabled) {
+				vk::QueryPoolCreateInfo info = vk::QueryPoolCreateInfo()
+					.setQueryType(vk::QueryType::eTimestamp)
+					.setQueryCount(2 * (uint32_t)passNames.size());
+				slot.timestampPool = device.logicalDevice.createQueryPool(info);
+			}
+			if (statisticsEnabled) {
+				vk::QueryPoolCreateInfo info = vk::QueryPoolCreateInfo()
+					.setQueryType(vk::QueryType::ePipelineStatistics)
+					.setPipelineStatistics(statistics)
+					.setQueryCount((uint32_t)passNames.size());
+				slot.statisticsPool = device.logicalDevice.createQueryPool(info);
+			}
+		}
+	}
+	void destroy(DeviceWrapper& device) {
+		for (Slot& slot : slots) {
+			if (timestampsEnabled) device.logicalDevice.destroyQueryPool(slot.timestampPool);
+			if (statisticsEnabled) device.logicalDevice.destroyQueryPool(slot.statisticsPool);
+		}
+	}
+
+	// has to be recorded before any pass of this slot, outside of a render pass
+	void reset(vk::CommandBuffer commandBuffer, uint32_t iSlot, uint64_t iFrame) {
+		Slot& slot = slots[iSlot];
+		uint32_t nPasses = (uint32_t)passNames.size();
+		if (timestampsEnabled) commandBuffer.resetQueryPool(slot.timestampPool, 0, 2 * nPasses);
+		if (statisticsEnabled) commandBuffer.resetQueryPool(slot.statisticsPool, 0, nPasses);
+		slot.recorded = true;
+		slot.iFrame = iFrame;
+	}
+	// the same from the host (VK_EXT_host_query_reset), for queue families that can't reset query pools (transfer)
+	void reset_host(DeviceWrapper& device, uint32_t iSlot, uint64_t iFrame) {
+		Slot& slot = slots[iSlot];
+		uint32_t nPasses = (uint32_t)passNames.size();
+		if (timestampsEnabled) device.logicalDevice.resetQueryPoolEXT(slot.timestampPool, 0, 2 * nPasses);
+		if (statisticsEnabled) device.logicalDevice.resetQueryPoolEXT(slot.statisticsPool, 0, nPasses);
+		slot.recorded = true;
+		slot.iFrame = iFrame;
+	}
+	// false without timestamp support on its queue family (or before init)
+	inline bool is_enabled() { return timestampsEnabled; }
+	// for command buffers that are submitted again without re-recording the reset
+	void resubmit(uint32_t iSlot, uint64_t iFrame) {
+		slots[iSlot].recorded = true;
+		slots[iSlot].iFrame = iFrame;
+	}
+	void begin(vk::CommandBuffer commandBuffer, uint32_t iSlot, uint32_t iPass) {
+		Slot& slot = slots[iSlot];
+		if (timestampsEnabled) commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, slot.timestampPool, 2 * iPass);
+		if (statisticsEnabled) commandBuffer.beginQuery(slot.statisticsPool, iPass, {});
+	}
+	void end(vk::CommandBuffer commandBuffer, uint32_t iSlot, uint32_t iPass) {
+		Slot& slot = slots[iSlot];
+		if (statisticsEnabled) commandBuffer.endQuery(slot.statisticsPool, iPass);
+		if (timestampsEnabled) commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, slot.timestampPool, 2 * iPass + 1);
+	}
+
+	// reads the results of the last submission using this slot, call only once its fence has signaled
+	void collect(DeviceWrapper& device, uint32_t iSlot, ProfilerStats& stats) {
+		Slot& slot = slots[iSlot];
+		if (!slot.recorded || !timestampsEnabled) return;
+		slot.recorded = false;
+		uint32_t nPasses = (uint32_t)passNames.size();
+
+		// value + availability pairs, passes that were skipped this frame stay unavailable
+		std::vector<uint64_t> timestamps(4 * nPasses);
+		vk::Result result = device.logicalDevice.getQueryPoolResults(slot.timestampPool, 0, 2 * nPasses,
+			timestamps.size() * sizeof(uint64_t), timestamps.data(), 2 * sizeof(uint64_t),
+			vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+		if (result != vk::Result::eSuccess && result != vk::Result::eNotReady) return;
+
+		std::vector<uint64_t> statistics(2 * nPasses, 0);
+		if (statisticsEnabled) {
+			result = device.logicalDevice.getQueryPoolResults(slot.statisticsPool, 0, nPasses,
+				statistics.size() * sizeof(uint64_t), statistics.data(), 2 * sizeof(uint64_t),
+				vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+		}
+
+		for (uint32_t iPass = 0; iPass < nPasses; iPass++) {
+			uint64_t* pBegin = &timestamps[4 * iPass];
+			uint64_t* pEnd = &timestamps[4 * iPass + 2];
+			if (pBegin[1] == 0 || pEnd[1] == 0) continue;
+
+			uint64_t ticks = ((pEnd[0] & timestampMask) - (pBegin[0] & timestampMask)) & timestampMask;
+			double ms = (double)ticks * timestampPeriod / 1000000.0;
+			stats.add_sample(slot.iFrame, passNames[iPass], ms, statistics[2 * iPass]);
+		}
+	}
+
+private:
+	struct Slot
+	{
+		vk::QueryPool timestampPool;
+		vk::QueryPool statisticsPool;
+		bool recorded = false; // queries were reset and written since the last collect
+		uint64_t iFrame = 0;
+	};
+	std::vector<Slot> slots;
+	std::vector<std::string> passNames;
+
+	float timestampPeriod = 1.0f; // ns per tick
+	uint64_t timestampMask = UINT64_MAX;
+	bool timestampsEnabled = false;
+	bool statisticsEnabled = false;
+};
@@ -2,6 +2,7 @@
 
 #include "vma/include/vk_mem_alloc.hpp"
 #include "stb/stb_image.h"
+#include "renderer/gpu_profiler.hpp"
 
 class ImageWrapper 
 {
@@ -16,8 +17,22 @@ public:
         create_image(allocator, usage);
         create_image_view(device);
     }
+    // creates the image without memory, the returned requirements are used to place it in a MemoryPools block before bind()
+    vk::MemoryRequirements init_unbound(DeviceWrapper& device, vk::Extent3D extent, vk::ImageUsageFlags usage) {
+        this->extent = extent;
+        image = device.logicalDevice.createImage(get_image_info(usage));
+        ownsMemory = false;
+        return device.logicalDevice.getImageMemoryRequirements(image);
+    }
+    // memory is owned (and freed) by the caller, other images may alias it
+    void bind(DeviceWrapper& device, vma::Allocator allocator, vma::Allocation memory) {
+        alloc = memory;
+        allocator.bindImageMemory(alloc, image);
+        create_image_view(device);
+    }
     void destroy(DeviceWrapper& device, vma::Allocator allocator) {
-        allocator.destroyImage(image, alloc);
+        if (ownsMemory) allocator.destroyImage(image, alloc);
+        else device.logicalDevice.destroyImage(image);
         device.logicalDevice.destroyImageView(imageView);
     }
     
@@ -59,8 +74,54 @@ public:
 				.setBaseMipLevel(0).setLevelCount(1));
 		commandBuffer.pipelineBarrier(firstScope, secondScope, {}, {}, {}, barrier);
     }
+
+    // barrier with explicit access scopes, also used for queue family ownership transfers (release and acquire)
+    void barrier(vk::CommandBuffer commandBuffer, vk::ImageLayout from, vk::ImageLayout to,
+        vk::PipelineStageFlags srcStage, vk::AccessFlags srcAccess, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess,
+        uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED) {
+
+        vk::ImageMemoryBarrier barrier = vk::ImageMemoryBarrier()
+            .setOldLayout(from)
+            .setNewLayout(to)
+            .setSrcAccessMask(srcAccess)
+            .setDstAccessMask(dstAccess)
+            .setSrcQueueFamilyIndex(srcQueueFamily)
+            .setDstQueueFamilyIndex(dstQueueFamily)
+            .setImage(image)
+            .setSubresourceRange(vk::ImageSubresourceRange()
+                .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                .setBaseArrayLayer(0).setLayerCount(1)
+                .setBaseMipLevel(0).setLevelCount(1));
+        commandBuffer.pipelineBarrier(srcStage, dstStage, {}, {}, {}, barrier);
+    }
    
-    void load_buffer(DeviceWrapper& device, vma::Allocator& allocator, vk::CommandPool& commandPool, vk::Buffer buffer) {
+    // copy of a whole buffer (slices one after another) into the image, which has to be in the transfer dst layout
+    void record_upload(vk::CommandBuffer commandBuffer, vk::Buffer buffer) {
+        vk::BufferImageCopy region = vk::BufferImageCopy()
+            .setBufferRowLength(extent.width)
+            .setBufferImageHeight(extent.height)
+            .setImageExtent(extent)
+            .setImageSubresource(vk::ImageSubresourceLayers()
+                .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                .setBaseArrayLayer(0).setLayerCount(1)
+                .setMipLevel(0));
+        commandBuffer.copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, region);
+    }
+    // the reverse, tightly packed rows, the image has to be in the transfer src layout
+    void record_download(vk::CommandBuffer commandBuffer, vk::Buffer buffer) {
+        vk::BufferImageCopy region = vk::BufferImageCopy()
+            .setBufferRowLength(extent.width)
+            .setBufferImageHeight(extent.height)
+            .setImageExtent(extent)
+            .setImageSubresource(vk::ImageSubresourceLayers()
+                .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                .setBaseArrayLayer(0).setLayerCount(1)
+                .setMipLevel(0));
+        commandBuffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, buffer, region);
+    }
+    // optional profiler times the copy as pass 0 of slot 0, which has to be reset already (transfer queues can't reset query pools,
+    // see GpuProfiler::reset_host), results can be collected right after
+    void load_buffer(DeviceWrapper& device, vma::Allocator& allocator, vk::CommandPool& commandPool, vk::Buffer buffer, GpuProfiler* pProfiler = nullptr) {
         vk::CommandBufferAllocateInfo allocInfo = vk::CommandBufferAllocateInfo()
             .setLevel(vk::CommandBufferLevel::ePrimary)
             .setCommandPool(commandPool)
@@ -89,8 +150,10 @@ public:
                 .setBaseArrayLayer(0).setLayerCount(1)
                 .setMipLevel(0));
         
+        if (pProfiler) pProfiler->begin(commandBuffer, 0, 0);
         transition_layout(commandBuffer, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
         commandBuffer.copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, region);
+        if (pProfiler) pProfiler->end(commandBuffer, 0, 0);
         commandBuffer.end();
 
         vk::SubmitInfo submitInfo = vk::SubmitInfo()
@@ -102,6 +165,78 @@ public:
         // free command buffer directly after use
         device.logicalDevice.freeCommandBuffers(commandPool, commandBuffer);
     }
+    // queue has to belong to the family of the command pool and own the image
+    void store_buffer(DeviceWrapper& device, vk::CommandPool& commandPool, vk::Queue queue, vk::Buffer buffer, vk::ImageLayout layout) {
+        vk::CommandBufferAllocateInfo allocInfo = vk::CommandBufferAllocateInfo()
+            .setLevel(vk::CommandBufferLevel::ePrimary)
+            .setCommandPool(commandPool)
+            .setCommandBufferCount(1);
+
+        vk::CommandBuffer commandBuffer;
+        vk::Result res = device.logicalDevice.allocateCommandBuffers(&allocInfo, &commandBuffer);
+        if (res != vk::Result::eSuccess) VMI_ERR("Failed to allocate command buffer");
+
+        // begin recording to temporary command buffer
+        vk::CommandBufferBeginInfo beginInfo = vk::CommandBufferBeginInfo()
+            .setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+        commandBuffer.begin(beginInfo);
+
+        vk::BufferImageCopy region = vk::BufferImageCopy()
+            // buffer
+            .setBufferRowLength(extent.width)
+            .setBufferImageHeight(extent.height)
+            .setBufferOffset(0)
+            // img
+            .setImageExtent(extent)
+            .setImageOffset(0)
+            .setImageSubresource(vk::ImageSubresourceLayers()
+                .setAspectMask(vk::ImageAspectFlagBits::eColor)
+                .setBaseArrayLayer(0).setLayerCount(1)
+                .setMipLevel(0));
+
+        // copy out and restore the previous layout afterwards
+        transition_layout(commandBuffer, layout, vk::ImageLayout::eTransferSrcOptimal);
+        commandBuffer.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, buffer, region);
+        transition_layout(commandBuffer, vk::ImageLayout::eTransferSrcOptimal, layout);
+
+        // make the copy visible to the host
+        vk::MemoryBarrier memoryBarrier = vk::MemoryBarrier().setSrcAccessMask(vk::AccessFlagBits::eTransferWrite).setDstAccessMask(vk::AccessFlagBits::eHostRead);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, memoryBarrier, {}, {});
+        commandBuffer.end();
+
+        vk::SubmitInfo submitInfo = vk::SubmitInfo()
+            .setCommandBufferCount(1)
+            .setPCommandBuffers(&commandBuffer);
+        queue.submit(submitInfo);
+        queue.waitIdle();
+
+        // free command buffer directly after use
+        device.logicalDevice.freeCommandBuffers(commandPool, commandBuffer);
+    }
+    // reads back the whole image (float formats only), image is expected to be in the given layout and idle
+    std::vector<float> read_back(DeviceWrapper& device, vma::Allocator& allocator, vk::CommandPool& commandPool, vk::Queue queue, vk::ImageLayout layout) {
+        vk::DeviceSize totalSize = (vk::DeviceSize)extent.width * extent.height * extent.depth * get_texel_size();
+
+        // readback buffer
+        vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+            .setSize(totalSize)
+            .setUsage(vk::BufferUsageFlagBits::eTransferDst);
+        vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+            .setUsage(vma::MemoryUsage::eAuto)
+            .setFlags(vma::AllocationCreateFlagBits::eHostAccessRandom | vma::AllocationCreateFlagBits::eMapped);
+        vma::AllocationInfo allocInfo;
+        auto readbackBuffer = allocator.createBuffer(bufferInfo, allocCreateInfo, allocInfo);
+
+        store_buffer(device, commandPool, queue, readbackBuffer.first, layout);
+        allocator.invalidateAllocation(readbackBuffer.second, 0, VK_WHOLE_SIZE);
+
+        std::vector<float> data(totalSize / sizeof(float));
+        memcpy(data.data(), allocInfo.pMappedData, totalSize);
+
+        // clean up
+        allocator.destroyBuffer(readbackBuffer.first, readbackBuffer.second);
+        return data;
+    }
     void load2D(DeviceWrapper& device, vma::Allocator& allocator, vk::CommandPool& commandPool, const char* filename) {
         if (!std::filesystem::exists(filename)) {
             VMI_ERR("Could not find specified image: " << filename);
@@ -109,6 +244,10 @@ public:
 
 		int width, height, srcChannels;
 		stbi_uc* pImg = stbi_load(filename, &width, &height, &srcChannels, STBI_rgb_alpha);
+		if (!pImg) {
+			VMI_ERR("Could not decode image: " << filename << " (" << stbi_failure_reason() << ")");
+			return;
+		}
 		vk::DeviceSize fileSize = width * height * STBI_rgb_alpha;
         
         // staging buffer
@@ -131,12 +270,123 @@ public:
 		stbi_image_free(pImg);
     }
     void load3D(DeviceWrapper& device, vma::Allocator& allocator, vk::CommandPool& commandPool, 
-            const char* foldername, const char* commonFilename, std::vector<int> imageIndices) {
+            const char* foldername, const char* commonFilename, std::vector<int> imageIndices, GpuProfiler* pProfiler = nullptr) {
+        TRACE_SCOPE("ImageWrapper::load3D");
+        std::vector<std::string> files = find_files(foldername, commonFilename, imageIndices);
+
+        // total/slice buffer sizes
+        vk::DeviceSize fileSize = extent.width * extent.height * STBI_rgb_alpha;
+        vk::DeviceSize totalSize = extent.width * extent.height * STBI_rgb_alpha * extent.depth;
 
+        // staging buffer
+		vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+			.setSize(totalSize)
+			.setUsage(vk::BufferUsageFlagBits::eTransferSrc);
+		vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+			.setUsage(vma::MemoryUsage::eAuto)
+			.setFlags(vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped);
+		vma::AllocationInfo allocInfo;
+		auto stagingBuffer = allocator.createBuffer(bufferInfo, allocCreateInfo, allocInfo);
+        
+		// copy into staging buffer
+        int srcWidth, srcHeight, srcChannels;
+        char* pBuffer = reinterpret_cast<char*>(allocInfo.pMappedData);
+        for (int i = 0; i < files.size(); i++) {
+            TRACE_SCOPE("stbi_load");
+            stbi_uc* pImg = stbi_load(files[i].c_str(), &srcWidth, &srcHeight, &srcChannels, STBI_rgb_alpha);
+            if (!pImg) {
+                VMI_ERR("Could not decode light field image: " << files[i] << " (" << stbi_failure_reason() << ")");
+                continue;
+            }
+            // copy into temp buffer with fileSize as stride
+            if (srcWidth != extent.width || srcHeight != extent.height) VMI_ERR("Light field image size does not match: " << files[i]);
+            else memcpy(pBuffer + i * fileSize, pImg, fileSize);
+		    stbi_image_free(pImg);
+        }
+
+        TRACE_SCOPE("upload");
+        load_buffer(device, allocator, commandPool, stagingBuffer.first, pProfiler);
+
+		// clean up
+		allocator.destroyBuffer(stagingBuffer.first, stagingBuffer.second);
+    }
+    // uploads rows [iFirstRow, iFirstRow + height) of every slice of a taller host image with the same width and depth
+    void load_rows(DeviceWrapper& device, vma::Allocator& allocator, vk::CommandPool& commandPool, const uint8_t* pData, uint32_t srcHeight, uint32_t iFirstRow,
+            GpuProfiler* pProfiler = nullptr) {
+        vk::DeviceSize rowSize = (vk::DeviceSize)extent.width * get_texel_size();
+        vk::DeviceSize sliceSize = rowSize * extent.height;
+
+        // staging buffer
+		vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+			.setSize(sliceSize * extent.depth)
+			.setUsage(vk::BufferUsageFlagBits::eTransferSrc);
+		vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+			.setUsage(vma::MemoryUsage::eAuto)
+			.setFlags(vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped);
+		vma::AllocationInfo allocInfo;
+		auto stagingBuffer = allocator.createBuffer(bufferInfo, allocCreateInfo, allocInfo);
+
+        // rows of each slice are contiguous, so one copy per slice
+        char* pBuffer = reinterpret_cast<char*>(allocInfo.pMappedData);
+        for (uint32_t i = 0; i < extent.depth; i++) {
+            memcpy(pBuffer + i * sliceSize, pData + (i * srcHeight + iFirstRow) * rowSize, sliceSize);
+        }
+        load_buffer(device, allocator, commandPool, stagingBuffer.first, pProfiler);
+
+		// clean up
+		allocator.destroyBuffer(stagingBuffer.first, stagingBuffer.second);
+    }
+    // decodes the images load3D() would load into host memory (rgba8, one slice per image), empty if any of them fails
+    static std::vector<uint8_t> read_files(const char* foldername, const char* commonFilename, std::vector<int> imageIndices, vk::Extent2D& extent) {
+        TRACE_SCOPE("ImageWrapper::read_files");
+        extent = get_file_extent(foldername, commonFilename, imageIndices);
+        if (extent.width == 0) return {};
+        std::vector<uint8_t> data((size_t)extent.width * extent.height * STBI_rgb_alpha * imageIndices.size());
+        if (!decode_files(foldername, commonFilename, imageIndices, extent, data.data())) return {};
+        return data;
+    }
+    // decodes into memory of the caller (e.g. a mapped staging buffer), false if an image is missing or of another size
+    static bool decode_files(const char* foldername, const char* commonFilename, std::vector<int> imageIndices, vk::Extent2D extent, uint8_t* pDst) {
+        std::vector<std::string> files = find_files(foldername, commonFilename, imageIndices);
+        size_t fileSize = (size_t)extent.width * extent.height * STBI_rgb_alpha;
+
+        bool complete = files.size() == imageIndices.size();
+        int srcWidth = 0, srcHeight = 0, srcChannels;
+        for (size_t i = 0; i < files.size(); i++) {
+            TRACE_SCOPE("stbi_load");
+            stbi_uc* pImg = stbi_load(files[i].c_str(), &srcWidth, &srcHeight, &srcChannels, STBI_rgb_alpha);
+            if (!pImg) {
+                VMI_ERR("Could not decode light field image: " << files[i] << " (" << stbi_failure_reason() << ")");
+                complete = false;
+                continue;
+            }
+            if (srcWidth != extent.width || srcHeight != extent.height) {
+                VMI_ERR("Light field image size does not match: " << files[i]);
+                complete = false;
+            }
+            else memcpy(pDst + i * fileSize, pImg, fileSize);
+            stbi_image_free(pImg);
+        }
+        return complete;
+    }
+    // native size of the images load3D() would load, read from the first file header only
+    static vk::Extent2D get_file_extent(const char* foldername, const char* commonFilename, std::vector<int> imageIndices) {
+        std::vector<std::string> files = find_files(foldername, commonFilename, imageIndices);
+        int width = 0, height = 0, channels = 0;
+        if (files.empty() || !stbi_info(files[0].c_str(), &width, &height, &channels)) {
+            VMI_ERR("Could not read image size in: " << foldername);
+        }
+        return vk::Extent2D((uint32_t)width, (uint32_t)height);
+    }
+
+private:
+    // sorted files in a folder containing the given substring, reduced to the requested indices
+    static std::vector<std::string> find_files(const char* foldername, const char* commonFilename, std::vector<int>& imageIndices) {
         // iterate over all files/folders
         const std::filesystem::path directory{foldername};
         if (!std::filesystem::exists(directory)) {
             VMI_ERR("Could not find specified directory: " << foldername);
+            return {};
         }
 
         uint32_t nFiles = 0;
@@ -163,44 +413,28 @@ public:
             files[i] = files[imageIndices[i]];
         }
         files.resize(imageIndices.size());
-
-        // total/slice buffer sizes
-        vk::DeviceSize fileSize = extent.width * extent.height * STBI_rgb_alpha;
-        vk::DeviceSize totalSize = extent.width * extent.height * STBI_rgb_alpha * extent.depth;
-
-        // staging buffer
-		vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
-			.setSize(totalSize)
-			.setUsage(vk::BufferUsageFlagBits::eTransferSrc);
-		vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
-			.setUsage(vma::MemoryUsage::eAuto)
-			.setFlags(vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped);
-		vma::AllocationInfo allocInfo;
-		auto stagingBuffer = allocator.createBuffer(bufferInfo, allocCreateInfo, allocInfo);
-        
-		// copy into staging buffer
-        int srcWidth, srcHeight, srcChannels;
-        char* pBuffer = reinterpret_cast<char*>(allocInfo.pMappedData);
-        for (int i = 0; i < files.size(); i++) {
-            stbi_uc* pImg = stbi_load(files[i].c_str(), &srcWidth, &srcHeight, &srcChannels, STBI_rgb_alpha);
-            // copy into temp buffer with fileSize as stride
-            memcpy(pBuffer + i * fileSize, pImg, fileSize);
-		    stbi_image_free(pImg);
-        }
-
-        load_buffer(device, allocator, commandPool, stagingBuffer.first);
-
-		// clean up
-		allocator.destroyBuffer(stagingBuffer.first, stagingBuffer.second);
+        return files;
     }
 
 public:
     vk::Image get_image() { return image; }
     vk::ImageView get_image_view() { return imageView; }
+    vk::Extent3D get_extent() { return extent; }
+    vma::Allocation get_allocation() { return alloc; }
+    uint32_t get_texel_size() {
+        switch (colorFormat) {
+            case vk::Format::eR8G8B8A8Unorm:
+            case vk::Format::eR8G8B8A8Srgb:
+            case vk::Format::eR32Sfloat: return 4;
+            case vk::Format::eR32G32Sfloat: return 8;
+            case vk::Format::eR32G32B32A32Sfloat: return 16;
+            default: VMI_ERR("Unhandled image format for texel size"); return 0;
+        }
+    }
 
 private:
-    void create_image(vma::Allocator allocator, vk::ImageUsageFlags usage) {
-        vk::ImageCreateInfo imageCreateInfo = vk::ImageCreateInfo()
+    vk::ImageCreateInfo get_image_info(vk::ImageUsageFlags usage) {
+        return vk::ImageCreateInfo()
 			.setImageType(extent.depth > 1 ? vk::ImageType::e3D : vk::ImageType::e2D)
 			.setExtent(extent)
 			//
@@ -210,13 +444,17 @@ private:
 			.setTiling(vk::ImageTiling::eOptimal)
 			.setUsage(usage)
 			.setFormat(colorFormat);
+    }
+    void create_image(vma::Allocator allocator, vk::ImageUsageFlags usage) {
+        vk::ImageCreateInfo imageCreateInfo = get_image_info(usage);
 
+        // vma decides between dedicated and sub-allocated memory (pipeline images are placed by MemoryPools instead)
 		vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
-			.setUsage(vma::MemoryUsage::eAutoPreferDevice)
-			.setFlags(vma::AllocationCreateFlagBits::eDedicatedMemory);
+			.setUsage(vma::MemoryUsage::eAutoPreferDevice);
             
 		vk::Result result = allocator.createImage(&imageCreateInfo, &allocCreateInfo, &image, &alloc, nullptr);
 		if (result != vk::Result::eSuccess) VMI_ERR("Failed to create image");
+        ownsMemory = true;
     }
     void create_image_view(DeviceWrapper& device) {
         vk::ImageSubresourceRange subresourceRange = vk::ImageSubresourceRange()
@@ -242,4 +480,5 @@ private:
     vk::Image image;
     vk::ImageView imageView;
     vma::Allocation alloc;
+    bool ownsMemory = true; // false for images bound to MemoryPools memory
 };
\ No newline at end of file
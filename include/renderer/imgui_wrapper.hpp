@@ -7,10 +7,10 @@ public:
 	~ImguiWrapper() = default;
 
 public:
-	void init(DeviceWrapper& device, SwapchainWrapper& swapchain, Window& window, SwapchainWrite& swapchainWrite)
+	void init(DeviceWrapper& device, SwapchainWrapper& swapchain, Window& window, SwapchainWrite& swapchainWrite, vk::PipelineCache pipelineCache)
 	{
 		imgui_create_desc_pool(device);
-		imgui_init_vulkan(device, swapchain, window, swapchainWrite);
+		imgui_init_vulkan(device, swapchain, window, swapchainWrite, pipelineCache);
 		imgui_upload_fonts(device, swapchain);
 	}
 	void destroy(DeviceWrapper& device)
@@ -46,7 +46,7 @@ private:
 
 		descPool = device.logicalDevice.createDescriptorPool(info);
 	}
-	void imgui_init_vulkan(DeviceWrapper& device, SwapchainWrapper& swapchain, Window& window, SwapchainWrite& swapchainWrite)
+	void imgui_init_vulkan(DeviceWrapper& device, SwapchainWrapper& swapchain, Window& window, SwapchainWrite& swapchainWrite, vk::PipelineCache pipelineCache)
 	{
 		struct ImGui_ImplVulkan_InitInfo info = { 0 };
 		info.Instance = window.get_vulkan_instance();
@@ -54,7 +54,7 @@ private:
 		info.Device = device.logicalDevice;
 		info.QueueFamily = device.iGraphicsQueue;
 		info.Queue = device.graphicsQueue;
-		info.PipelineCache = nullptr;
+		info.PipelineCache = pipelineCache;
 		info.DescriptorPool = descPool;
 		info.Subpass = 0;
 		info.MinImageCount = swapchain.get_image_count();
@@ -65,6 +65,7 @@ private:
 	}
 	void imgui_upload_fonts(DeviceWrapper& device, SwapchainWrapper& swapchain)
 	{
+		TRACE_SCOPE("ImguiWrapper::upload_fonts");
 		SyncFrame& syncFrame = swapchain.get_sync_frame();
 		vk::CommandBuffer commandBuffer = syncFrame.commandBuffer;
 		device.logicalDevice.resetCommandPool(syncFrame.commandPool);
@@ -82,7 +83,8 @@ private:
 			.setPCommandBuffers(&commandBuffer);
 		device.graphicsQueue.submit(submitInfo);
 
-		device.logicalDevice.waitIdle();
+		// only the graphics queue, startup jobs may be using the others
+		device.graphicsQueue.waitIdle();
 		ImGui_ImplVulkan_DestroyFontUploadObjects();
 	}
 
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "device/device_wrapper.hpp"
+
+// kernel variant chosen by --autotune for each device and driver, persisted as one line per device in a text file
+// that machines with different devices can share: vendor id, device id, driver version, variant, ms/frame and the device name
+class KernelTuning
+{
+public:
+	// name of the tuned variant, empty if this device and driver were never tuned
+	static std::string load(DeviceWrapper& device, const std::string& filename) {
+		if (filename.empty()) return "";
+		std::ifstream file(filename);
+		std::string line;
+		while (std::getline(file, line)) {
+			Entry entry;
+			if (parse(line, entry) && entry.key == get_key(device)) {
+				VMI_LOG("    Kernel variant " << entry.variant << " (tuned at " << entry.ms << " ms/frame)");
+				return entry.variant;
+			}
+		}
+		return "";
+	}
+	// replaces the entry of this device and driver, entries of other devices are kept
+	static void store(DeviceWrapper& device, const std::string& filename, const std::string& variant, double ms) {
+		std::vector<std::string> lines;
+		{
+			std::ifstream file(filename);
+			std::string line;
+			while (std::getline(file, line)) {
+				Entry entry;
+				if (!parse(line, entry) || entry.key != get_key(device)) lines.push_back(line);
+			}
+		}
+		Key key = get_key(device);
+		std::ostringstream entry;
+		entry << std::hex << key[0] << " " << key[1] << std::dec << " " << key[2] << " " << variant << " " << ms << " # " << device.deviceProperties.deviceName.data();
+		lines.push_back(entry.str());
+
+		// write to a temporary file first and swap it in, like the pipeline cache
+		std::string tempFilename = filename + ".tmp";
+		{
+			std::ofstream file(tempFilename, std::ios::trunc);
+			for (const std::string& line : lines) file << line << "\n";
+			if (!file) {
+				VMI_WARN("Failed to write kernel tuning: " << tempFilename);
+				return;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(tempFilename, filename, error);
+		if (error) VMI_WARN("Failed to replace kernel tuning: " << error.message());
+		else VMI_LOG("Stored kernel variant " << variant << " for " << device.deviceProperties.deviceName.data() << " in " << filename);
+	}
+
+private:
+	typedef std::array<uint32_t, 3> Key; // vendor id, device id, driver version
+	struct Entry
+	{
+		Key key;
+		std::string variant;
+		double ms;
+	};
+
+	static Key get_key(DeviceWrapper& device) {
+		return { device.deviceProperties.vendorID, device.deviceProperties.deviceID, device.deviceProperties.driverVersion };
+	}
+	// comments and malformed lines are skipped
+	static bool parse(const std::string& line, Entry& entry) {
+		if (line.empty() || line[0] == '#') return false;
+		std::istringstream stream(line);
+		stream >> std::hex >> entry.key[0] >> entry.key[1] >> std::dec >> entry.key[2] >> entry.variant >> entry.ms;
+		return !stream.fail();
+	}
+};
@@ -0,0 +1,316 @@
+#pragma once
+
+#include "vk_mem_alloc.hpp"
+#include "image_wrapper.hpp"
+#include "utils/ring_buffer.hpp"
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// sequence of light fields (rgba8 views of the same size, one slice after another)
+class LightFieldSource
+{
+public:
+	enum class Read { eFrame, eSkipped, eEnd };
+
+public:
+	virtual ~LightFieldSource() = default;
+	// width, height and number of views of every frame
+	virtual vk::Extent3D get_extent() = 0;
+	// frames are numbered in the order decoders claim them and may be read concurrently. eSkipped for a frame that could not be
+	// decoded (the stream goes on), eEnd at the end of the stream (every later frame ends it as well)
+	virtual Read read(uint64_t iFrame, uint8_t* pDst) = 0;
+	// unblocks pending reads before the decoders are joined
+	virtual void stop() {}
+};
+
+// every subfolder is one frame in the layout of a single scene, in lexicographic order
+class FolderSource : public LightFieldSource
+{
+public:
+	bool init(const std::string& path, std::vector<int> indices) {
+		this->indices = indices;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+			if (entry.is_directory()) folders.push_back(entry.path().string());
+		}
+		std::sort(folders.begin(), folders.end());
+		if (folders.empty()) {
+			VMI_ERR("No frame folders in " << path);
+			return false;
+		}
+		extent = ImageWrapper::get_file_extent(folders[0].c_str(), "input_Cam", indices);
+		VMI_LOG("    Streaming " << folders.size() << " frames from " << path);
+		return extent.width > 0;
+	}
+	vk::Extent3D get_extent() override { return vk::Extent3D(extent, (uint32_t)indices.size()); }
+	Read read(uint64_t iFrame, uint8_t* pDst) override {
+		if (iFrame >= folders.size()) return Read::eEnd;
+		if (ImageWrapper::decode_files(folders[iFrame].c_str(), "input_Cam", indices, extent, pDst)) return Read::eFrame;
+		VMI_ERR("Could not decode frame " << folders[iFrame] << ", skipped");
+		return Read::eSkipped;
+	}
+
+private:
+	std::vector<std::string> folders;
+	std::vector<int> indices;
+	vk::Extent2D extent;
+};
+
+// stand-in for a capture rig: a single client connects to a unix socket and sends frames, each one a FrameHeader
+// followed by width * height * 4 * nViews bytes of rgba8 views (in the order of the scene views, u major)
+class SocketSource : public LightFieldSource
+{
+public:
+	struct FrameHeader
+	{
+		uint32_t magic; // frameMagic
+		uint32_t width, height, nViews;
+	};
+	static constexpr uint32_t frameMagic = 0x5246464c; // "LFFR"
+
+public:
+	~SocketSource() {
+#ifndef _WIN32
+		if (client >= 0) close(client);
+		if (server >= 0) close(server);
+		if (!path.empty()) unlink(path.c_str());
+#endif
+	}
+	// waits for the client and its first header, which fixes the size of all frames
+	bool init(const std::string& path) {
+#ifdef _WIN32
+		VMI_ERR("Socket streams are not supported on this platform");
+		return false;
+#else
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path)) {
+			VMI_ERR("Socket path too long: " << path);
+			return false;
+		}
+		strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+		unlink(path.c_str());
+		server = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (server < 0 || bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(server, 1) != 0) {
+			VMI_ERR("Could not listen on " << path);
+			return false;
+		}
+		this->path = path;
+
+		VMI_LOG("    Waiting for a light field stream on " << path << "...");
+		client = accept(server, nullptr, nullptr);
+		if (client < 0 || !read_header()) {
+			VMI_ERR("No light field stream received on " << path);
+			return false;
+		}
+		extent = vk::Extent3D(header.width, header.height, header.nViews);
+		headerPending = true;
+		return true;
+#endif
+	}
+	vk::Extent3D get_extent() override { return extent; }
+	// the socket is read strictly in frame order, decoders wait for their turn. a malformed frame ends the stream,
+	// there is no way to find the next header after it
+	Read read(uint64_t iFrame, uint8_t* pDst) override {
+		std::unique_lock<std::mutex> lock(mutex);
+		turn.wait(lock, [&]() { return ended || iNextFrame == iFrame; });
+		bool valid = !ended && (headerPending || read_header()) &&
+			header.width == extent.width && header.height == extent.height && header.nViews == extent.depth &&
+			read_bytes(pDst, (size_t)extent.width * extent.height * 4 * extent.depth);
+		headerPending = false;
+		if (valid) iNextFrame++;
+		else ended = true;
+		turn.notify_all();
+		return valid ? Read::eFrame : Read::eEnd;
+	}
+	void stop() override {
+		// a pending read holds the lock until recv returns
+#ifndef _WIN32
+		if (client >= 0) shutdown(client, SHUT_RDWR);
+#endif
+		std::lock_guard<std::mutex> lock(mutex);
+		ended = true;
+		turn.notify_all();
+	}
+
+private:
+	bool read_header() {
+		return read_bytes(reinterpret_cast<uint8_t*>(&header), sizeof(FrameHeader)) && header.magic == frameMagic;
+	}
+	bool read_bytes(uint8_t* pDst, size_t size) {
+#ifndef _WIN32
+		while (size > 0) {
+			ssize_t nRead = recv(client, pDst, size, 0);
+			if (nRead <= 0) return false; // closed by the client (end of stream) or stopped
+			pDst += nRead;
+			size -= (size_t)nRead;
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+
+private:
+	int server = -1, client = -1;
+	std::string path;
+	FrameHeader header = {};
+	bool headerPending = false; // the header of the first frame was read by init
+	vk::Extent3D extent;
+	uint64_t iNextFrame = 0;
+	bool ended = false;
+	std::mutex mutex;
+	std::condition_variable turn;
+};
+
+// decodes a source on worker threads into a bounded ring of persistently mapped staging buffers, handed out in frame order.
+// when all slots are taken, decoders either wait (eBlock: every frame is processed, the source is slowed down)
+// or overwrite the oldest decoded frame that was not picked up yet (eDropOldest: latency stays bounded)
+class LightFieldStream
+{
+public:
+	enum class Policy { eBlock, eDropOldest };
+	enum class State { eFree, eDecoding, eReady, eInUse, eSkipped }; // skipped: could not be decoded, passed over by acquire
+	struct Slot
+	{
+		void destroy(vma::Allocator& allocator) {
+			allocator.destroyBuffer(buffer, alloc);
+		}
+
+		vk::Buffer buffer;
+		vma::Allocation alloc;
+		vma::AllocationInfo allocInfo;
+		State state = State::eFree;
+		uint64_t iFrame = 0;
+		std::chrono::steady_clock::time_point arrival; // when decoding started
+	};
+
+public:
+	void init(vma::Allocator allocator, std::unique_ptr<LightFieldSource> pSource, uint32_t nSlots, Policy policy, uint32_t nDecoders) {
+		TRACE_SCOPE("LightFieldStream::init");
+		this->allocator = allocator;
+		this->pSource = std::move(pSource);
+		this->policy = policy;
+		vk::Extent3D extent = get_extent();
+
+		vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+			.setSize((vk::DeviceSize)extent.width * extent.height * 4 * extent.depth)
+			.setUsage(vk::BufferUsageFlagBits::eTransferSrc);
+		vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+			.setUsage(vma::MemoryUsage::eAuto)
+			.setFlags(vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped);
+		slots.set_size(std::max(nSlots, 2u));
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			auto buffer = allocator.createBuffer(bufferInfo, allocCreateInfo, slots[i].allocInfo);
+			slots[i].buffer = buffer.first;
+			slots[i].alloc = buffer.second;
+		}
+
+		for (uint32_t i = 0; i < std::max(nDecoders, 1u); i++) decoders.emplace_back([this]() { decode(); });
+	}
+	void destroy() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			condition.notify_all();
+		}
+		if (pSource) pSource->stop();
+		for (std::thread& decoder : decoders) decoder.join();
+		decoders.clear();
+		slots.destroy(allocator);
+		pSource.reset();
+	}
+
+	inline vk::Extent3D get_extent() { return pSource->get_extent(); }
+	// oldest frame that was not picked up yet, waits until it is decoded, null at the end of the stream
+	Slot* acquire() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			Slot& slot = slots[iRead % slots.size()];
+			if (slot.state == State::eReady) {
+				slot.state = State::eInUse;
+				iRead++;
+				return &slot;
+			}
+			if (slot.state == State::eSkipped) {
+				slot.state = State::eFree;
+				iRead++;
+				condition.notify_all();
+				continue;
+			}
+			// frames after the failed one fail as well, so a free slot at the read position is the end
+			if (stopping || (ended && slot.state == State::eFree)) return nullptr;
+			condition.wait(lock);
+		}
+	}
+	// once nothing reads the staging buffer of the frame anymore
+	void release(Slot* pSlot) {
+		std::lock_guard<std::mutex> lock(mutex);
+		pSlot->state = State::eFree;
+		condition.notify_all();
+	}
+	inline uint64_t get_dropped() { return nDropped.load(std::memory_order_relaxed); }
+
+private:
+	void decode() {
+		while (true) {
+			std::unique_lock<std::mutex> lock(mutex);
+			// slots are claimed in ring order, so the one at the write position holds the oldest claimed frame
+			while (true) {
+				if (stopping || ended) return;
+				Slot& slot = slots.get_current();
+				if (slot.state == State::eFree) break;
+				// it was the next one to be picked up
+				if (slot.state == State::eSkipped) {
+					iRead++;
+					break;
+				}
+				if (slot.state == State::eReady && policy == Policy::eDropOldest) {
+					nDropped.fetch_add(1, std::memory_order_relaxed);
+					iRead++;
+					break;
+				}
+				condition.wait(lock);
+			}
+			Slot& slot = slots.get_current();
+			slots.get_next();
+			slot.state = State::eDecoding;
+			slot.iFrame = nClaimed++;
+			slot.arrival = std::chrono::steady_clock::now();
+			lock.unlock();
+
+			LightFieldSource::Read result;
+			{
+				TRACE_SCOPE("LightFieldStream::decode");
+				result = pSource->read(slot.iFrame, reinterpret_cast<uint8_t*>(slot.allocInfo.pMappedData));
+				// host visible memory is not necessarily coherent
+				if (result == LightFieldSource::Read::eFrame) allocator.flushAllocation(slot.alloc, 0, VK_WHOLE_SIZE);
+			}
+
+			lock.lock();
+			switch (result) {
+				case LightFieldSource::Read::eFrame: slot.state = State::eReady; break;
+				case LightFieldSource::Read::eSkipped: slot.state = State::eSkipped; break;
+				case LightFieldSource::Read::eEnd: slot.state = State::eFree; ended = true; break;
+			}
+			condition.notify_all();
+		}
+	}
+
+private:
+	vma::Allocator allocator;
+	std::unique_ptr<LightFieldSource> pSource;
+	Policy policy = Policy::eBlock;
+	RingBuffer<Slot> slots; // the current element is the write position
+	uint64_t iRead = 0; // frames handed out so far (including dropped ones), modulo the slot count the read position
+	uint64_t nClaimed = 0;
+	std::atomic<uint64_t> nDropped{ 0 };
+	bool ended = false;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::vector<std::thread> decoders;
+};
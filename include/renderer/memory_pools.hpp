@@ -0,0 +1,108 @@
+#pragma once
+
+#include "vk_mem_alloc.hpp"
+#include "image_wrapper.hpp"
+
+// places the images of a pipeline in a single custom vma pool block whose size is known up front,
+// images in an aliased group share one region (their contents may never be needed at the same time)
+class MemoryPools
+{
+public:
+	// images have to be created with ImageWrapper::init_unbound() and stay alive until destroy()
+	void add(DeviceWrapper& device, ImageWrapper& image, const std::string& name) {
+		add_aliased(device, { &image }, name);
+	}
+	void add_aliased(DeviceWrapper& device, std::vector<ImageWrapper*> images, const std::string& name) {
+		Region region = { name, images, vk::MemoryRequirements().setMemoryTypeBits(UINT32_MAX) };
+		for (ImageWrapper* pImage : images) {
+			vk::MemoryRequirements requirements = device.logicalDevice.getImageMemoryRequirements(pImage->get_image());
+			region.requirements.size = std::max(region.requirements.size, requirements.size);
+			region.requirements.alignment = std::max(region.requirements.alignment, requirements.alignment);
+			region.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+		}
+		regions.push_back(region);
+	}
+	// creates the pool with exactly one block for all added regions and binds every image
+	void allocate(DeviceWrapper& device, vma::Allocator allocator) {
+		TRACE_SCOPE("MemoryPools::allocate");
+		if (regions.empty()) return;
+		vk::MemoryRequirements total = vk::MemoryRequirements().setMemoryTypeBits(UINT32_MAX);
+		for (Region& region : regions) {
+			total.size = (total.size + region.requirements.alignment - 1) / region.requirements.alignment * region.requirements.alignment;
+			total.size += region.requirements.size;
+			total.alignment = std::max(total.alignment, region.requirements.alignment);
+			total.memoryTypeBits &= region.requirements.memoryTypeBits;
+		}
+
+		vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+			.setRequiredFlags(vk::MemoryPropertyFlagBits::eDeviceLocal);
+		uint32_t iMemoryType = allocator.findMemoryTypeIndex(total.memoryTypeBits, allocCreateInfo);
+		iHeap = device.deviceMemProperties.memoryTypes[iMemoryType].heapIndex;
+
+		// allocated and freed as a whole, so the linear algorithm packs the regions without fragmentation
+		vma::PoolCreateInfo poolInfo = vma::PoolCreateInfo()
+			.setMemoryTypeIndex(iMemoryType)
+			.setFlags(vma::PoolCreateFlagBits::eLinearAlgorithm)
+			.setBlockSize(total.size + total.alignment)
+			.setMinBlockCount(1)
+			.setMaxBlockCount(1);
+		pool = allocator.createPool(poolInfo);
+		blockSize = poolInfo.blockSize;
+
+		allocCreateInfo = vma::AllocationCreateInfo().setPool(pool);
+		for (Region& region : regions) {
+			region.memory = allocator.allocateMemory(region.requirements, allocCreateInfo);
+			for (ImageWrapper* pImage : region.images) pImage->bind(device, allocator, region.memory);
+		}
+	}
+	// images have to be destroyed by their owners, before or after
+	void destroy(vma::Allocator allocator) {
+		for (Region& region : regions) {
+			if (region.memory) allocator.freeMemory(region.memory);
+		}
+		regions.clear();
+		if (pool) allocator.destroyPool(pool);
+		pool = nullptr;
+		blockSize = 0;
+	}
+
+	// per region sizes, the pool block and the budget of every heap in use (VK_EXT_memory_budget if enabled, heap sizes otherwise)
+	void log_usage(DeviceWrapper& device, vma::Allocator allocator) {
+		VMI_LOG("Memory:");
+		vk::DeviceSize unaliasedSize = 0;
+		for (Region& region : regions) {
+			unaliasedSize += region.requirements.size * region.images.size();
+			VMI_LOG("    " << region.name << ": " << to_mib(region.requirements.size) << " MiB"
+				<< (region.images.size() > 1 ? " shared by " + std::to_string(region.images.size()) + " images" : ""));
+		}
+		VMI_LOG("    pool block: " << to_mib(blockSize) << " MiB (" << to_mib(unaliasedSize) << " MiB without aliasing) in heap " << iHeap);
+
+		std::vector<vma::Budget> budgets = get_heap_budgets(device, allocator);
+		for (uint32_t i = 0; i < budgets.size(); i++) {
+			if (budgets[i].usage == 0 && budgets[i].statistics.blockBytes == 0) continue;
+			VMI_LOG("    heap " << i << ": " << to_mib(budgets[i].statistics.blockBytes) << " MiB by this process, "
+				<< to_mib(budgets[i].usage) << " / " << to_mib(budgets[i].budget) << " MiB used / budget");
+		}
+	}
+	static std::vector<vma::Budget> get_heap_budgets(DeviceWrapper& device, vma::Allocator allocator) {
+		std::vector<vma::Budget> budgets(device.deviceMemProperties.memoryHeapCount);
+		allocator.getHeapBudgets(budgets.data());
+		return budgets;
+	}
+	static double to_mib(vk::DeviceSize size) { return (double)size / (1024.0 * 1024.0); }
+
+	inline vk::DeviceSize get_block_size() { return blockSize; }
+
+private:
+	struct Region
+	{
+		std::string name;
+		std::vector<ImageWrapper*> images;
+		vk::MemoryRequirements requirements; // large enough for all of its images
+		vma::Allocation memory;
+	};
+	std::vector<Region> regions;
+	vma::Pool pool;
+	vk::DeviceSize blockSize = 0;
+	uint32_t iHeap = 0;
+};
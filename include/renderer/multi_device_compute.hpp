@@ -0,0 +1,267 @@
+#pragma once
+
+#include "vk_mem_alloc.hpp"
+#include "image_wrapper.hpp"
+#include "compute_frame.hpp"
+#include "memory_pools.hpp"
+#include "pipeline_cache.hpp"
+#include "kernel_tuning.hpp"
+#include "pipelines/disparity_compute.hpp"
+#include "utils/pfm.hpp"
+#include "utils/arguments.hpp"
+
+// headless disparity split into horizontal bands, one per device,
+// each band is extended by a halo of input rows so devices never have to exchange intermediate results
+class MultiDeviceCompute
+{
+public:
+	void init(std::vector<DeviceWrapper*> devices, Window& window, Arguments& args) {
+		TRACE_SCOPE("MultiDeviceCompute::init");
+		VMI_LOG("[Initializing] Multi-device compute (" << devices.size() << " devices)...");
+
+		// decoded once on the host, each device only uploads its own band
+		std::vector<int> indices = { 38, 48, 57, 40, 49, 58, 41, 50, 59 };
+		std::string folder = "benchmark/training/cotton/";
+		lightField = ImageWrapper::read_files(folder.c_str(), "input_Cam", indices, extent);
+		if (lightField.empty()) {
+			VMI_ERR("Multi-device compute needs the light field in " << folder);
+			return;
+		}
+		nSlices = (uint32_t)indices.size();
+		estimatorName = args.estimator;
+		std::unique_ptr<DisparityEstimator> estimator = EstimatorRegistry::create(estimatorName);
+		if (!estimator || !estimator->is_local()) {
+			VMI_WARN("Multi-device compute falls back to the gradient estimator, the bands would not reproduce the " << estimatorName << " estimator");
+			estimatorName = "gradient";
+		}
+		VMI_WARN("Multi-device compute marks pixels below a fixed confidence per step as uncertain, instead of the least confident percentile");
+
+		for (DeviceWrapper* pDevice : devices) {
+			workers.push_back(std::make_unique<Worker>());
+			Worker& worker = *workers.back();
+			worker.pDevice = pDevice;
+			create_vma_allocator(worker, window);
+			create_command_pools(worker);
+			create_descriptor_pools(worker);
+			worker.pipelineCache.init(*pDevice, ""); // caches are device specific, so none of them is persisted
+			worker.kernelVariant = KernelTuning::load(*pDevice, args.tuningFile); // the devices may differ in their fastest variant
+		}
+
+		// start with equal bands, rebalance() adjusts them to the measured throughput
+		std::vector<double> weights(workers.size(), 1.0);
+		split(weights);
+	}
+	// false if init could not load the light field
+	inline bool is_ready() { return !workers.empty(); }
+	void destroy() {
+		for (std::unique_ptr<Worker>& pWorker : workers) {
+			Worker& worker = *pWorker;
+			DeviceWrapper& device = *worker.pDevice;
+			destroy_band(worker);
+			worker.pipelineCache.destroy(device);
+			device.logicalDevice.destroyDescriptorPool(worker.descPool);
+			device.logicalDevice.destroyCommandPool(worker.transferCommandPool);
+			worker.allocator.destroy();
+		}
+		workers.clear();
+	}
+
+	// computes every band concurrently, returns the wall time until the last device finished
+	double compute(PushConstants pcs) {
+		TRACE_SCOPE("MultiDeviceCompute::compute");
+		uint64_t recordHash = Hash::combine(Hash::seed, pcs);
+
+		auto start = std::chrono::steady_clock::now();
+		for (std::unique_ptr<Worker>& pWorker : workers) submit(*pWorker, pcs, recordHash);
+
+		// poll instead of waiting in order, so every device gets its own completion time
+		size_t nPending = workers.size();
+		for (std::unique_ptr<Worker>& pWorker : workers) pWorker->pending = true;
+		while (nPending > 0) {
+			for (std::unique_ptr<Worker>& pWorker : workers) {
+				Worker& worker = *pWorker;
+				if (!worker.pending || worker.pDevice->logicalDevice.getFenceStatus(worker.frame.commandBufferFence) != vk::Result::eSuccess) continue;
+				worker.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				worker.rowsPerMs = worker.nHaloRows / std::max(worker.ms, 1e-3);
+				worker.pending = false;
+				nPending--;
+			}
+			if (nPending > 0) std::this_thread::yield();
+		}
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	// resizes the bands in proportion to the throughput measured by the last compute()
+	void rebalance() {
+		TRACE_SCOPE("MultiDeviceCompute::rebalance");
+		std::vector<double> weights;
+		for (std::unique_ptr<Worker>& pWorker : workers) weights.push_back(pWorker->rowsPerMs);
+		split(weights);
+	}
+	// gathers the core rows of every band into one map and writes it to a .pfm file (devices have to be idle)
+	void export_disparity(const std::string& filename) {
+		std::vector<float> data((size_t)extent.width * extent.height * 4);
+		size_t rowSize = (size_t)extent.width * 4;
+		for (std::unique_ptr<Worker>& pWorker : workers) {
+			Worker& worker = *pWorker;
+			std::vector<float> band = worker.frame.disparityImage.read_back(*worker.pDevice, worker.allocator, worker.frame.commandPool,
+				worker.pDevice->computeQueue, vk::ImageLayout::eShaderReadOnlyOptimal);
+			memcpy(data.data() + worker.iFirstRow * rowSize, band.data() + (worker.iFirstRow - worker.iHaloRow) * rowSize, worker.nRows * rowSize * sizeof(float));
+		}
+		PfmFile::write(filename, extent.width, extent.height, data.data() + 3, 4);
+		VMI_LOG("Exported disparity map to " << filename);
+	}
+	void log_bands() {
+		for (std::unique_ptr<Worker>& pWorker : workers) {
+			Worker& worker = *pWorker;
+			VMI_LOG("    " << worker.pDevice->deviceProperties.deviceName << ": rows " << worker.iFirstRow << "-" << worker.iFirstRow + worker.nRows
+				<< " (+" << worker.nHaloRows - worker.nRows << " halo), " << worker.ms << " ms, " << worker.rowsPerMs << " rows/ms");
+		}
+	}
+
+private:
+	struct Worker
+	{
+		DeviceWrapper* pDevice = nullptr;
+		vma::Allocator allocator;
+		vk::CommandPool transferCommandPool;
+		vk::DescriptorPool descPool;
+		PipelineCache pipelineCache;
+		std::string kernelVariant;
+		MemoryPools memoryPools;
+
+		DisparityCompute disparityCompute;
+		ComputeFrame frame;
+		ImageWrapper lightFieldImage = { vk::Format::eR8G8B8A8Unorm };
+		bool bandCreated = false;
+
+		uint32_t iFirstRow = 0, nRows = 0; // rows of the final map this device is responsible for
+		uint32_t iHaloRow = 0, nHaloRows = 0; // rows it actually computes, including the halo
+		bool pending = false;
+		double ms = 0.0; // from submission until the device finished
+		double rowsPerMs = 0.0;
+	};
+
+	// divides the rows according to the given weights, every device keeps at least one row
+	void split(const std::vector<double>& weights) {
+		double totalWeight = 0.0;
+		for (double weight : weights) totalWeight += weight;
+
+		uint32_t iRow = 0;
+		double accumulated = 0.0;
+		for (size_t i = 0; i < workers.size(); i++) {
+			accumulated += weights[i];
+			uint32_t nRemaining = (uint32_t)(workers.size() - i - 1);
+			uint32_t iEnd = i + 1 == workers.size() ? extent.height : (uint32_t)std::lround(extent.height * accumulated / totalWeight);
+			iEnd = std::clamp(iEnd, iRow + 1, extent.height - nRemaining);
+			create_band(*workers[i], iRow, iEnd - iRow);
+			iRow = iEnd;
+		}
+	}
+	void create_band(Worker& worker, uint32_t iFirstRow, uint32_t nRows) {
+		TRACE_SCOPE("MultiDeviceCompute::create_band");
+		DeviceWrapper& device = *worker.pDevice;
+		if (worker.bandCreated && worker.iFirstRow == iFirstRow && worker.nRows == nRows) return;
+		destroy_band(worker);
+
+		worker.iFirstRow = iFirstRow;
+		worker.nRows = nRows;
+		worker.iHaloRow = iFirstRow > DisparityCompute::haloSize ? iFirstRow - DisparityCompute::haloSize : 0;
+		worker.nHaloRows = std::min(iFirstRow + nRows + DisparityCompute::haloSize, extent.height) - worker.iHaloRow;
+		vk::Extent2D bandExtent = vk::Extent2D(extent.width, worker.nHaloRows);
+
+		vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+		worker.lightFieldImage.init(device, worker.allocator, vk::Extent3D(bandExtent, nSlices), usage);
+		worker.lightFieldImage.load_rows(device, worker.allocator, worker.transferCommandPool, lightField.data(), extent.height, worker.iHaloRow);
+		worker.lightFieldImage.transition_layout(device, worker.transferCommandPool, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+		worker.frame.init(device, worker.allocator, bandExtent);
+		ComputeFrame::place_images(device, { &worker.frame }, worker.memoryPools);
+		worker.memoryPools.allocate(device, worker.allocator);
+		worker.disparityCompute.init(device, worker.allocator, worker.pipelineCache.get(), worker.descPool, worker.lightFieldImage,
+			{ worker.frame.get_phase_outputs() }, { worker.frame.statsBuffer }, estimatorName, worker.kernelVariant);
+		// a percentile over one band (and its halo) would differ from band to band and leave seams between them
+		worker.disparityCompute.set_fixed_threshold(true);
+		worker.bandCreated = true;
+	}
+	void destroy_band(Worker& worker) {
+		if (!worker.bandCreated) return;
+		DeviceWrapper& device = *worker.pDevice;
+		device.logicalDevice.waitIdle();
+		worker.disparityCompute.destroy(device, worker.allocator);
+		worker.frame.destroy(device, worker.allocator);
+		worker.memoryPools.destroy(worker.allocator);
+		worker.lightFieldImage.destroy(device, worker.allocator);
+		// the pool only ever holds the sets of this band
+		device.logicalDevice.resetDescriptorPool(worker.descPool);
+		worker.bandCreated = false;
+	}
+	// replays the recorded command buffer as long as the parameters stay the same
+	void submit(Worker& worker, PushConstants pcs, uint64_t recordHash) {
+		DeviceWrapper& device = *worker.pDevice;
+		ComputeFrame& frame = worker.frame;
+		vk::Result result = device.logicalDevice.waitForFences(frame.commandBufferFence, VK_TRUE, UINT64_MAX);
+		if (result != vk::Result::eSuccess) assert(false);
+		device.logicalDevice.resetFences(frame.commandBufferFence);
+
+		vk::CommandBuffer commandBuffer = frame.commandBuffers[0];
+		if (!frame.recorded[0] || frame.recordedHashes[0] != recordHash) {
+			commandBuffer.begin(vk::CommandBufferBeginInfo());
+			worker.disparityCompute.record(commandBuffer, frame.get_phase_outputs(), pcs, 0, 0);
+			frame.disparityImage.barrier(commandBuffer, vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite,
+				vk::PipelineStageFlagBits::eBottomOfPipe, {});
+			commandBuffer.end();
+			frame.recorded[0] = true;
+			frame.recordedHashes[0] = recordHash;
+		}
+
+		vk::SubmitInfo submitInfo = vk::SubmitInfo()
+			.setCommandBufferCount(1).setPCommandBuffers(&commandBuffer);
+		device.computeQueue.submit(submitInfo, frame.commandBufferFence);
+	}
+
+	void create_vma_allocator(Worker& worker, Window& window) {
+		vk::DynamicLoader dl;
+		vma::VulkanFunctions vulkanFunctions = vma::VulkanFunctions()
+			.setVkGetDeviceProcAddr(dl.getProcAddress<PFN_vkGetDeviceProcAddr>("vkGetDeviceProcAddr"))
+			.setVkGetInstanceProcAddr(dl.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr"));
+		vma::AllocatorCreateInfo info = vma::AllocatorCreateInfo()
+			.setPhysicalDevice(worker.pDevice->physicalDevice)
+			.setPVulkanFunctions(&vulkanFunctions)
+			.setDevice(worker.pDevice->logicalDevice)
+			.setInstance(window.get_vulkan_instance())
+			.setVulkanApiVersion(VK_API_VERSION)
+			.setFlags(vma::AllocatorCreateFlagBits::eKhrDedicatedAllocation);
+		if (worker.pDevice->memoryBudget) info.flags |= vma::AllocatorCreateFlagBits::eExtMemoryBudget;
+
+		worker.allocator = vma::createAllocator(info);
+	}
+	void create_command_pools(Worker& worker) {
+		vk::CommandPoolCreateInfo commandPoolInfo = vk::CommandPoolCreateInfo()
+			.setQueueFamilyIndex(worker.pDevice->iTransferQueue)
+			.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+		worker.transferCommandPool = worker.pDevice->logicalDevice.createCommandPool(commandPoolInfo);
+	}
+	void create_descriptor_pools(Worker& worker) {
+		// a single band: one light field, the phase outputs and the immutable sampler,
+		// with room for a set of estimator resources (estimators free their sets when destroyed)
+		std::array<vk::DescriptorPoolSize, 4> poolSizes = {
+			vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, 2),
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, DisparityCompute::nPhases + 4),
+			vk::DescriptorPoolSize(vk::DescriptorType::eSampler, 1),
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 2 + 4) // stats and partial sums
+		};
+		vk::DescriptorPoolCreateInfo info = vk::DescriptorPoolCreateInfo()
+			.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+			.setMaxSets(2)
+			.setPoolSizes(poolSizes);
+		worker.descPool = worker.pDevice->logicalDevice.createDescriptorPool(info);
+	}
+
+private:
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<uint8_t> lightField; // rgba8 slices at native resolution
+	vk::Extent2D extent; // of the light field and the gathered disparity map
+	uint32_t nSlices = 0;
+	std::string estimatorName; // the same on every device, fixed for the lifetime of the bands
+};
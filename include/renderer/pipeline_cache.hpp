@@ -0,0 +1,125 @@
+#pragma once
+
+#include "device/device_wrapper.hpp"
+
+// single vk::PipelineCache shared by all pipelines, persisted to disk between runs
+class PipelineCache
+{
+public:
+	// an empty filename keeps the cache in memory only
+	void init(DeviceWrapper& device, const std::string& filename) {
+		this->filename = filename;
+		create_header(device);
+
+		std::vector<char> data;
+		if (!filename.empty()) data = load_data();
+		vk::PipelineCacheCreateInfo info = vk::PipelineCacheCreateInfo()
+			.setInitialDataSize(data.size())
+			.setPInitialData(data.empty() ? nullptr : data.data());
+		pipelineCache = device.logicalDevice.createPipelineCache(info);
+	}
+	void destroy(DeviceWrapper& device) {
+		if (!filename.empty()) store_data(device);
+		device.logicalDevice.destroyPipelineCache(pipelineCache);
+	}
+
+	inline vk::PipelineCache get() { return pipelineCache; }
+
+private:
+	// identifies the device and driver the cached data was created with
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint8_t deviceUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t dataHash;
+	};
+
+	void create_header(DeviceWrapper& device) {
+		auto properties = device.physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+		vk::PhysicalDeviceProperties& deviceProperties = properties.get<vk::PhysicalDeviceProperties2>().properties;
+		vk::PhysicalDeviceIDProperties& idProperties = properties.get<vk::PhysicalDeviceIDProperties>();
+
+		header = {};
+		header.magic = cacheMagic;
+		header.version = cacheVersion;
+		header.vendorID = deviceProperties.vendorID;
+		header.deviceID = deviceProperties.deviceID;
+		header.driverVersion = deviceProperties.driverVersion;
+		memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+		memcpy(header.deviceUUID, idProperties.deviceUUID.data(), VK_UUID_SIZE);
+	}
+	std::vector<char> load_data() {
+		std::string spacing = "    ";
+		std::ifstream file(filename, std::ios::binary);
+		if (!file) {
+			VMI_LOG(spacing << "No pipeline cache found at " << filename);
+			return {};
+		}
+
+		// only accept data from the same device and driver
+		Header fileHeader;
+		file.read(reinterpret_cast<char*>(&fileHeader), sizeof(Header));
+		if (!file ||
+			fileHeader.magic != header.magic || fileHeader.version != header.version ||
+			fileHeader.vendorID != header.vendorID || fileHeader.deviceID != header.deviceID ||
+			fileHeader.driverVersion != header.driverVersion ||
+			memcmp(fileHeader.pipelineCacheUUID, header.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+			memcmp(fileHeader.deviceUUID, header.deviceUUID, VK_UUID_SIZE) != 0) {
+			VMI_LOG(spacing << "Discarding pipeline cache of a different device or driver");
+			return {};
+		}
+
+		// the size is read from disk, a truncated or corrupted file must not decide the allocation
+		std::streamoff dataStart = file.tellg();
+		file.seekg(0, std::ios::end);
+		uint64_t remaining = (uint64_t)(file.tellg() - dataStart);
+		file.seekg(dataStart);
+		if (fileHeader.dataSize != remaining) {
+			VMI_WARN("Discarding corrupted pipeline cache: " << filename);
+			return {};
+		}
+		std::vector<char> data(fileHeader.dataSize);
+		file.read(data.data(), data.size());
+		if (!file || Hash::combine(Hash::seed, data.data(), data.size()) != fileHeader.dataHash) {
+			VMI_WARN("Discarding corrupted pipeline cache: " << filename);
+			return {};
+		}
+
+		VMI_LOG(spacing << "Loaded pipeline cache (" << data.size() << " bytes)");
+		return data;
+	}
+	void store_data(DeviceWrapper& device) {
+		std::vector<uint8_t> data = device.logicalDevice.getPipelineCacheData(pipelineCache);
+		header.dataSize = data.size();
+		header.dataHash = Hash::combine(Hash::seed, data.data(), data.size());
+
+		// write to a temporary file first and swap it in, so a crash never leaves a partial cache behind
+		std::string tempFilename = filename + ".tmp";
+		{
+			std::ofstream file(tempFilename, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+			file.write(reinterpret_cast<const char*>(data.data()), data.size());
+			if (!file) {
+				VMI_WARN("Failed to write pipeline cache: " << tempFilename);
+				return;
+			}
+		}
+		std::error_code error;
+		std::filesystem::rename(tempFilename, filename, error);
+		if (error) VMI_WARN("Failed to replace pipeline cache: " << error.message());
+	}
+
+private:
+	static constexpr uint32_t cacheMagic = 0x4346444c; // "LDFC"
+	static constexpr uint32_t cacheVersion = 1;
+
+	vk::PipelineCache pipelineCache;
+	std::string filename;
+	Header header;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "device/device_wrapper.hpp"
+#include "renderer/image_wrapper.hpp"
+#include "renderer/push_constants.hpp"
+#include "renderer/pipelines/disparity_compute.hpp"
+
+// bindless counterpart to DisparityCompute, processes a whole batch of scenes per dispatch
+// (requires VK_EXT_descriptor_indexing, see DeviceWrapper::descriptorIndexing)
+class DisparityBatch
+{
+public:
+    void init(DeviceWrapper& device, vk::PipelineCache pipelineCache, uint32_t nMaxScenes);
+    void destroy(DeviceWrapper& device);
+    // binds a new batch of scenes, frees the previous descriptor set (none of its dispatches may be pending)
+    void bind(DeviceWrapper& device, std::vector<ImageWrapper*>& inputImages, std::vector<DisparityCompute::PhaseOutputs>& outputImages);
+    void execute(vk::CommandBuffer commandBuffer, PushConstants pcs) {
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descSet, {});
+        commandBuffer.pushConstants<PushConstants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pcs);
+        vk::Extent2D groupCount = DisparityCompute::get_group_count(pcs.iPhase, extent);
+        commandBuffer.dispatch(groupCount.width, groupCount.height, nScenes);
+    }
+
+    // largest batch the device can bind at once (one light field and nPhases storage images per scene)
+    static uint32_t get_max_scenes(DeviceWrapper& device) {
+        vk::PhysicalDeviceLimits& limits = device.deviceProperties.limits;
+        uint32_t nMaxScenes = std::min(limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages);
+        nMaxScenes = std::min(nMaxScenes, std::min(limits.maxPerStageDescriptorStorageImages, limits.maxDescriptorSetStorageImages) / DisparityCompute::nPhases);
+        return std::min(nMaxScenes, maxBatchSize);
+    }
+
+private:
+    void create_sampler(DeviceWrapper& device) {
+        vk::SamplerCreateInfo samplerInfo = vk::SamplerCreateInfo()
+            .setMagFilter(vk::Filter::eLinear)
+            .setMinFilter(vk::Filter::eLinear)
+            .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+            .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+        sampler = device.logicalDevice.createSampler(samplerInfo);
+    }
+    // a full batch takes nPhases storage images per scene, far more than the pools shared with the other pipelines hold
+    void create_descriptor_pool(DeviceWrapper& device, uint32_t nMaxScenes) {
+        std::array<vk::DescriptorPoolSize, 3> poolSizes = {
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, nMaxScenes),
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, nMaxScenes * DisparityCompute::nPhases),
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampler, 1)
+        };
+        vk::DescriptorPoolCreateInfo info = vk::DescriptorPoolCreateInfo()
+            .setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet)
+            .setMaxSets(1)
+            .setPoolSizes(poolSizes);
+        descPool = device.logicalDevice.createDescriptorPool(info);
+    }
+    void create_layout_bindings(DeviceWrapper& device, uint32_t nMaxScenes) {
+        // image arrays (light fields, followed by the output of each phase) and the input sampler
+        std::array<vk::DescriptorSetLayoutBinding, 2 + DisparityCompute::nPhases> bindings;
+        std::array<vk::DescriptorBindingFlagsEXT, 2 + DisparityCompute::nPhases> bindingFlags;
+        for (uint32_t i = 0; i < 1 + DisparityCompute::nPhases; i++) {
+            bindings[i] = vk::DescriptorSetLayoutBinding()
+                .setBinding(i)
+                .setDescriptorCount(nMaxScenes)
+                .setDescriptorType(i == 0 ? vk::DescriptorType::eSampledImage : vk::DescriptorType::eStorageImage)
+                .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+            bindingFlags[i] = vk::DescriptorBindingFlagBitsEXT::ePartiallyBound;
+        }
+        bindings[1 + DisparityCompute::nPhases] = vk::DescriptorSetLayoutBinding()
+            .setBinding(1 + DisparityCompute::nPhases)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eSampler)
+            .setImmutableSamplers(sampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        bindingFlags[1 + DisparityCompute::nPhases] = {};
+
+        vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT()
+            .setBindingFlags(bindingFlags);
+		vk::DescriptorSetLayoutCreateInfo createInfo = vk::DescriptorSetLayoutCreateInfo()
+			.setBindings(bindings)
+            .setPNext(&flagsInfo);
+		descSetLayout = device.logicalDevice.createDescriptorSetLayout(createInfo);
+
+        // push constants
+        vk::PushConstantRange pushConstantRange = PushConstants::get_range();
+
+        // create pipeline layout
+        vk::PipelineLayoutCreateInfo layoutInfo = vk::PipelineLayoutCreateInfo()
+            .setPushConstantRanges(pushConstantRange)
+            .setSetLayouts(descSetLayout);
+        pipelineLayout = device.logicalDevice.createPipelineLayout(layoutInfo);
+    }
+
+private:
+    static constexpr uint32_t maxBatchSize = 256; // bounds the descriptor pool of the batch
+    vk::Extent3D extent; // of the largest scene in the current batch
+    uint32_t nScenes = 0;
+
+    vk::Pipeline computePipeline;
+    vk::PipelineLayout pipelineLayout;
+
+	vk::DescriptorSetLayout descSetLayout;
+	vk::DescriptorSet descSet;
+    vk::DescriptorPool descPool; // holds the single set of the current batch
+
+    vk::ShaderModule cs;
+    vk::Sampler sampler;
+};
@@ -3,69 +3,222 @@
 #include "device/device_wrapper.hpp"
 #include "renderer/image_wrapper.hpp"
 #include "renderer/push_constants.hpp"
+#include "renderer/pipelines/disparity_estimator.hpp"
 
 class DisparityCompute 
 {
 public:
-    void init(DeviceWrapper& device, vk::DescriptorPool descPool, ImageWrapper& inputImage, ImageWrapper& outputImage);
-    void destroy(DeviceWrapper& device);
-    void execute(vk::CommandBuffer commandBuffer, PushConstants pcs) {
+    // phase 0: gradients, phase 1: disparity estimate and edges, phase 2: confidence cutoff,
+    // phase 3 and 4: horizontal and vertical pass of the edge-aware post filter
+    static constexpr uint32_t nPhases = 5;
+    // matches FILTER_MAX_RADIUS in disparity_phases.hlsli
+    static constexpr uint32_t maxFilterRadius = 32;
+    // rows/columns of input each output pixel depends on in every direction (3x3 gradients, 3x3 sobel, then the filter)
+    static constexpr uint32_t haloSize = 2 + maxFilterRadius;
+    typedef std::array<ImageWrapper*, nPhases> PhaseOutputs;
+
+    // reductions over the phase outputs (disparity_stats_cs), each one a dispatch with the pass index as iPhase
+    enum StatsPass : uint32_t {
+        eClearConfidence, eAccumulateConfidence, eResolveConfidence,
+        eClearDisparity, eDisparityRange, eDisparityHistogram, eResolveDisparity,
+        eFixedConfidence // resolves the confidence like eResolveConfidence, but with a fixed threshold per step
+    };
+    // mirrors DisparityStats in disparity_stats.hlsli (std430)
+    static constexpr uint32_t nStatsBins = 128;
+    struct Stats
+    {
+        uint32_t confidenceMin, confidenceMax, disparityMin, disparityMax; // order preserving encodings
+        float confidenceMean, confidenceThreshold, disparityMean, disparityLow;
+        float disparityHigh;
+        uint32_t nPixels, nCertain, pad;
+        uint32_t confidenceHistogram[nStatsBins];
+        uint32_t disparityHistogram[nStatsBins];
+    };
+    // the stats buffer of every output set holds the stats, followed by per group partial sums at an offset
+    // that satisfies any minStorageBufferOffsetAlignment (at most 256)
+    static constexpr vk::DeviceSize statsPartialsOffset = (sizeof(Stats) + 255) / 256 * 256;
+    static vk::DeviceSize get_stats_size(vk::Extent2D extent) {
+        vk::Extent2D groupCount = get_group_count(0, vk::Extent3D(extent, 1));
+        return statsPartialsOffset + (vk::DeviceSize)groupCount.width * groupCount.height * 4 * sizeof(float);
+    }
+
+public:
+    // one descriptor set is created for each set of phase outputs (and its stats buffer), which determine the dispatch size.
+    // phases 0 and 1 are recorded by the named estimator (see EstimatorRegistry), the remaining phases are shared by all estimators.
+    // the kernel variant is usually the one tuned for the device (see KernelTuning), empty or unknown names select the default
+    void init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool, ImageWrapper& inputImage,
+        std::vector<PhaseOutputs> outputImages, std::vector<vk::Buffer> statsBuffers, const std::string& estimatorName = "gradient",
+        const std::string& variantName = "");
+    void destroy(DeviceWrapper& device, vma::Allocator allocator);
+    // replaces the estimator, the pool has to be the one passed to init and nothing recorded with the previous one may still be pending
+    // (falls back to the current estimator for unknown names)
+    void set_estimator(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, const std::string& name);
+    inline DisparityEstimator& get_estimator() { return *estimator; }
+    // the cutoff is the confidence percentile selected by nSteps by default, which is only meaningful over the whole image,
+    // outputs that are bands of a larger image (see MultiDeviceCompute) use a fixed threshold per step instead (takes effect on the next record)
+    inline void set_fixed_threshold(bool enabled) { fixedThreshold = enabled; }
+    // recreates the phase pipelines (and the estimator) with another kernel variant, with the same requirements as set_estimator
+    void set_kernel_variant(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, const std::string& name);
+    inline const KernelVariant& get_kernel_variant() { return variant; }
+
+    // every compiled variant of disparity_cs, the first one is the default
+    static const std::vector<KernelVariant>& get_kernel_variants(); // see disparity_compute.cpp
+    static const KernelVariant& find_kernel_variant(const std::string& name);
+    // group shape and shared memory of the variant (the filter passes need 44 bytes per thread) are within the device limits,
+    // and its filter segments (two samples per thread) are at least as long as their halo
+    static bool is_supported(DeviceWrapper& device, const KernelVariant& variant) {
+        const vk::PhysicalDeviceLimits& limits = device.deviceProperties.limits;
+        return variant.get_threads() <= limits.maxComputeWorkGroupInvocations &&
+            variant.groupShape.width <= limits.maxComputeWorkGroupSize[0] && variant.groupShape.height <= limits.maxComputeWorkGroupSize[1] &&
+            44 * variant.get_threads() <= limits.maxComputeSharedMemorySize &&
+            variant.get_threads() >= 2 * maxFilterRadius;
+    }
+    // layout transitions, dispatches of all phases from iFirstPhase on and the barriers between them,
+    // outputs are left in the general layout (the profiler slot has to be reset beforehand).
+    // confidence stats are reduced after phase 1 and resolved into the cutoff threshold before phase 2,
+    // disparity stats after the last phase (timed as part of the phase next to them)
+    void record(vk::CommandBuffer commandBuffer, PhaseOutputs outputs, PushConstants pcs, uint32_t iFirstPhase, uint32_t iOutput,
+        GpuProfiler* pProfiler = nullptr, uint32_t iSlot = 0);
+    void execute(vk::CommandBuffer commandBuffer, PushConstants pcs, uint32_t iOutput) {
 
 		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline);
-		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descSet, {});
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descSets[iOutput], {});
+        commandBuffer.pushConstants<PushConstants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pcs);
+        vk::Extent2D groupCount = get_group_count(pcs.iPhase, extent, variant.groupShape);
+        commandBuffer.dispatch(groupCount.width, groupCount.height, 1);
+    }
+    // per pixel phases use 2D tiles, the filter passes one group per segment of a row (phase 3) or column (phase 4)
+    // (shaders other than the variants of disparity_cs use the default shape)
+    static vk::Extent2D get_group_count(uint32_t iPhase, vk::Extent3D extent, vk::Extent2D groupShape = { groupSize, groupSize }) {
+        // matches FILTER_SEGMENT
+        uint32_t filterSegment = 2 * groupShape.width * groupShape.height - 2 * maxFilterRadius;
+        switch (iPhase) {
+            case 3: return vk::Extent2D((extent.width + filterSegment - 1) / filterSegment, extent.height);
+            case 4: return vk::Extent2D(extent.width, (extent.height + filterSegment - 1) / filterSegment);
+            default: return vk::Extent2D((extent.width + groupShape.width - 1) / groupShape.width, (extent.height + groupShape.height - 1) / groupShape.height);
+        }
+    }
+
+    // single groups for clears and resolves, 2D tiles for the accumulation passes
+    void execute_stats(vk::CommandBuffer commandBuffer, PushConstants pcs, uint32_t iOutput, StatsPass pass) {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, statsPipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descSets[iOutput], {});
+        pcs.iPhase = pass;
         commandBuffer.pushConstants<PushConstants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pcs);
-        commandBuffer.dispatch(512 / 16, 512 / 16, 1);
+        bool accumulate = pass == eAccumulateConfidence || pass == eDisparityRange || pass == eDisparityHistogram;
+        vk::Extent2D groupCount = accumulate ? get_group_count(0, extent) : vk::Extent2D(1, 1);
+        commandBuffer.dispatch(groupCount.width, groupCount.height, 1);
+    }
+
+    // hash of everything each phase output depends on, chained so that a stale phase invalidates all following ones
+    static std::array<uint64_t, nPhases> get_phase_hashes(uint64_t inputHash, PushConstants pcs) {
+        std::array<uint64_t, nPhases> hashes;
+        hashes[0] = Hash::combine(Hash::seed, inputHash);
+        hashes[1] = hashes[0]; // no parameters of its own yet
+        hashes[2] = Hash::combine(hashes[1], pcs.nSteps);
+        hashes[3] = Hash::combine(Hash::combine(hashes[2], pcs.filterRadius), pcs.filterEdges);
+        hashes[4] = hashes[3]; // no parameters of its own
+        return hashes;
     }
 
 private:
-    void create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool, ImageWrapper& inputImage, ImageWrapper& outputImage) {
-        // set binding layouts
-        std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
+    void create_sampler(DeviceWrapper& device) {
+        // the light field is resampled when the outputs are smaller than its native resolution
+        vk::SamplerCreateInfo samplerInfo = vk::SamplerCreateInfo()
+            .setMagFilter(vk::Filter::eLinear)
+            .setMinFilter(vk::Filter::eLinear)
+            .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+            .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+        sampler = device.logicalDevice.createSampler(samplerInfo);
+    }
+    vk::Pipeline create_pipeline(DeviceWrapper& device, vk::PipelineCache pipelineCache, vk::ShaderModule shader);
+    void create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool, ImageWrapper& inputImage,
+        std::vector<PhaseOutputs>& outputImages, std::vector<vk::Buffer>& statsBuffers) {
+        // set binding layouts (input image, followed by the output of each phase, the input sampler, the stats and the partial sums)
+        std::array<vk::DescriptorSetLayoutBinding, 4 + nPhases> bindings;
 		bindings[0] = vk::DescriptorSetLayoutBinding()
 			.setBinding(0)
 			.setDescriptorCount(1)
 			.setDescriptorType(vk::DescriptorType::eSampledImage)
 			.setStageFlags(vk::ShaderStageFlagBits::eCompute);
-		bindings[1] = vk::DescriptorSetLayoutBinding()
-			.setBinding(1)
-			.setDescriptorCount(1)
-			.setDescriptorType(vk::DescriptorType::eStorageImage)
-			.setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        for (uint32_t i = 0; i < nPhases; i++) {
+            bindings[1 + i] = vk::DescriptorSetLayoutBinding()
+                .setBinding(1 + i)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageImage)
+                .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        }
+        bindings[1 + nPhases] = vk::DescriptorSetLayoutBinding()
+            .setBinding(1 + nPhases)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eSampler)
+            .setImmutableSamplers(sampler)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        for (uint32_t i = 2 + nPhases; i < 4 + nPhases; i++) {
+            bindings[i] = vk::DescriptorSetLayoutBinding()
+                .setBinding(i)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+        }
 		vk::DescriptorSetLayoutCreateInfo createInfo = vk::DescriptorSetLayoutCreateInfo()
 			.setBindings(bindings);
 		descSetLayout = device.logicalDevice.createDescriptorSetLayout(createInfo);
 
         // allocate the descriptor sets using descriptor pool
+        std::vector<vk::DescriptorSetLayout> layouts(outputImages.size(), descSetLayout);
         vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
             .setDescriptorPool(descPool)
-            .setDescriptorSetCount(1).setPSetLayouts(&descSetLayout);
-        descSet = device.logicalDevice.allocateDescriptorSets(allocInfo)[0];
-
-        // input image
-        vk::DescriptorImageInfo descriptor = vk::DescriptorImageInfo()
-            .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-            .setImageView(inputImage.get_image_view())
-            .setSampler(nullptr);
-        vk::WriteDescriptorSet descBufferWrites = vk::WriteDescriptorSet()
-            .setDstSet(descSet)
-            .setDstBinding(0)
-            .setDstArrayElement(0)
-            .setDescriptorType(vk::DescriptorType::eSampledImage)
-            .setImageInfo(descriptor);
-        device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
-
-        // output image
-        descriptor = vk::DescriptorImageInfo()
-            .setImageLayout(vk::ImageLayout::eGeneral)
-            .setImageView(outputImage.get_image_view())
-            .setSampler(nullptr);
-        descBufferWrites = vk::WriteDescriptorSet()
-            .setDstSet(descSet)
-            .setDstBinding(1)
-            .setDstArrayElement(0)
-            .setDescriptorType(vk::DescriptorType::eStorageImage)
-            .setImageInfo(descriptor);
-        device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+            .setSetLayouts(layouts);
+        descSets = device.logicalDevice.allocateDescriptorSets(allocInfo);
+        descSetPool = descPool;
+
+        for (size_t i = 0; i < outputImages.size(); i++) {
+            // input image
+            vk::DescriptorImageInfo descriptor = vk::DescriptorImageInfo()
+                .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+                .setImageView(inputImage.get_image_view())
+                .setSampler(nullptr);
+            vk::WriteDescriptorSet descBufferWrites = vk::WriteDescriptorSet()
+                .setDstSet(descSets[i])
+                .setDstBinding(0)
+                .setDstArrayElement(0)
+                .setDescriptorType(vk::DescriptorType::eSampledImage)
+                .setImageInfo(descriptor);
+            device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+
+            // phase output images
+            for (uint32_t iPhase = 0; iPhase < nPhases; iPhase++) {
+                descriptor = vk::DescriptorImageInfo()
+                    .setImageLayout(vk::ImageLayout::eGeneral)
+                    .setImageView(outputImages[i][iPhase]->get_image_view())
+                    .setSampler(nullptr);
+                descBufferWrites = vk::WriteDescriptorSet()
+                    .setDstSet(descSets[i])
+                    .setDstBinding(1 + iPhase)
+                    .setDstArrayElement(0)
+                    .setDescriptorType(vk::DescriptorType::eStorageImage)
+                    .setImageInfo(descriptor);
+                device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+            }
+
+            // stats and partial sums
+            std::array<vk::DescriptorBufferInfo, 2> bufferInfos = {
+                vk::DescriptorBufferInfo(statsBuffers[i], 0, sizeof(Stats)),
+                vk::DescriptorBufferInfo(statsBuffers[i], statsPartialsOffset, VK_WHOLE_SIZE)
+            };
+            for (uint32_t j = 0; j < bufferInfos.size(); j++) {
+                descBufferWrites = vk::WriteDescriptorSet()
+                    .setDstSet(descSets[i])
+                    .setDstBinding(2 + nPhases + j)
+                    .setDstArrayElement(0)
+                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                    .setBufferInfo(bufferInfos[j]);
+                device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+            }
+        }
 
         // push constants
         vk::PushConstantRange pushConstantRange = PushConstants::get_range();
@@ -78,12 +231,20 @@ private:
     }
 
 private:
+    static constexpr uint32_t groupSize = 16; // matches the defaults of GROUP_NX and GROUP_NY in disparity_phases.hlsli
+    vk::Extent3D extent; // of the phase outputs
+    KernelVariant variant; // of the phase pipeline (and the gradient estimator)
+
     vk::Pipeline computePipeline;
-	vk::PipelineCache pipelineCache; // TODO
+    vk::Pipeline statsPipeline; // shares the layout of the phases
     vk::PipelineLayout pipelineLayout;
 
 	vk::DescriptorSetLayout descSetLayout;
-	vk::DescriptorSet descSet;
+	std::vector<vk::DescriptorSet> descSets;
+    vk::DescriptorPool descSetPool; // pool the sets (including those of the estimator) were allocated from
 
-    vk::ShaderModule cs;
+    std::unique_ptr<DisparityEstimator> estimator; // phases 0 and 1
+    bool fixedThreshold = false;
+    vk::ShaderModule cs, statsCs;
+    vk::Sampler sampler;
 };
\ No newline at end of file
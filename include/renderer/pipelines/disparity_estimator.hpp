@@ -0,0 +1,126 @@
+#pragma once
+
+#include "device/device_wrapper.hpp"
+#include "renderer/image_wrapper.hpp"
+#include "renderer/push_constants.hpp"
+#include "renderer/pipelines/kernel_variant.hpp"
+
+// phases 0 and 1 of the disparity computation, from the light field to the estimate (disparity edges, confidence, raw disparity)
+// that the shared cutoff, filter and stats passes of DisparityCompute continue from.
+// pipelines bind the descriptor set of DisparityCompute as set 0 (light field, phase outputs, sampler, stats)
+// and may add resources of their own as set 1
+class DisparityEstimator
+{
+public:
+    struct Parameter
+    {
+        std::string name;
+        float value, min, max;
+    };
+    static constexpr uint32_t maxParameters = 4;
+    // push constants of every estimator pipeline, its parameters follow the shared ones
+    struct Constants
+    {
+        PushConstants pcs;
+        std::array<float, maxParameters> parameters = {};
+        uint32_t iStep = 0; // of passes repeated within a phase (e.g. the rows of a wavefront)
+        uint32_t pad[3] = {};
+    };
+
+public:
+    virtual ~DisparityEstimator() = default;
+    virtual std::string get_name() = 0;
+    // every estimate depends on at most DisparityCompute::haloSize rows of input in each direction,
+    // so bands with a halo reproduce the whole image (see MultiDeviceCompute)
+    virtual bool is_local() { return true; }
+    // one set of resources for each of the nOutputs sets of phase outputs with the given extent
+    virtual void init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+        vk::DescriptorSetLayout sharedLayout, vk::Extent3D extent, uint32_t nOutputs) = 0;
+    virtual void destroy(DeviceWrapper& device, vma::Allocator allocator) = 0;
+    // phase 0 or 1 with any number of dispatches, the phase outputs are in the general layout and
+    // DisparityCompute places a barrier between the phases (barriers within a phase are up to the estimator)
+    virtual void record_phase(vk::CommandBuffer commandBuffer, vk::DescriptorSet sharedSet, PushConstants pcs, uint32_t iPhase, uint32_t iOutput) = 0;
+
+    // variant of disparity_cs chosen for the device, set by DisparityCompute before init (estimators with shaders of their own ignore it)
+    inline void set_kernel_variant(const KernelVariant& variant) { kernelVariant = variant; }
+    // parameters of the estimator, changes rerun all phases
+    inline std::vector<Parameter>& get_parameters() { return parameters; }
+    uint64_t get_hash() {
+        std::string name = get_name();
+        uint64_t hash = Hash::combine(Hash::seed, name.data(), name.size());
+        for (Parameter& parameter : parameters) hash = Hash::combine(hash, parameter.value);
+        return hash;
+    }
+
+protected:
+    // pcs.iPhase selects the pass of the estimator's shader
+    Constants get_constants(PushConstants pcs, uint32_t iPass, uint32_t iStep = 0) {
+        Constants constants;
+        constants.pcs = pcs;
+        constants.pcs.iPhase = iPass;
+        constants.iStep = iStep;
+        for (size_t i = 0; i < parameters.size() && i < maxParameters; i++) constants.parameters[i] = parameters[i].value;
+        return constants;
+    }
+    vk::PipelineLayout create_pipeline_layout(DeviceWrapper& device, std::vector<vk::DescriptorSetLayout> setLayouts) {
+        vk::PushConstantRange pushConstantRange = vk::PushConstantRange()
+            .setSize(sizeof(Constants))
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+            .setOffset(0);
+        vk::PipelineLayoutCreateInfo layoutInfo = vk::PipelineLayoutCreateInfo()
+            .setPushConstantRanges(pushConstantRange)
+            .setSetLayouts(setLayouts);
+        return device.logicalDevice.createPipelineLayout(layoutInfo);
+    }
+    static vk::Pipeline create_pipeline(DeviceWrapper& device, vk::PipelineCache pipelineCache, vk::PipelineLayout layout, vk::ShaderModule shader) {
+        vk::PipelineShaderStageCreateInfo shaderInfo = vk::PipelineShaderStageCreateInfo()
+            .setStage(vk::ShaderStageFlagBits::eCompute)
+            .setModule(shader)
+            .setPName("main");
+        vk::ComputePipelineCreateInfo pipelineInfo = vk::ComputePipelineCreateInfo()
+            .setLayout(layout)
+            .setStage(shaderInfo);
+
+        TRACE_SCOPE("vkCreateComputePipelines");
+        auto result = device.logicalDevice.createComputePipeline(pipelineCache, pipelineInfo);
+        switch (result.result)
+        {
+            case vk::Result::eSuccess: break;
+            case vk::Result::ePipelineCompileRequiredEXT:
+                VMI_LOG("Compute pipeline creation: PipelineCompileRequiredEXT");
+                break;
+            default: assert(false);
+        }
+        return result.value;
+    }
+
+protected:
+    std::vector<Parameter> parameters;
+    KernelVariant kernelVariant = {};
+};
+
+// estimators by name, the built-in ones are registered first ("gradient" is the default)
+class EstimatorRegistry
+{
+public:
+    typedef std::function<std::unique_ptr<DisparityEstimator>()> Factory;
+    static void add(const std::string& name, Factory factory) {
+        get_entries().emplace_back(name, factory);
+    }
+    // null (and an error) for unknown names
+    static std::unique_ptr<DisparityEstimator> create(const std::string& name) {
+        for (auto& entry : get_entries()) {
+            if (entry.first == name) return entry.second();
+        }
+        VMI_ERR("Unknown disparity estimator: " << name);
+        return nullptr;
+    }
+    static std::vector<std::string> get_names() {
+        std::vector<std::string> names;
+        for (auto& entry : get_entries()) names.push_back(entry.first);
+        return names;
+    }
+
+private:
+    static std::vector<std::pair<std::string, Factory>>& get_entries(); // see disparity_estimator.cpp
+};
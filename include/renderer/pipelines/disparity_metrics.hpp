@@ -0,0 +1,63 @@
+#pragma once
+
+#include "device/device_wrapper.hpp"
+#include "renderer/image_wrapper.hpp"
+#include "renderer/push_constants.hpp"
+
+// HCI benchmark metrics (MSE*100 and BadPix) of the final disparity against a ground truth map, without the 15 pixel border
+// the benchmark's evaluation leaves out, reduced on the device so that only the few resulting values are read back
+class DisparityMetrics
+{
+public:
+    static constexpr uint32_t nThresholds = 3;
+    static constexpr std::array<float, nThresholds> badPixThresholds = { 0.01f, 0.03f, 0.07f };
+    // mirror Partial and Metrics in disparity_metrics_cs.hlsl (std430)
+    struct Partial
+    {
+        float squaredError;
+        uint32_t nBad[nThresholds];
+        uint32_t nPixels, pad[3];
+    };
+    struct Metrics
+    {
+        float mseX100;
+        float badPix[nThresholds]; // percent of pixels off by more than each threshold
+        uint32_t nPixels, pad[3];
+    };
+
+public:
+    // one descriptor set per disparity image, all of them are compared against the same ground truth
+    void init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+        std::vector<ImageWrapper*> disparityImages, ImageWrapper& groundTruthImage);
+    void destroy(DeviceWrapper& device, vma::Allocator allocator);
+    // images have to be in the shader read only layout and owned by the queue family the buffer is submitted to
+    void record(vk::CommandBuffer commandBuffer, uint32_t iInput);
+    // valid once the recorded commands have completed
+    Metrics get_metrics(vma::Allocator allocator) {
+        allocator.invalidateAllocation(metricsBuffer.second, 0, VK_WHOLE_SIZE);
+        Metrics metrics;
+        memcpy(&metrics, metricsInfo.pMappedData, sizeof(Metrics));
+        return metrics;
+    }
+
+private:
+    void create_buffers(vma::Allocator allocator);
+    void create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool, std::vector<ImageWrapper*>& disparityImages, ImageWrapper& groundTruthImage);
+
+private:
+    static constexpr uint32_t groupSize = 16; // matches GROUP_NX and GROUP_NY in disparity_metrics_cs.hlsl
+    vk::Extent3D extent; // of the disparity images
+    uint32_t nGroupsX = 0, nGroupsY = 0;
+
+    vk::Pipeline computePipeline;
+    vk::PipelineLayout pipelineLayout;
+
+    vk::DescriptorSetLayout descSetLayout;
+    std::vector<vk::DescriptorSet> descSets;
+
+    vk::ShaderModule cs;
+
+    std::pair<vk::Buffer, vma::Allocation> partialsBuffer; // device local, one Partial per group
+    std::pair<vk::Buffer, vma::Allocation> metricsBuffer; // persistently mapped
+    vma::AllocationInfo metricsInfo;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "device/device_wrapper.hpp"
+#include "renderer/image_wrapper.hpp"
+
+// disparity estimate (phases 0 and 1 of the gradient estimator) at a few pixels or small rectangles of a light field.
+// points run a thread each, rectangles a group per tile with a one pixel halo for the sobel edges, so the cost follows the size
+// of the query and not the size of the image. queries and results go through small persistently mapped buffers, results are at the
+// native light field resolution and follow the layout of the estimate: disparity edges, confidence, raw disparity, unused
+class DisparityQuery
+{
+public:
+    typedef std::array<float, 4> Result;
+    // mirrors Job in disparity_query_cs.hlsl (std430)
+    struct Job
+    {
+        int32_t x, y;
+        uint32_t width, height;
+        uint32_t iResult, stride;
+        uint32_t pad[2];
+    };
+    static constexpr uint32_t maxResults = 1 << 18; // e.g. a 512x512 region
+    static constexpr uint32_t tileSize = 16; // matches GROUP_NX and GROUP_NY in disparity_query_cs.hlsl
+
+public:
+    void init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool);
+    void destroy(DeviceWrapper& device, vma::Allocator allocator);
+    // light field in the shader read only layout, no recorded query may still be pending
+    void bind(DeviceWrapper& device, ImageWrapper& lightField);
+    // points first, then every rectangle row by row, texels outside the light field are zero.
+    // false (and nothing recorded) if the results would not fit
+    bool record(vk::CommandBuffer commandBuffer, vma::Allocator allocator, const std::vector<vk::Offset2D>& points, const std::vector<vk::Rect2D>& rects);
+    // valid once the recorded commands have completed
+    std::vector<Result> get_results(vma::Allocator allocator) {
+        allocator.invalidateAllocation(resultsBuffer.second, 0, VK_WHOLE_SIZE);
+        std::vector<Result> results(nResults);
+        memcpy(results.data(), resultsInfo.pMappedData, nResults * sizeof(Result));
+        return results;
+    }
+
+private:
+    // push constants of disparity_query_cs
+    struct Constants
+    {
+        uint32_t iPass; // 0 for points, 1 for rectangle tiles
+        uint32_t iFirstJob;
+        uint32_t nJobs;
+        uint32_t pad;
+    };
+    void create_buffers(vma::Allocator allocator);
+    void create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool);
+    void dispatch_jobs(vk::CommandBuffer commandBuffer, uint32_t iPass, uint32_t iFirstJob, uint32_t nJobs, uint32_t jobsPerGroup);
+
+private:
+    vk::ShaderModule cs;
+    vk::Sampler sampler;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline computePipeline;
+
+    vk::DescriptorSetLayout descSetLayout;
+    vk::DescriptorSet descSet;
+    vk::DescriptorPool descSetPool; // pool the set was allocated from
+
+    uint32_t maxGroupsX = 65535; // of a single dispatch
+    uint32_t nResults = 0; // of the latest recording
+    std::pair<vk::Buffer, vma::Allocation> jobsBuffer; // persistently mapped, written by the host
+    vma::AllocationInfo jobsInfo;
+    std::pair<vk::Buffer, vma::Allocation> resultsBuffer; // persistently mapped, read by the host
+    vma::AllocationInfo resultsInfo;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "renderer/pipelines/disparity_estimator.hpp"
+#include "renderer/pipelines/disparity_compute.hpp"
+
+// structure tensor orientation in the horizontal and vertical epipolar plane images through the centre view (epi_estimator_cs),
+// phase 0 extracts the EPIs into contiguous buffers, phase 1 runs one pass per direction and merges them by coherence
+class EpiEstimator : public DisparityEstimator
+{
+public:
+    EpiEstimator() {
+        parameters = { { "Window radius", 3.0f, 0.0f, 8.0f } };
+    }
+    std::string get_name() override { return "epi"; }
+    void init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+        vk::DescriptorSetLayout sharedLayout, vk::Extent3D extent, uint32_t nOutputs) override;
+    void destroy(DeviceWrapper& device, vma::Allocator allocator) override;
+    void record_phase(vk::CommandBuffer commandBuffer, vk::DescriptorSet sharedSet, PushConstants pcs, uint32_t iPhase, uint32_t iOutput) override {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, { sharedSet, descSets[iOutput] }, {});
+        vk::Extent2D groupCount = DisparityCompute::get_group_count(0, extent);
+        if (iPhase == 0) {
+            commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, 0));
+            commandBuffer.dispatch(groupCount.width, groupCount.height, 1);
+            return;
+        }
+
+        // horizontal tensors go through the phase 0 output, which this estimator does not need otherwise
+        commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, 1));
+        commandBuffer.dispatch(groupCount.width, groupCount.height, 1);
+        vk::MemoryBarrier memoryBarrier = vk::MemoryBarrier().setSrcAccessMask(vk::AccessFlagBits::eShaderWrite).setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+        commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, 2));
+        commandBuffer.dispatch(groupCount.width, groupCount.height, 1);
+    }
+
+private:
+    void create_buffers(vma::Allocator allocator, uint32_t nOutputs);
+    void create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool, uint32_t nOutputs);
+
+private:
+    static constexpr uint32_t nViews = 3; // along u and v, matches CAMERA_N in epi_estimator_cs.hlsl
+    vk::Extent3D extent; // of the phase outputs
+    vk::ShaderModule cs;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline computePipeline;
+
+    vk::DescriptorSetLayout descSetLayout;
+    std::vector<vk::DescriptorSet> descSets;
+    vk::DescriptorPool descSetPool; // pool the sets were allocated from
+
+    // horizontal and vertical EPIs per set of phase outputs
+    std::vector<std::pair<vk::Buffer, vma::Allocation>> horizontalEpis, verticalEpis;
+};
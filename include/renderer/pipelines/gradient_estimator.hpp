@@ -0,0 +1,28 @@
+#pragma once
+
+#include "renderer/pipelines/disparity_estimator.hpp"
+#include "renderer/pipelines/disparity_compute.hpp"
+
+// light field gradients (phase 0) and their least squares disparity with sobel edges (phase 1),
+// implemented by the first phases of disparity_cs, which keeps all phases so that the batch shader can share them
+class GradientEstimator : public DisparityEstimator
+{
+public:
+    std::string get_name() override { return "gradient"; }
+    void init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+        vk::DescriptorSetLayout sharedLayout, vk::Extent3D extent, uint32_t nOutputs) override;
+    void destroy(DeviceWrapper& device, vma::Allocator allocator) override;
+    void record_phase(vk::CommandBuffer commandBuffer, vk::DescriptorSet sharedSet, PushConstants pcs, uint32_t iPhase, uint32_t iOutput) override {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, sharedSet, {});
+        commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, iPhase));
+        vk::Extent2D groupCount = DisparityCompute::get_group_count(iPhase, extent, kernelVariant.groupShape);
+        commandBuffer.dispatch(groupCount.width, groupCount.height, 1);
+    }
+
+private:
+    vk::Extent3D extent; // of the phase outputs
+    vk::ShaderModule cs;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline computePipeline;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+// compiled variant of disparity_cs with its own group shape (see DisparityCompute::get_kernel_variants),
+// the filter passes of a variant run as many threads per line segment as its groups have
+struct KernelVariant
+{
+    std::string name;
+    const unsigned char* pCode;
+    size_t codeSize;
+    vk::Extent2D groupShape; // matches GROUP_NX and GROUP_NY of the variant
+
+    inline uint32_t get_threads() const { return groupShape.width * groupShape.height; }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "renderer/pipelines/disparity_estimator.hpp"
+#include "renderer/pipelines/disparity_compute.hpp"
+
+// gradient estimator that skips textureless regions (sparse_estimator_cs): phase 0 classifies the tiles by the gradient energy
+// of the centre view and compacts them into a textured and a flat list with indirect dispatch arguments, then computes the
+// gradients of the textured tiles. phase 1 computes their disparity and fills the flat tiles with zero confidence
+// and the uncertain marker of the estimate, so the cutoff of DisparityCompute flags them at any threshold and the filter fills them in
+class SparseEstimator : public DisparityEstimator
+{
+public:
+    static constexpr uint32_t argumentsSize = 8; // uints, a VkDispatchIndirectCommand per list followed by the length of the list
+    // groups per row of the indirect dispatches (matches TILE_GRID_X), so the group counts stay below 65535 up to 2^26 tiles
+    static constexpr uint32_t tileGridWidth = 1024;
+
+public:
+    SparseEstimator() {
+        parameters = { { "Texture threshold", 2e-5f, 0.0f, 1e-3f } };
+    }
+    std::string get_name() override { return "sparse"; }
+    void init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+        vk::DescriptorSetLayout sharedLayout, vk::Extent3D extent, uint32_t nOutputs) override;
+    void destroy(DeviceWrapper& device, vma::Allocator allocator) override;
+    void record_phase(vk::CommandBuffer commandBuffer, vk::DescriptorSet sharedSet, PushConstants pcs, uint32_t iPhase, uint32_t iOutput) override;
+
+private:
+    void create_buffers(vma::Allocator allocator, uint32_t nOutputs);
+    void create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool, uint32_t nOutputs);
+
+private:
+    vk::Extent3D extent; // of the phase outputs
+    uint32_t nTiles = 0;
+    vk::ShaderModule cs;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline computePipeline;
+
+    vk::DescriptorSetLayout descSetLayout;
+    std::vector<vk::DescriptorSet> descSets;
+    vk::DescriptorPool descSetPool; // pool the sets were allocated from
+
+    // dispatch arguments and tile lists per set of phase outputs, phase 1 reuses the lists of the last phase 0
+    std::vector<std::pair<vk::Buffer, vma::Allocation>> tileBuffers;
+};
@@ -2,15 +2,25 @@
 
 #include "renderer/swapchain_wrapper.hpp"
 #include "renderer/image_wrapper.hpp"
+#include "renderer/pipelines/disparity_compute.hpp"
 #include "device/device_wrapper.hpp"
 
 class SwapchainWrite
 {
 public:
-	void init(DeviceWrapper& device, SwapchainWrapper& swapchain, vk::DescriptorPool descPool, ImageWrapper& inputImage);
+	// one descriptor set is created for each input image and its stats buffer (colour map range), inputs are scaled to the swapchain extent
+	void init(DeviceWrapper& device, SwapchainWrapper& swapchain, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+		std::vector<ImageWrapper*> inputImages, std::vector<vk::Buffer> statsBuffers);
 	void destroy(DeviceWrapper& device);
+	// after the swapchain was recreated, render pass and pipeline stay valid (same format, dynamic viewport)
+	void recreate_framebuffers(DeviceWrapper& device, SwapchainWrapper& swapchain) {
+		destroy_framebuffers(device);
+		create_framebuffer(device, swapchain);
+		fullscreenRect = vk::Rect2D({ 0, 0 }, swapchain.get_extent());
+	}
 
-	void execute(vk::CommandBuffer commandBuffer, uint32_t iFrame) {
+	// the ui is drawn from a snapshot of a finished imgui frame, so it may be built on another thread meanwhile
+	void execute(vk::CommandBuffer commandBuffer, uint32_t iFrame, uint32_t iInput, ImDrawData* pUi) {
 		vk::RenderPassBeginInfo renderPassBeginInfo = vk::RenderPassBeginInfo()
 			.setRenderPass(renderPass)
 			.setFramebuffer(framebuffers[iFrame])
@@ -18,14 +28,20 @@ public:
 
 		commandBuffer.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
 		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
+		vk::Viewport viewport = vk::Viewport()
+			.setX(0.0f).setY(0.0f)
+			.setMinDepth(0.0f).setMaxDepth(1.0f)
+			.setWidth(static_cast<float>(fullscreenRect.extent.width))
+			.setHeight(static_cast<float>(fullscreenRect.extent.height));
+		commandBuffer.setViewport(0, viewport);
+		commandBuffer.setScissor(0, fullscreenRect);
 
 		// draw fullscreen triangle
-		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descSet, {});
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, descSets[iInput], {});
 		commandBuffer.draw(3, 1, 0, 0);
 
 		// write imgui ui to the output image
-		ImGui::Render();
-		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+		if (pUi && pUi->Valid) ImGui_ImplVulkan_RenderDrawData(pUi, commandBuffer);
 
 		commandBuffer.endRenderPass();
 	}
@@ -33,7 +49,7 @@ public:
 	vk::RenderPass get_render_pass() { return renderPass; }
 private:
 	void create_shader_modules(DeviceWrapper& device);
-	void create_render_pass(DeviceWrapper& device, SwapchainWrapper& swapchain, ImageWrapper& inputImage) {
+	void create_render_pass(DeviceWrapper& device, SwapchainWrapper& swapchain) {
 		std::array<vk::AttachmentDescription, 1> attachments = {
 			// Output
 			vk::AttachmentDescription()
@@ -73,7 +89,7 @@ private:
 
 		renderPass = device.logicalDevice.createRenderPass(renderPassInfo);
 	}
-	void create_framebuffer(DeviceWrapper& device, SwapchainWrapper& swapchain, ImageWrapper& inputImage) {
+	void create_framebuffer(DeviceWrapper& device, SwapchainWrapper& swapchain) {
 		// create one framebuffer for each potential image view output
         uint32_t nSwapchainImages = swapchain.get_image_count();
 		framebuffers.resize(nSwapchainImages);
@@ -88,41 +104,90 @@ private:
 			framebuffers[i] = device.logicalDevice.createFramebuffer(framebufferInfo);
 		}
 	}
+	void destroy_framebuffers(DeviceWrapper& device) {
+		for (size_t i = 0; i < framebuffers.size(); i++) {
+			device.logicalDevice.destroyFramebuffer(framebuffers[i]);
+		}
+		framebuffers.clear();
+	}
 
+	void create_sampler(DeviceWrapper& device, vk::Format inputFormat) {
+		// linear filtering of 32 bit float formats is optional
+		vk::FormatProperties formatProperties = device.physicalDevice.getFormatProperties(inputFormat);
+		bool linear = (bool)(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+		if (!linear) VMI_WARN("Linear filtering not supported for the disparity format, falling back to nearest");
+
+		vk::Filter filter = linear ? vk::Filter::eLinear : vk::Filter::eNearest;
+		vk::SamplerCreateInfo samplerInfo = vk::SamplerCreateInfo()
+			.setMagFilter(filter)
+			.setMinFilter(filter)
+			.setMipmapMode(vk::SamplerMipmapMode::eNearest)
+			.setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+			.setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+			.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+		sampler = device.logicalDevice.createSampler(samplerInfo);
+	}
 	void create_desc_set_layout(DeviceWrapper& device) {
-		vk::DescriptorSetLayoutBinding setLayoutBinding = vk::DescriptorSetLayoutBinding()
-			.setBinding(0)
-			.setDescriptorCount(1)
-			.setDescriptorType(vk::DescriptorType::eSampledImage)
-			.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+		std::array<vk::DescriptorSetLayoutBinding, 3> setLayoutBindings = {
+			vk::DescriptorSetLayoutBinding()
+				.setBinding(0)
+				.setDescriptorCount(1)
+				.setDescriptorType(vk::DescriptorType::eSampledImage)
+				.setStageFlags(vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding()
+				.setBinding(1)
+				.setDescriptorCount(1)
+				.setDescriptorType(vk::DescriptorType::eSampler)
+				.setImmutableSamplers(sampler)
+				.setStageFlags(vk::ShaderStageFlagBits::eFragment),
+			vk::DescriptorSetLayoutBinding()
+				.setBinding(2)
+				.setDescriptorCount(1)
+				.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+				.setStageFlags(vk::ShaderStageFlagBits::eFragment)
+		};
 
 		// create descriptor set layout from the bindings
 		vk::DescriptorSetLayoutCreateInfo createInfo = vk::DescriptorSetLayoutCreateInfo()
-			.setBindings(setLayoutBinding);
+			.setBindings(setLayoutBindings);
 
 		descSetLayout = device.logicalDevice.createDescriptorSetLayout(createInfo);
 	}
-	void create_desc_set(DeviceWrapper& device, vk::DescriptorPool descPool, ImageWrapper& inputImage) {
+	void create_desc_sets(DeviceWrapper& device, vk::DescriptorPool descPool, std::vector<ImageWrapper*>& inputImages, std::vector<vk::Buffer>& statsBuffers) {
 		// allocate the descriptor sets using descriptor pool
+		std::vector<vk::DescriptorSetLayout> layouts(inputImages.size(), descSetLayout);
 		vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
 			.setDescriptorPool(descPool)
-			.setDescriptorSetCount(1).setPSetLayouts(&descSetLayout);
-		descSet = device.logicalDevice.allocateDescriptorSets(allocInfo)[0];
-
-		vk::DescriptorImageInfo descriptor = vk::DescriptorImageInfo()
-			.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-			.setImageView(inputImage.get_image_view())
-			.setSampler(nullptr);
-
-		// input image
-		vk::WriteDescriptorSet descBufferWrites = vk::WriteDescriptorSet()
-			.setDstSet(descSet)
-			.setDstBinding(0)
-			.setDstArrayElement(0)
-			.setDescriptorType(vk::DescriptorType::eSampledImage)
-			.setImageInfo(descriptor);
-
-		device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+			.setSetLayouts(layouts);
+		descSets = device.logicalDevice.allocateDescriptorSets(allocInfo);
+
+		for (size_t i = 0; i < inputImages.size(); i++) {
+			vk::DescriptorImageInfo descriptor = vk::DescriptorImageInfo()
+				.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+				.setImageView(inputImages[i]->get_image_view())
+				.setSampler(nullptr);
+
+			// input image
+			vk::WriteDescriptorSet descBufferWrites = vk::WriteDescriptorSet()
+				.setDstSet(descSets[i])
+				.setDstBinding(0)
+				.setDstArrayElement(0)
+				.setDescriptorType(vk::DescriptorType::eSampledImage)
+				.setImageInfo(descriptor);
+
+			device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+
+			// stats of the input
+			vk::DescriptorBufferInfo bufferInfo = vk::DescriptorBufferInfo(statsBuffers[i], 0, sizeof(DisparityCompute::Stats));
+			descBufferWrites = vk::WriteDescriptorSet()
+				.setDstSet(descSets[i])
+				.setDstBinding(2)
+				.setDstArrayElement(0)
+				.setDescriptorType(vk::DescriptorType::eStorageBuffer)
+				.setBufferInfo(bufferInfo);
+
+			device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+		}
 	}
 
 	void create_pipeline_layout(DeviceWrapper& device) {
@@ -130,7 +195,7 @@ private:
 			.setSetLayouts(descSetLayout);
 		pipelineLayout = device.logicalDevice.createPipelineLayout(pipelineLayoutInfo);
 	}
-	void create_pipeline(DeviceWrapper& device, SwapchainWrapper& swapchain) {
+	void create_pipeline(DeviceWrapper& device, SwapchainWrapper& swapchain, vk::PipelineCache pipelineCache) {
 		// Shaders
 		std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages;
 		{
@@ -160,26 +225,18 @@ private:
 				.setPrimitiveRestartEnable(VK_FALSE);
 		}
 
-		// Viewport
-		vk::Rect2D scissorRect;
-		vk::Viewport viewport;
+		// Viewport (dynamic, so the pipeline survives swapchain recreation)
+		std::array<vk::DynamicState, 2> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+		vk::PipelineDynamicStateCreateInfo dynamicStateInfo;
 		vk::PipelineViewportStateCreateInfo viewportStateInfo;
 		{
-			// Scissor Rect
-			scissorRect = vk::Rect2D()
-				.setOffset({ 0, 0 })
-				.setExtent(swapchain.get_extent());
-			// Viewport
-			viewport = vk::Viewport()
-				.setX(0.0f).setY(0.0f)
-				.setMinDepth(0.0f).setMaxDepth(1.0f)
-				.setWidth(static_cast<float>(swapchain.get_extent().width))
-				.setHeight(static_cast<float>(swapchain.get_extent().height));
+			dynamicStateInfo = vk::PipelineDynamicStateCreateInfo()
+				.setDynamicStates(dynamicStates);
 
 			// Viewport state creation
 			viewportStateInfo = vk::PipelineViewportStateCreateInfo()
-				.setViewportCount(1).setPViewports(&viewport)
-				.setScissorCount(1).setPScissors(&scissorRect);
+				.setViewportCount(1).setPViewports(nullptr)
+				.setScissorCount(1).setPScissors(nullptr);
 		}
 
 		// Rasterization and Multisampling
@@ -261,13 +318,14 @@ private:
 			.setPMultisampleState(&multisamplingInfo)
 			.setPDepthStencilState(&depthStencilInfo)
 			.setPColorBlendState(&colorBlendInfo)
-			.setPDynamicState(nullptr)
+			.setPDynamicState(&dynamicStateInfo)
 			// pipeline layout
 			.setLayout(pipelineLayout)
 			// render pass
 			.setRenderPass(renderPass)
 			.setSubpass(0);
 
+		TRACE_SCOPE("vkCreateGraphicsPipelines");
 		auto result = device.logicalDevice.createGraphicsPipeline(pipelineCache, graphicsPipelineInfo);
 		switch (result.result)
 		{
@@ -288,11 +346,11 @@ private:
 	// subpasses
 	vk::Pipeline graphicsPipeline;
 	vk::PipelineLayout pipelineLayout;
-	vk::PipelineCache pipelineCache; // TODO
 
 	// descriptor
+	vk::Sampler sampler;
 	vk::DescriptorSetLayout descSetLayout;
-	vk::DescriptorSet descSet; // doesnt really need to be stored
+	std::vector<vk::DescriptorSet> descSets;
 
 	// misc
 	vk::Rect2D fullscreenRect;
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "renderer/pipelines/disparity_estimator.hpp"
+#include "renderer/pipelines/disparity_compute.hpp"
+
+// plane sweep over nPlanes disparities with semi-global aggregation (sweep_estimator_cs), for scenes whose baseline is too wide
+// for the gradients. phase 0 sweeps the image top to bottom one row per dispatch, carrying the paths from above in a single row of
+// state per path, and aggregates the left and right paths once per strip of rows, phase 1 adds the disparity edges.
+// instead of the W*H*D cost volume only O(W*D) path state and the matching and summed costs of a strip of rows are allocated,
+// together at most stripBudget bytes (e.g. 32 of 512 rows of the HCI scenes). every matching cost is computed once per pixel and plane
+class SweepEstimator : public DisparityEstimator
+{
+public:
+    static constexpr uint32_t nPlanes = 64; // matches SWEEP_PLANES in sweep_estimator_cs.hlsl
+    static constexpr uint32_t nPaths = 3; // paths carried from row to row, matches SWEEP_PATHS
+    static constexpr vk::DeviceSize stripBudget = 8ull << 20;
+
+public:
+    SweepEstimator() {
+        parameters = {
+            { "Disparity range", 4.0f, 0.5f, 8.0f }, // planes span [-range, range] in native light field pixels
+            { "Penalty P1", 0.03f, 0.0f, 0.5f },
+            { "Penalty P2", 0.15f, 0.0f, 2.0f }
+        };
+    }
+    std::string get_name() override { return "sweep"; }
+    // the vertical and diagonal paths run over the whole height
+    bool is_local() override { return false; }
+    void init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+        vk::DescriptorSetLayout sharedLayout, vk::Extent3D extent, uint32_t nOutputs) override;
+    void destroy(DeviceWrapper& device, vma::Allocator allocator) override;
+    void record_phase(vk::CommandBuffer commandBuffer, vk::DescriptorSet sharedSet, PushConstants pcs, uint32_t iPhase, uint32_t iOutput) override;
+
+private:
+    void create_buffers(vma::Allocator allocator);
+    void create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool);
+
+private:
+    static constexpr uint32_t groupRows = 4; // matches SWEEP_ROWS
+    vk::Extent3D extent; // of the phase outputs
+    uint32_t stripHeight = 1;
+    vk::ShaderModule cs;
+    vk::PipelineLayout pipelineLayout;
+    vk::Pipeline computePipeline;
+
+    vk::DescriptorSetLayout descSetLayout;
+    vk::DescriptorSet descSet;
+    vk::DescriptorPool descSetPool; // pool the set was allocated from
+
+    // scratch shared by all outputs, DisparityCompute::record waits for earlier submissions before any phase is overwritten
+    std::array<std::pair<vk::Buffer, vma::Allocation>, 4> buffers; // path costs, path minima, summed and matching costs of the strip
+};
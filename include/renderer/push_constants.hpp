@@ -10,4 +10,8 @@ struct alignas(4) PushConstants {
 
     uint32_t iPhase = 0;
     uint32_t nSteps = 0;
+    // edge-aware post filter: radius in pixels (0 disables it, at most DisparityCompute::maxFilterRadius)
+    // and how strongly edges of the centre view separate samples
+    uint32_t filterRadius = 8;
+    float filterEdges = 100.0f;
 };
\ No newline at end of file
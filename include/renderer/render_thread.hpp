@@ -0,0 +1,198 @@
+#pragma once
+
+#include "renderer/renderer.hpp"
+#include "utils/spsc_queue.hpp"
+
+// imgui draw lists of a finished ui frame, cloned so that the next frame can be built while this one is rendered.
+// lists are only ever allocated and freed by the ui thread
+class UiSnapshot
+{
+public:
+	~UiSnapshot() { clear(); }
+	void capture(ImDrawData* pDrawData) {
+		clear();
+		if (!pDrawData || !pDrawData->Valid) return;
+		for (int i = 0; i < pDrawData->CmdListsCount; i++) lists.push_back(pDrawData->CmdLists[i]->CloneOutput());
+		displayPos = pDrawData->DisplayPos;
+		displaySize = pDrawData->DisplaySize;
+		framebufferScale = pDrawData->FramebufferScale;
+		nVertices = pDrawData->TotalVtxCount;
+		nIndices = pDrawData->TotalIdxCount;
+	}
+	// draw data referencing the cloned lists, valid as long as this snapshot is not captured again
+	ImDrawData get_draw_data() {
+		ImDrawData drawData;
+		drawData.Valid = !lists.empty();
+		drawData.CmdListsCount = (int)lists.size();
+#if IMGUI_VERSION_NUM >= 18980 // the draw lists became a vector owned by the draw data
+		for (ImDrawList* pList : lists) drawData.CmdLists.push_back(pList);
+#else
+		drawData.CmdLists = lists.data();
+#endif
+		drawData.DisplayPos = displayPos;
+		drawData.DisplaySize = displaySize;
+		drawData.FramebufferScale = framebufferScale;
+		drawData.TotalVtxCount = nVertices;
+		drawData.TotalIdxCount = nIndices;
+		return drawData;
+	}
+
+private:
+	void clear() {
+		for (ImDrawList* pList : lists) IM_DELETE(pList);
+		lists.clear();
+	}
+
+private:
+	std::vector<ImDrawList*> lists;
+	ImVec2 displayPos, displaySize, framebufferScale;
+	int nVertices = 0, nIndices = 0;
+};
+
+// everything a frame is rendered from, sent by the ui thread and returned once a newer one replaced it.
+// all fields describe state rather than events, so the render thread may skip snapshots without losing anything
+struct FrameSnapshot
+{
+	PushConstants pcs;
+	std::string estimator;
+	std::vector<float> estimatorParameters;
+	std::pair<uint32_t, uint32_t> windowSize;
+	UiSnapshot ui;
+
+	// filled in by the render thread when the snapshot is returned
+	std::vector<ProfilerStats::Pass> passes;
+	double renderMs = 0.0; // mean cpu time of the render loop iterations since the previous return
+};
+
+// owns all vulkan submission of the interactive viewer: the ui thread polls events and builds the ui,
+// the render thread always renders the newest snapshot and keeps rendering the previous one when no new one arrived,
+// so neither a slow present stalls input nor does a slow ui frame stall the gpu
+class RenderThread
+{
+public:
+	static constexpr size_t nSnapshots = 4; // in the queue, being rendered and on the way back
+
+public:
+	void start(DeviceWrapper& device, Renderer& renderer, Window& window) {
+		pDevice = &device;
+		pRenderer = &renderer;
+		pWindow = &window;
+		appliedWindowSize = window.get_size();
+		running.store(true, std::memory_order_relaxed);
+		thread = std::thread(&RenderThread::loop, this);
+	}
+	// waits for the render thread to finish its current frame, the device may still be busy afterwards
+	void stop() {
+		if (!thread.joinable()) return;
+		running.store(false, std::memory_order_relaxed);
+		thread.join();
+		std::unique_ptr<FrameSnapshot> pSnapshot;
+		while (submitted.try_pop(pSnapshot)) pSnapshot.reset();
+		while (returned.try_pop(pSnapshot)) pSnapshot.reset();
+		spare.clear();
+		nAllocated = 0;
+	}
+
+	// ui thread: a snapshot to fill (reusing returned ones), null if all of them are still in flight
+	std::unique_ptr<FrameSnapshot> acquire() {
+		std::unique_ptr<FrameSnapshot> pSnapshot;
+		while (returned.try_pop(pSnapshot)) {
+			latestPasses = std::move(pSnapshot->passes);
+			latestRenderMs = pSnapshot->renderMs;
+			spare.push_back(std::move(pSnapshot));
+		}
+		if (!spare.empty()) {
+			pSnapshot = std::move(spare.back());
+			spare.pop_back();
+			return pSnapshot;
+		}
+		if (nAllocated == nSnapshots) return nullptr;
+		nAllocated++;
+		return std::make_unique<FrameSnapshot>();
+	}
+	// ui thread: the queue always has room for every acquired snapshot
+	void submit(std::unique_ptr<FrameSnapshot> pSnapshot) {
+		if (!submitted.try_push(std::move(pSnapshot))) assert(false);
+	}
+	// ui thread: returns once a frame was presented since the given count, or input arrived, or the timeout passed
+	void wait_for_frame(uint64_t nFrames, uint32_t timeoutMs) {
+		TRACE_SCOPE("RenderThread::wait_for_frame");
+		auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		while (nPresented.load(std::memory_order_acquire) == nFrames && std::chrono::steady_clock::now() < end) {
+			if (SDL_WaitEventTimeout(nullptr, 1)) return;
+		}
+	}
+	inline uint64_t get_frame_count() { return nPresented.load(std::memory_order_acquire); }
+	// as of the latest returned snapshot (ui thread)
+	inline const std::vector<ProfilerStats::Pass>& get_passes() { return latestPasses; }
+	inline double get_render_ms() { return latestRenderMs; }
+
+private:
+	void loop() {
+		std::unique_ptr<FrameSnapshot> pCurrent;
+		uint32_t nIterations = 0;
+		double msSum = 0.0;
+		while (running.load(std::memory_order_relaxed)) {
+			auto start = std::chrono::steady_clock::now();
+			// the newest snapshot wins, older ones go straight back (the return queue holds all of them)
+			std::unique_ptr<FrameSnapshot> pNext;
+			while (submitted.try_pop(pNext)) {
+				if (pCurrent) give_back(std::move(pCurrent), msSum, nIterations);
+				pCurrent = std::move(pNext);
+			}
+			if (!pCurrent) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			TRACE_SCOPE("RenderThread::frame");
+			apply(*pCurrent);
+			ImDrawData drawData = pCurrent->ui.get_draw_data();
+			if (pRenderer->render(*pDevice, pCurrent->pcs, &drawData)) nPresented.fetch_add(1, std::memory_order_release);
+			else std::this_thread::sleep_for(std::chrono::milliseconds(1)); // minimized
+
+			msSum += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			nIterations++;
+		}
+		if (pCurrent) give_back(std::move(pCurrent), msSum, nIterations);
+		pDevice->logicalDevice.waitIdle();
+	}
+	// state changes of a snapshot that need the device, skipped when nothing changed
+	void apply(FrameSnapshot& snapshot) {
+		if (snapshot.windowSize != appliedWindowSize) {
+			pWindow->resize(snapshot.windowSize.first, snapshot.windowSize.second);
+			pRenderer->resize();
+			appliedWindowSize = snapshot.windowSize;
+		}
+		if (snapshot.estimator != pRenderer->get_estimator().get_name()) pRenderer->set_estimator(*pDevice, snapshot.estimator);
+		std::vector<DisparityEstimator::Parameter>& parameters = pRenderer->get_estimator().get_parameters();
+		if (snapshot.estimatorParameters.size() != parameters.size()) return;
+		for (size_t i = 0; i < parameters.size(); i++) parameters[i].value = snapshot.estimatorParameters[i];
+	}
+	void give_back(std::unique_ptr<FrameSnapshot> pSnapshot, double& msSum, uint32_t& nIterations) {
+		pSnapshot->passes = pRenderer->get_profiler_stats().get_passes();
+		pSnapshot->renderMs = nIterations > 0 ? msSum / nIterations : 0.0;
+		msSum = 0.0;
+		nIterations = 0;
+		if (!returned.try_push(std::move(pSnapshot))) assert(false);
+	}
+
+private:
+	DeviceWrapper* pDevice = nullptr;
+	Renderer* pRenderer = nullptr;
+	Window* pWindow = nullptr;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	std::atomic<uint64_t> nPresented{ 0 };
+	SpscQueue<std::unique_ptr<FrameSnapshot>, nSnapshots> submitted; // ui to render thread
+	SpscQueue<std::unique_ptr<FrameSnapshot>, nSnapshots> returned; // render to ui thread
+
+	// render thread only
+	std::pair<uint32_t, uint32_t> appliedWindowSize;
+
+	// ui thread only
+	std::vector<std::unique_ptr<FrameSnapshot>> spare;
+	size_t nAllocated = 0;
+	std::vector<ProfilerStats::Pass> latestPasses;
+	double latestRenderMs = 0.0;
+};
@@ -3,58 +3,681 @@
 #include "vk_mem_alloc.hpp"
 #include "swapchain_wrapper.hpp"
 #include "image_wrapper.hpp"
+#include "compute_frame.hpp"
+#include "memory_pools.hpp"
+#include "pipeline_cache.hpp"
+#include "kernel_tuning.hpp"
+#include "light_field_stream.hpp"
+#include "disparity_publisher.hpp"
 #include "pipelines/swapchain_write.hpp"
 #include "pipelines/disparity_compute.hpp"
+#include "pipelines/disparity_batch.hpp"
+#include "pipelines/disparity_metrics.hpp"
+#include "pipelines/disparity_query.hpp"
 #include "imgui_wrapper.hpp"
+#include "gpu_profiler.hpp"
+#include "utils/pfm.hpp"
+#include "utils/arguments.hpp"
 
 
 class Renderer 
 {
 public:
-    void init(DeviceWrapper& device, Window& window) {
-		VMI_LOG("[Initializing] Renderer...");
+	// startup is split into stages, so that independent ones can run concurrently (see Application::create_startup_jobs):
+	// setup first, decode_light_field at any time, create_frames after setup, then upload_light_field (after decode),
+	// create_compute_pipelines and create_display in any order, followed by create_metrics (headless) and create_ui (viewer).
+	// stages that run concurrently never share a pool or queue, except the ui and the upload when transfer and graphics queue are one
+	void init_setup(DeviceWrapper& device, Window& window, Arguments& args) {
+		TRACE_SCOPE("Renderer::init_setup");
+		VMI_LOG("[Initializing] Renderer" << (args.headless ? " (headless)" : "") << "...");
+		pWindow = &window;
+		headless = args.headless;
 		create_vma_allocator(device, window);
 		create_command_pools(device);
 		create_descriptor_pools(device);
+		pipelineCache.init(device, args.pipelineCacheFile);
+		computeFrames.resize(args.nFramesInFlight);
+		estimatorName = args.estimator;
+		kernelVariant = KernelTuning::load(device, args.tuningFile);
+		// the shared memory ring is sized by the first computed frame
+		if (headless) publishName = args.publishName;
+		nPublishSlots = args.nPublishSlots;
 
-		swapchain.init(device, window);
-		create_pipelines(device);
-		imgui.init(device, swapchain, window, swapchainWrite);
+		// offscreen compute only, without swapchain, swapchain write or imgui
+		if (!headless) swapchain.init(device, window, args.nFramesInFlight);
+		create_profilers(device, args);
 	}
+	// host only, may run before the device exists
+	void decode_light_field() {
+		TRACE_SCOPE("Renderer::decode_light_field");
+		const std::string& folder = sceneFolder;
+		lightFieldData = ImageWrapper::read_files(folder.c_str(), "input_Cam", lightFieldIndices, lightFieldExtent);
+		lightFieldHash = Hash::combine(Hash::combine(Hash::seed, folder.data(), folder.size()), lightFieldIndices.data(), lightFieldIndices.size() * sizeof(int));
+	}
+	// light field image (without contents) and the phase outputs of every frame in flight,
+	// disparity is computed at a fraction of the native light field resolution (of the scene files unless given)
+	void create_frames(DeviceWrapper& device, float resolutionScale, vk::Extent2D lightFieldExtent = {}) {
+		TRACE_SCOPE("Renderer::create_frames");
+		if (lightFieldExtent.width == 0) lightFieldExtent = ImageWrapper::get_file_extent(sceneFolder.c_str(), "input_Cam", lightFieldIndices);
+		vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+		lightFieldImage.init(device, allocator, vk::Extent3D(lightFieldExtent, (uint32_t)lightFieldIndices.size()), usage);
+
+		vk::Extent2D extent = vk::Extent2D()
+			.setWidth(std::max(1u, (uint32_t)std::lround(lightFieldExtent.width * resolutionScale)))
+			.setHeight(std::max(1u, (uint32_t)std::lround(lightFieldExtent.height * resolutionScale)));
+		VMI_LOG("    Disparity resolution: " << extent.width << "x" << extent.height);
+
+		std::vector<ComputeFrame*> frames;
+		for (ComputeFrame& frame : computeFrames) {
+			frame.init(device, allocator, extent);
+			frames.push_back(&frame);
+		}
+		ComputeFrame::place_images(device, frames, memoryPools);
+		memoryPools.allocate(device, allocator);
+	}
+	// decoded light field (and the ground truth when headless) on the transfer queue
+	void upload_light_field(DeviceWrapper& device) {
+		TRACE_SCOPE("Renderer::upload_light_field");
+		if (lightFieldData.empty()) VMI_ERR("Light field was not decoded: " << sceneFolder);
+		else {
+			GpuProfiler* pProfiler = uploadProfiler.is_enabled() ? &uploadProfiler : nullptr;
+			if (pProfiler) pProfiler->reset_host(device, 0, iFrame);
+			lightFieldImage.load_rows(device, allocator, transferCommandPool, lightFieldData.data(), lightFieldExtent.height, 0, pProfiler);
+			if (pProfiler) pProfiler->collect(device, 0, profilerStats);
+		}
+		lightFieldData = {};
+		lightFieldImage.transition_layout(device, transferCommandPool, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+		// benchmark scenes ship their ground truth at the light field resolution
+		std::string groundTruthFile = (std::filesystem::path(sceneFolder) / "gt_disp_lowres.pfm").string();
+		groundTruth = headless && std::filesystem::exists(groundTruthFile) && load_ground_truth(device, groundTruthFile);
+	}
+	void create_compute_pipelines(DeviceWrapper& device) {
+		TRACE_SCOPE("Renderer::create_compute_pipelines");
+		std::vector<DisparityCompute::PhaseOutputs> phaseOutputs;
+		std::vector<vk::Buffer> statsBuffers;
+		for (ComputeFrame& frame : computeFrames) {
+			phaseOutputs.push_back(frame.get_phase_outputs());
+			statsBuffers.push_back(frame.statsBuffer);
+		}
+		disparityCompute.init(device, allocator, pipelineCache.get(), descPool, lightFieldImage, phaseOutputs, statsBuffers, estimatorName, kernelVariant);
+		sceneLoaded = true;
+	}
+	// after the upload (ground truth) and the compute pipelines (descriptor pool)
+	void create_metrics(DeviceWrapper& device) {
+		if (groundTruth) disparityMetrics.init(device, allocator, pipelineCache.get(), descPool, get_disparity_images(), groundTruthImage);
+	}
+	void create_display(DeviceWrapper& device) {
+		TRACE_SCOPE("Renderer::create_display");
+		std::vector<vk::Buffer> statsBuffers;
+		for (ComputeFrame& frame : computeFrames) statsBuffers.push_back(frame.statsBuffer);
+		swapchainWrite.init(device, swapchain, pipelineCache.get(), displayDescPool, get_disparity_images(), statsBuffers);
+	}
+	void create_ui(DeviceWrapper& device, Window& window) {
+		imgui.init(device, swapchain, window, swapchainWrite, pipelineCache.get());
+	}
+	inline const std::vector<int>& get_light_field_indices() { return lightFieldIndices; }
 	void destroy(DeviceWrapper& device)
 	{
-		destroy_pipelines(device);
-		swapchain.destroy(device);
+		publisher.destroy(device);
+		destroy_query(device);
+		if (batchReady) {
+			disparityBatch.destroy(device);
+			device.logicalDevice.destroyFence(batchFence);
+			device.logicalDevice.destroyCommandPool(batchCommandPool);
+		}
+		if (sceneLoaded) destroy_pipelines(device);
+		destroy_profilers(device);
+		if (!headless) swapchain.destroy(device);
+		if (!headless) imgui.destroy(device);
+		pipelineCache.destroy(device);
 
 		device.logicalDevice.destroyCommandPool(transientCommandPool);
 		device.logicalDevice.destroyCommandPool(transferCommandPool);
 		device.logicalDevice.destroyDescriptorPool(descPool);
+		device.logicalDevice.destroyDescriptorPool(displayDescPool);
 
-		imgui.destroy(device);
 		allocator.destroy();
 	}
 
 public:
-	void render(DeviceWrapper& device, PushConstants pcs) {
-		uint32_t iSwapchainImage = swapchain.acquire_next_image(device.logicalDevice);
+	// draws the ui on top when given, returns false if no frame was presented
+	bool render(DeviceWrapper& device, PushConstants pcs, ImDrawData* pUi = nullptr) {
+		TRACE_SCOPE("Renderer::render");
+		// skip frames while the window is minimized or the swapchain could not be recreated yet
+		if ((resized || swapchain.is_outdated()) && !recreate_swapchain(device)) return false;
+		uint32_t iSwapchainImage;
+		if (!swapchain.acquire_next_image(device.logicalDevice, iSwapchainImage)) {
+			recreate_swapchain(device);
+			return false;
+		}
+
+		// disparity runs on the (async) compute queue while the previous frame is still being displayed,
+		// only the phases whose inputs changed since this frame's outputs were computed are executed
+		iFrame++;
+		iComputeFrame = (iComputeFrame + 1) % computeFrames.size();
+		ComputeFrame& frame = computeFrames[iComputeFrame];
+		auto phaseHashes = DisparityCompute::get_phase_hashes(get_input_hash(), pcs);
+		uint32_t iFirstPhase = frame.get_first_stale_phase(phaseHashes);
+		bool computed = iFirstPhase < DisparityCompute::nPhases;
+		if (computed) {
+			submit_compute(device, frame, pcs, iFirstPhase, phaseHashes.back());
+			frame.phaseHashes = phaseHashes;
+		}
+
+		TRACE_SCOPE("record_display");
 		vk::CommandBuffer commandBuffer = swapchain.record_commands(device, iSwapchainImage);
+		uint32_t iSyncFrame = swapchain.get_sync_frame_index();
+		graphicsProfiler.collect(device, iSyncFrame, profilerStats);
+		graphicsProfiler.reset(commandBuffer, iSyncFrame, iFrame);
+		if (computed && device.iComputeQueue != device.iGraphicsQueue) {
+			// acquire disparity image from the compute queue family (matches release in record_disparity)
+			frame.disparityImage.barrier(commandBuffer, vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::PipelineStageFlagBits::eFragmentShader, {},
+				vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead,
+				device.iComputeQueue, device.iGraphicsQueue);
+		}
+		graphicsProfiler.begin(commandBuffer, iSyncFrame, 0);
+		swapchainWrite.execute(commandBuffer, iSwapchainImage, iComputeFrame, pUi);
+		graphicsProfiler.end(commandBuffer, iSyncFrame, 0);
 
-		disparityImage.transition_layout(commandBuffer, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eGeneral);
-		pcs.iPhase = 0;
-		disparityCompute.execute(commandBuffer, pcs);
-		
-		vk::MemoryBarrier memoryBarrier = vk::MemoryBarrier().setSrcAccessMask(vk::AccessFlagBits::eShaderWrite).setDstAccessMask(vk::AccessFlagBits::eShaderRead);
-		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+		// display waits on the compute results and signals when the disparity image may be overwritten again,
+		// a cached image still has to consume the pending signal so that it is never signaled twice
+		if (computed) {
+			swapchain.present(device, iSwapchainImage, frame.computeFinished, vk::PipelineStageFlagBits::eFragmentShader, frame.displayFinished);
+		}
+		else if (frame.displayPending) {
+			swapchain.present(device, iSwapchainImage, frame.displayFinished, vk::PipelineStageFlagBits::eFragmentShader, frame.displayFinished);
+		}
+		else {
+			swapchain.present(device, iSwapchainImage, nullptr, {}, frame.displayFinished);
+		}
+		frame.displayPending = true;
+		return true;
+	}
+	// headless counterpart to render(), always runs all disparity phases on the compute queue
+	void compute(DeviceWrapper& device, PushConstants pcs) {
+		iFrame++;
+		iComputeFrame = (iComputeFrame + 1) % computeFrames.size();
+		ComputeFrame& frame = computeFrames[iComputeFrame];
+		frame.phaseHashes = DisparityCompute::get_phase_hashes(get_input_hash(), pcs);
+		submit_compute(device, frame, pcs, 0, frame.phaseHashes.back());
+	}
+	// swapchain is recreated before the next frame
+	inline void resize() { resized = true; }
+	inline DisparityEstimator& get_estimator() { return disparityCompute.get_estimator(); }
+	// swaps the estimator of phases 0 and 1, all outputs are recomputed with it
+	void set_estimator(DeviceWrapper& device, const std::string& name) {
+		if (name == get_estimator().get_name()) return;
+		device.logicalDevice.waitIdle();
+		disparityCompute.set_estimator(device, allocator, pipelineCache.get(), name);
+		estimatorName = get_estimator().get_name();
+		// recorded buffers reference the pipelines of the previous estimator, even where the hashes would match again
+		for (ComputeFrame& frame : computeFrames) {
+			frame.recorded = {};
+			frame.phaseHashes = {};
+		}
+	}
+	// recreates the phase pipelines with another compiled variant of disparity_cs (see DisparityCompute::get_kernel_variants)
+	void set_kernel_variant(DeviceWrapper& device, const std::string& name) {
+		device.logicalDevice.waitIdle();
+		disparityCompute.set_kernel_variant(device, allocator, pipelineCache.get(), name);
+		kernelVariant = disparityCompute.get_kernel_variant().name;
+		for (ComputeFrame& frame : computeFrames) {
+			frame.recorded = {};
+			frame.phaseHashes = {};
+		}
+	}
+	// times every kernel variant the device supports on the current scene (sum of the fastest gpu time of each phase)
+	// and stores the fastest one whose disparity matches the default variant for this device and driver (headless only)
+	void autotune(DeviceWrapper& device, PushConstants pcs, uint32_t nFrames, const std::string& filename) {
+		TRACE_SCOPE("Renderer::autotune");
+		VMI_LOG("Tuning kernel variants on " << device.deviceProperties.deviceName.data() << " (" << nFrames << " frames each)");
+		std::vector<float> reference;
+		std::string bestVariant;
+		double bestMs = 0.0;
+		for (const KernelVariant& variant : DisparityCompute::get_kernel_variants()) {
+			if (!DisparityCompute::is_supported(device, variant)) {
+				VMI_LOG("    " << variant.name << ": exceeds the device limits");
+				continue;
+			}
+			set_kernel_variant(device, variant.name);
 
-		pcs.iPhase = 1;
-		disparityCompute.execute(commandBuffer, pcs);
-		disparityImage.transition_layout(commandBuffer, vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal);
-		swapchainWrite.execute(commandBuffer, iSwapchainImage);
+			// one frame to warm up, then only the timings of this variant count
+			compute(device, pcs);
+			device.logicalDevice.waitIdle();
+			collect_profiler(device);
+			profilerStats.clear();
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < nFrames; i++) compute(device, pcs);
+			device.logicalDevice.waitIdle();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / nFrames;
+			collect_profiler(device);
+			double gpuMs = 0.0;
+			for (const ProfilerStats::Pass& pass : profilerStats.get_passes()) {
+				if (pass.name.rfind("phase_", 0) == 0) gpuMs += pass.min();
+			}
+			if (gpuMs > 0.0) ms = gpuMs; // host time only without timestamps
 
-		swapchain.present(device, iSwapchainImage);
+			// the variants only regroup the same per pixel work, apart from the rounding of the filter's prefix sums
+			ComputeFrame& frame = computeFrames[iComputeFrame];
+			std::vector<float> data = frame.disparityImage.read_back(device, allocator, frame.commandPool, device.computeQueue, vk::ImageLayout::eShaderReadOnlyOptimal);
+			if (reference.empty()) reference = data;
+			size_t nMismatches = 0;
+			for (size_t i = 0; i < data.size() && i < reference.size(); i++) {
+				if (std::isnan(data[i]) && std::isnan(reference[i])) continue;
+				if (!(std::abs(data[i] - reference[i]) <= 1e-3f * std::max(1.0f, std::abs(reference[i])))) nMismatches++;
+			}
+			bool correct = data.size() == reference.size() && nMismatches <= data.size() / 1000;
+			VMI_LOG("    " << variant.name << ": " << ms << " ms/frame" << (correct ? "" : " (disparity differs, skipped)"));
+			if (correct && (bestVariant.empty() || ms < bestMs)) {
+				bestVariant = variant.name;
+				bestMs = ms;
+			}
+		}
+
+		if (bestVariant.empty()) {
+			VMI_WARN("No kernel variant could be tuned, keeping " << disparityCompute.get_kernel_variant().name);
+			return;
+		}
+		VMI_LOG("Fastest kernel variant: " << bestVariant << " (" << bestMs << " ms/frame)");
+		set_kernel_variant(device, bestVariant);
+		if (!filename.empty()) KernelTuning::store(device, filename, bestVariant, bestMs);
+	}
+	inline vk::Extent3D get_disparity_extent() { return computeFrames[0].disparityImage.get_extent(); }
+	inline ProfilerStats& get_profiler_stats() { return profilerStats; }
+	void log_memory_usage(DeviceWrapper& device) { memoryPools.log_usage(device, allocator); }
+	inline std::vector<vma::Budget> get_memory_budgets(DeviceWrapper& device) { return MemoryPools::get_heap_budgets(device, allocator); }
+	inline vk::DeviceSize get_pool_size() { return memoryPools.get_block_size(); }
+	// bindless path for many (small) scenes: as many scenes as the device can bind are processed by a single dispatch per phase,
+	// exports the raw disparity of each scene as <outputFolder>/<scene>.pfm if a folder is given
+	void process_batch(DeviceWrapper& device, const std::vector<std::string>& scenes, PushConstants pcs, const std::string& outputFolder) {
+		TRACE_SCOPE("Renderer::process_batch");
+		if (!init_batch(device)) return;
+		std::vector<BatchScene> inputs;
+		for (const std::string& scene : scenes) inputs.push_back({ scene, nullptr, {} });
+
+		BatchCallback onResult;
+		if (!outputFolder.empty()) {
+			onResult = [&](size_t i, const std::vector<float>& data, vk::Extent3D extent) {
+				std::filesystem::path scenePath = std::filesystem::path(scenes[i]).lexically_normal();
+				std::string sceneName = scenePath.has_filename() ? scenePath.filename().string() : scenePath.parent_path().filename().string();
+				PfmFile::write((std::filesystem::path(outputFolder) / (sceneName + ".pfm")).string(), extent.width, extent.height, data.data() + 3, 4);
+			};
+		}
+		BatchStats stats = compute_batch(device, inputs, pcs, onResult);
+		VMI_LOG("Processed " << scenes.size() << " scenes in " << stats.nBatches << " batches of up to " << stats.nMaxScenes
+			<< " (" << stats.computeMs << " ms, " << stats.computeMs / std::max<size_t>(1, scenes.size()) << " ms/scene)");
+	}
+	// light field of one scene in a batch, decoded from its folder during the batch unless the caller already holds the views
+	struct BatchScene
+	{
+		std::string folder;
+		const uint8_t* pData; // rgba8 views one after another, null to decode the folder
+		vk::Extent2D extent; // of pData
+	};
+	struct BatchStats
+	{
+		uint32_t nBatches = 0;
+		uint32_t nMaxScenes = 0;
+		double computeMs = 0.0;
+	};
+	// receives the raw disparity texels of a scene (its index in the inputs) right after its batch completed
+	typedef std::function<void(size_t, const std::vector<float>&, vk::Extent3D)> BatchCallback;
+
+	// the batch pipeline stays alive for later batches (daemon), false if the device can't bind whole batches
+	bool init_batch(DeviceWrapper& device) {
+		if (batchReady) return true;
+		if (!device.descriptorIndexing) {
+			VMI_ERR("Batch processing requires VK_EXT_descriptor_indexing (runtime arrays, partially bound)");
+			return false;
+		}
+		disparityBatch.init(device, pipelineCache.get(), DisparityBatch::get_max_scenes(device));
+		batchCommandPool = device.logicalDevice.createCommandPool(vk::CommandPoolCreateInfo().setQueueFamilyIndex(device.iComputeQueue));
+		vk::CommandBufferAllocateInfo commandBufferInfo = vk::CommandBufferAllocateInfo()
+			.setCommandPool(batchCommandPool)
+			.setLevel(vk::CommandBufferLevel::ePrimary)
+			.setCommandBufferCount(1);
+		batchCommandBuffer = device.logicalDevice.allocateCommandBuffers(commandBufferInfo)[0];
+		batchFence = device.logicalDevice.createFence({});
+		batchReady = true;
+		return true;
+	}
+	// all scenes share the push constants, onResult may be empty if nothing has to be read back
+	BatchStats compute_batch(DeviceWrapper& device, const std::vector<BatchScene>& scenes, PushConstants pcs, const BatchCallback& onResult) {
+		TRACE_SCOPE("Renderer::compute_batch");
+		BatchStats stats;
+		if (!init_batch(device)) return stats;
+		stats.nMaxScenes = std::min((uint32_t)scenes.size(), DisparityBatch::get_max_scenes(device));
+
+		vk::CommandBuffer commandBuffer = batchCommandBuffer;
+		for (size_t iBegin = 0; iBegin < scenes.size(); iBegin += stats.nMaxScenes) {
+			size_t nScenes = std::min(scenes.size() - iBegin, (size_t)stats.nMaxScenes);
+
+			// inputs and outputs of every scene in this batch (reserved, the descriptors point into these)
+			std::vector<ImageWrapper> lightFields, outputs;
+			lightFields.reserve(nScenes);
+			outputs.reserve(nScenes * DisparityCompute::nPhases);
+			std::vector<ImageWrapper*> inputImages;
+			std::vector<DisparityCompute::PhaseOutputs> outputImages;
+			MemoryPools batchPools; // all outputs run in the same dispatches, so none of them can alias
+			for (size_t i = iBegin; i < iBegin + nScenes; i++) {
+				const BatchScene& scene = scenes[i];
+				vk::Extent2D extent = scene.pData ? scene.extent : ImageWrapper::get_file_extent(scene.folder.c_str(), "input_Cam", lightFieldIndices);
+				lightFields.emplace_back(vk::Format::eR8G8B8A8Unorm);
+				lightFields.back().init(device, allocator, vk::Extent3D(extent, (uint32_t)lightFieldIndices.size()), vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+				if (scene.pData) lightFields.back().load_rows(device, allocator, transferCommandPool, scene.pData, extent.height, 0);
+				else lightFields.back().load3D(device, allocator, transferCommandPool, scene.folder.c_str(), "input_Cam", lightFieldIndices);
+				lightFields.back().transition_layout(device, transferCommandPool, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+				inputImages.push_back(&lightFields.back());
+
+				DisparityCompute::PhaseOutputs phaseOutputs;
+				for (uint32_t iPhase = 0; iPhase < DisparityCompute::nPhases; iPhase++) {
+					vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eStorage;
+					if (iPhase == DisparityCompute::nPhases - 1) usage |= vk::ImageUsageFlagBits::eTransferSrc;
+					outputs.emplace_back(vk::Format::eR32G32B32A32Sfloat);
+					outputs.back().init_unbound(device, vk::Extent3D(extent, 1), usage);
+					batchPools.add(device, outputs.back(), "scene " + std::to_string(i) + " phase_" + std::to_string(iPhase) + " output");
+					phaseOutputs[iPhase] = &outputs.back();
+				}
+				outputImages.push_back(phaseOutputs);
+			}
+			batchPools.allocate(device, allocator);
+			disparityBatch.bind(device, inputImages, outputImages);
+
+			// one dispatch per phase for the whole batch
+			auto start = std::chrono::steady_clock::now();
+			device.logicalDevice.resetCommandPool(batchCommandPool);
+			commandBuffer.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+			computeProfiler.reset(commandBuffer, 0, ++iFrame);
+			for (ImageWrapper& output : outputs) {
+				output.barrier(commandBuffer, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+					vk::PipelineStageFlagBits::eComputeShader, {},
+					vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite);
+			}
+			vk::MemoryBarrier memoryBarrier = vk::MemoryBarrier().setSrcAccessMask(vk::AccessFlagBits::eShaderWrite).setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+			for (uint32_t iPhase = 0; iPhase < DisparityCompute::nPhases; iPhase++) {
+				if (iPhase > 0) {
+					commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+				}
+				pcs.iPhase = iPhase;
+				computeProfiler.begin(commandBuffer, 0, iPhase);
+				disparityBatch.execute(commandBuffer, pcs);
+				computeProfiler.end(commandBuffer, 0, iPhase);
+			}
+			commandBuffer.end();
+
+			device.computeQueue.submit(vk::SubmitInfo().setCommandBuffers(commandBuffer), batchFence);
+			vk::Result result = device.logicalDevice.waitForFences(batchFence, VK_TRUE, UINT64_MAX);
+			if (result != vk::Result::eSuccess) assert(false);
+			device.logicalDevice.resetFences(batchFence);
+			stats.computeMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			computeProfiler.collect(device, 0, profilerStats);
+			stats.nBatches++;
+
+			// hand out the results and clean up
+			for (size_t i = 0; i < nScenes; i++) {
+				ImageWrapper& disparityImage = *outputImages[i][DisparityCompute::nPhases - 1];
+				if (onResult) {
+					std::vector<float> data = disparityImage.read_back(device, allocator, batchCommandPool, device.computeQueue, vk::ImageLayout::eGeneral);
+					onResult(iBegin + i, data, disparityImage.get_extent());
+				}
+				lightFields[i].destroy(device, allocator);
+			}
+			for (ImageWrapper& output : outputs) output.destroy(device, allocator);
+			batchPools.destroy(allocator);
+		}
+		return stats;
+	}
+	// disparity estimate at a few points and rectangles of the given light field (of the loaded scene without one), only the groups
+	// covering them run. blocks until the results are back (see DisparityQuery::record for their order), empty if the query did not fit
+	std::vector<DisparityQuery::Result> query_disparity(DeviceWrapper& device, const std::vector<vk::Offset2D>& points, const std::vector<vk::Rect2D>& rects,
+		const BatchScene* pScene = nullptr, double* pComputeMs = nullptr) {
+		TRACE_SCOPE("Renderer::query_disparity");
+		if (!pScene && !sceneLoaded) {
+			VMI_ERR("Disparity query without a light field");
+			return {};
+		}
+		if (!queryReady) {
+			disparityQuery.init(device, allocator, pipelineCache.get(), descPool);
+			queryCommandPool = device.logicalDevice.createCommandPool(vk::CommandPoolCreateInfo().setQueueFamilyIndex(device.iComputeQueue));
+			vk::CommandBufferAllocateInfo commandBufferInfo = vk::CommandBufferAllocateInfo()
+				.setCommandPool(queryCommandPool)
+				.setLevel(vk::CommandBufferLevel::ePrimary)
+				.setCommandBufferCount(1);
+			queryCommandBuffer = device.logicalDevice.allocateCommandBuffers(commandBufferInfo)[0];
+			queryFence = device.logicalDevice.createFence({});
+			queryReady = true;
+		}
+
+		// light fields of their own are uploaded for the query only
+		ImageWrapper lightField = { vk::Format::eR8G8B8A8Unorm };
+		if (pScene) {
+			vk::Extent2D extent = pScene->pData ? pScene->extent : ImageWrapper::get_file_extent(pScene->folder.c_str(), "input_Cam", lightFieldIndices);
+			lightField.init(device, allocator, vk::Extent3D(extent, (uint32_t)lightFieldIndices.size()), vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+			if (pScene->pData) lightField.load_rows(device, allocator, transferCommandPool, pScene->pData, extent.height, 0);
+			else lightField.load3D(device, allocator, transferCommandPool, pScene->folder.c_str(), "input_Cam", lightFieldIndices);
+			lightField.transition_layout(device, transferCommandPool, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+		}
+		disparityQuery.bind(device, pScene ? lightField : lightFieldImage);
+
+		auto start = std::chrono::steady_clock::now();
+		device.logicalDevice.resetCommandPool(queryCommandPool);
+		queryCommandBuffer.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		bool recorded = disparityQuery.record(queryCommandBuffer, allocator, points, rects);
+		queryCommandBuffer.end();
+		std::vector<DisparityQuery::Result> results;
+		if (recorded) {
+			device.computeQueue.submit(vk::SubmitInfo().setCommandBuffers(queryCommandBuffer), queryFence);
+			vk::Result result = device.logicalDevice.waitForFences(queryFence, VK_TRUE, UINT64_MAX);
+			if (result != vk::Result::eSuccess) assert(false);
+			device.logicalDevice.resetFences(queryFence);
+			results = disparityQuery.get_results(allocator);
+		}
+		if (pComputeMs) *pComputeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (pScene) lightField.destroy(device, allocator);
+		return results;
+	}
+	// disparity of every frame of a stream as it arrives, each one uploaded from its staging slot on the compute queue right before
+	// its phases, the slot returns to the stream once that frame completed (headless only, pipelines are recreated at the stream's size).
+	// exports the raw disparity of every frame as <outputFolder>/frame_<n>.pfm if a folder is given
+	void process_stream(DeviceWrapper& device, std::unique_ptr<LightFieldSource> pSource, PushConstants pcs,
+		uint32_t nSlots, LightFieldStream::Policy policy, uint32_t nDecoders, const std::string& outputFolder) {
+		TRACE_SCOPE("Renderer::process_stream");
+		vk::Extent3D extent = pSource->get_extent();
+		if (extent.depth != lightFieldIndices.size()) {
+			VMI_ERR("Streamed light fields need " << lightFieldIndices.size() << " views, got " << extent.depth);
+			return;
+		}
+		if (!sceneLoaded || lightFieldImage.get_extent() != extent) {
+			if (sceneLoaded) {
+				destroy_pipelines(device);
+				device.logicalDevice.resetDescriptorPool(descPool);
+			}
+			// contents come with every frame
+			create_frames(device, 1.0f, vk::Extent2D(extent.width, extent.height));
+			lightFieldImage.transition_layout(device, transferCommandPool, vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal);
+			create_compute_pipelines(device);
+		}
+		// every frame in flight holds its slot until the frame comes round again, one more is needed to decode into
+		uint32_t minSlots = (uint32_t)computeFrames.size() + 1;
+		if (nSlots < minSlots) VMI_LOG("    Stream slots raised to " << minSlots << " for " << computeFrames.size() << " frames in flight");
+		LightFieldStream stream;
+		stream.init(allocator, std::move(pSource), std::max(nSlots, minSlots), policy, nDecoders);
+
+		// frames complete in the order they were submitted, one per frame in flight is pending
+		std::vector<LightFieldStream::Slot*> pendingSlots(computeFrames.size(), nullptr);
+		uint64_t nFrames = 0;
+		double latencySum = 0.0, latencyMax = 0.0;
+		auto complete = [&](uint32_t iFrameInFlight) {
+			LightFieldStream::Slot*& pSlot = pendingSlots[iFrameInFlight];
+			if (!pSlot) return;
+			double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pSlot->arrival).count();
+			latencySum += latency;
+			latencyMax = std::max(latencyMax, latency);
+			nFrames++;
+			if (!outputFolder.empty()) {
+				ComputeFrame& frame = computeFrames[iFrameInFlight];
+				std::ostringstream filename;
+				filename << "frame_" << std::setw(6) << std::setfill('0') << pSlot->iFrame << ".pfm";
+				std::vector<float> data = frame.disparityImage.read_back(device, allocator, frame.commandPool, device.computeQueue, vk::ImageLayout::eShaderReadOnlyOptimal);
+				PfmFile::write((std::filesystem::path(outputFolder) / filename.str()).string(), extent.width, extent.height, data.data() + 3, 4);
+			}
+			stream.release(pSlot);
+			pSlot = nullptr;
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		while (LightFieldStream::Slot* pSlot = stream.acquire()) {
+			iFrame++;
+			iComputeFrame = (iComputeFrame + 1) % computeFrames.size();
+			ComputeFrame& frame = computeFrames[iComputeFrame];
+			// the previous frame here is done once its fence signaled (submit_compute only resets it)
+			vk::Result result = device.logicalDevice.waitForFences(frame.commandBufferFence, VK_TRUE, UINT64_MAX);
+			if (result != vk::Result::eSuccess) assert(false);
+			complete(iComputeFrame);
+
+			// recorded commands are reused whenever this frame in flight meets the same slot again
+			pendingSlots[iComputeFrame] = pSlot;
+			frame.phaseHashes = DisparityCompute::get_phase_hashes(get_input_hash(), pcs);
+			uint64_t recordHash = Hash::combine(frame.phaseHashes.back(), (VkBuffer)pSlot->buffer);
+			submit_compute(device, frame, pcs, 0, recordHash, pSlot->buffer);
+		}
+		device.logicalDevice.waitIdle();
+		for (uint32_t i = 1; i <= computeFrames.size(); i++) complete((iComputeFrame + i) % computeFrames.size());
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stream.destroy();
+
+		VMI_LOG("Streamed " << nFrames << " frames in " << ms << " ms (" << 1000.0 * nFrames / std::max(ms, 1.0) << " frames/s, "
+			<< stream.get_dropped() << " dropped), latency mean " << latencySum / std::max<uint64_t>(nFrames, 1) << " ms, max " << latencyMax << " ms");
+	}
+	// reads outstanding compute timings, device has to be idle
+	void collect_profiler(DeviceWrapper& device) {
+		for (uint32_t i = 0; i < computeFrames.size(); i++) computeProfiler.collect(device, i, profilerStats);
+	}
+	// replaces the light field and all pipelines with those of another scene (headless only, device has to be idle)
+	void load_scene(DeviceWrapper& device, const std::string& folder) {
+		TRACE_SCOPE("Renderer::load_scene");
+		destroy_pipelines(device);
+		// without swapchain write and imgui, every set in the pool belongs to the pipelines (and the queries, created again on use)
+		destroy_query(device);
+		device.logicalDevice.resetDescriptorPool(descPool);
+		sceneFolder = folder;
+		create_pipelines(device, 1.0f);
+	}
+	inline bool has_ground_truth() { return groundTruth; }
+	// benchmark metrics of the latest result against the scene's ground truth, reduced on the compute queue (device has to be idle)
+	DisparityMetrics::Metrics evaluate(DeviceWrapper& device) {
+		ComputeFrame& frame = computeFrames[iComputeFrame];
+		vk::CommandBufferAllocateInfo allocInfo = vk::CommandBufferAllocateInfo()
+			.setLevel(vk::CommandBufferLevel::ePrimary)
+			.setCommandPool(frame.commandPool)
+			.setCommandBufferCount(1);
+		vk::CommandBuffer commandBuffer = device.logicalDevice.allocateCommandBuffers(allocInfo)[0];
+		commandBuffer.begin(vk::CommandBufferBeginInfo().setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		disparityMetrics.record(commandBuffer, iComputeFrame);
+		commandBuffer.end();
+
+		device.computeQueue.submit(vk::SubmitInfo().setCommandBuffers(commandBuffer));
+		device.computeQueue.waitIdle();
+		device.logicalDevice.freeCommandBuffers(frame.commandPool, commandBuffer);
+		return disparityMetrics.get_metrics(allocator);
+	}
+	// writes the raw disparity of the latest result to a .pfm file (device has to be idle)
+	void export_disparity(DeviceWrapper& device, const std::string& filename) {
+		// read back on the compute queue, which owns the disparity images
+		ComputeFrame& frame = computeFrames[iComputeFrame];
+		vk::Extent3D extent = frame.disparityImage.get_extent();
+		std::vector<float> data = frame.disparityImage.read_back(device, allocator, frame.commandPool, device.computeQueue, vk::ImageLayout::eShaderReadOnlyOptimal);
+		PfmFile::write(filename, extent.width, extent.height, data.data() + 3, 4);
+		VMI_LOG("Exported disparity map to " << filename);
 	}
 
 private:
+	bool recreate_swapchain(DeviceWrapper& device) {
+		// disparity outputs keep their internal resolution, only swapchain sized resources change
+		device.logicalDevice.waitIdle();
+		if (!swapchain.recreate(device, *pWindow)) return false;
+		swapchainWrite.recreate_framebuffers(device, swapchain);
+		ImGui_ImplVulkan_SetMinImageCount(swapchain.get_image_count());
+		resized = false;
+		return true;
+	}
+	// recordHash identifies everything the recorded commands depend on, unchanged buffers are submitted as they are
+	// a staging buffer is uploaded into the light field before the phases (streams)
+	void submit_compute(DeviceWrapper& device, ComputeFrame& frame, PushConstants pcs, uint32_t iFirstPhase, uint64_t recordHash, vk::Buffer stagingBuffer = nullptr) {
+		TRACE_SCOPE("submit_compute");
+		// wait for the previous computation into this frame before recording to it again
+		vk::Result result = device.logicalDevice.waitForFences(frame.commandBufferFence, VK_TRUE, UINT64_MAX);
+		if (result != vk::Result::eSuccess) assert(false);
+		device.logicalDevice.resetFences(frame.commandBufferFence);
+		computeProfiler.collect(device, iComputeFrame, profilerStats);
+
+		vk::CommandBuffer commandBuffer = frame.commandBuffers[iFirstPhase];
+		if (!frame.recorded[iFirstPhase] || frame.recordedHashes[iFirstPhase] != recordHash) {
+			TRACE_SCOPE("record_disparity");
+			commandBuffer.begin(vk::CommandBufferBeginInfo());
+			record_disparity(device, frame, commandBuffer, pcs, iFirstPhase, stagingBuffer);
+			commandBuffer.end();
+			frame.recorded[iFirstPhase] = true;
+			frame.recordedHashes[iFirstPhase] = recordHash;
+		}
+		computeProfiler.resubmit(iComputeFrame, iFrame);
+
+		// wait until the last display of this frame's image is done, then hand it to the display pass
+		std::vector<vk::Semaphore> waitSemaphores, signalSemaphores;
+		std::vector<vk::PipelineStageFlags> waitStages;
+		if (frame.displayPending) {
+			waitSemaphores.push_back(frame.displayFinished);
+			waitStages.push_back(vk::PipelineStageFlagBits::eComputeShader);
+			frame.displayPending = false;
+		}
+		if (!headless) signalSemaphores.push_back(frame.computeFinished);
+
+		vk::SubmitInfo submitInfo = vk::SubmitInfo()
+			.setWaitSemaphores(waitSemaphores)
+			.setWaitDstStageMask(waitStages)
+			.setSignalSemaphores(signalSemaphores)
+			.setCommandBufferCount(1).setPCommandBuffers(&commandBuffer);
+		device.computeQueue.submit(submitInfo, frame.commandBufferFence);
+		if (!publishName.empty()) publish(device, frame);
+	}
+	// the copy into shared memory follows the computation on the same queue, readers see it once that copy completed
+	void publish(DeviceWrapper& device, ComputeFrame& frame) {
+		vk::Extent3D extent = frame.disparityImage.get_extent();
+		if (publisher.get_extent() != extent) {
+			publisher.destroy(device);
+			publisher.init(device, allocator, publishName, extent, frame.disparityImage.get_texel_size(), nPublishSlots);
+		}
+		if (publisher.is_enabled()) publisher.publish(device, frame.disparityImage, iFrame);
+	}
+	void record_disparity(DeviceWrapper& device, ComputeFrame& frame, vk::CommandBuffer commandBuffer, PushConstants pcs, uint32_t iFirstPhase,
+		vk::Buffer stagingBuffer) {
+		ImageWrapper& disparityImage = frame.disparityImage;
+
+		computeProfiler.reset(commandBuffer, iComputeFrame, iFrame);
+		if (stagingBuffer) {
+			// the light field is shared by all frames in flight, so the copy waits for the phases of the previous frame on this queue
+			lightFieldImage.barrier(commandBuffer, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+				vk::PipelineStageFlagBits::eComputeShader, {},
+				vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite);
+			lightFieldImage.record_upload(commandBuffer, stagingBuffer);
+			lightFieldImage.barrier(commandBuffer, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+				vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite,
+				vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead);
+		}
+		disparityCompute.record(commandBuffer, frame.get_phase_outputs(), pcs, iFirstPhase, iComputeFrame, &computeProfiler, iComputeFrame);
+
+		// release to the graphics queue family if the display pass runs on a different one. later barriers on this queue
+		// (the copy of DisparityPublisher) chain to the transition through the all commands stage
+		bool transferOwnership = !headless && device.iComputeQueue != device.iGraphicsQueue;
+		disparityImage.barrier(commandBuffer, vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal,
+			vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite,
+			vk::PipelineStageFlagBits::eAllCommands, {},
+			transferOwnership ? device.iComputeQueue : VK_QUEUE_FAMILY_IGNORED,
+			transferOwnership ? device.iGraphicsQueue : VK_QUEUE_FAMILY_IGNORED);
+	}
+
 	void create_vma_allocator(DeviceWrapper& device, Window& window) {
 		vk::DynamicLoader dl;
 		vma::VulkanFunctions vulkanFunctions = vma::VulkanFunctions()
@@ -67,6 +690,7 @@ private:
 			.setInstance(window.get_vulkan_instance())
 			.setVulkanApiVersion(VK_API_VERSION)
 			.setFlags(vma::AllocatorCreateFlagBits::eKhrDedicatedAllocation);
+		if (device.memoryBudget) info.flags |= vma::AllocatorCreateFlagBits::eExtMemoryBudget;
 
 		allocator = vma::createAllocator(info);
 	}
@@ -81,8 +705,12 @@ private:
 	}
 	void create_descriptor_pools(DeviceWrapper& device) {
 		static constexpr uint32_t poolSize = 1000;
-		std::array<vk::DescriptorPoolSize, 1>  poolSizes = {
-			vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, poolSize)
+		std::array<vk::DescriptorPoolSize, 5>  poolSizes = {
+			vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, poolSize),
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, poolSize),
+			vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, poolSize),
+			vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, poolSize),
+			vk::DescriptorPoolSize(vk::DescriptorType::eSampler, poolSize)
 			// TODO: other stuff this pool will need
 		};
 		vk::DescriptorPoolCreateFlags flags;
@@ -93,44 +721,134 @@ private:
 			.setPoolSizeCount((uint32_t)poolSizes.size())
 			.setPPoolSizes(poolSizes.data());
 		descPool = device.logicalDevice.createDescriptorPool(info);
+		// pools are externally synchronized, the display pipeline gets its own so that it can be created next to the compute pipelines
+		displayDescPool = device.logicalDevice.createDescriptorPool(info);
 	}
 
-	void create_pipelines(DeviceWrapper& device) {
-		vk::ImageUsageFlags usage;
-
-		usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
-		lightFieldImage.init(device, allocator, vk::Extent3D(swapchain.get_extent(), 9), usage);
-		std::vector<int> indices = { 38, 48, 57, 40, 49, 58, 41, 50, 59 };
-		lightFieldImage.load3D(device, allocator, transferCommandPool, "benchmark/training/cotton/", "input_Cam", indices);
-		lightFieldImage.transition_layout(device, transferCommandPool, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+	void create_profilers(DeviceWrapper& device, Arguments& args) {
+		profilerStats.init(args.profileFile);
 
-		usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eColorAttachment;
-		disparityImage.init(device, allocator, vk::Extent3D(swapchain.get_extent(), 1), usage);
-		disparityImage.transition_layout(device, transferCommandPool, vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal);
-
-		disparityCompute.init(device, descPool, lightFieldImage, disparityImage);
-		swapchainWrite.init(device, swapchain, descPool, disparityImage);
+		std::vector<std::string> phaseNames;
+		for (uint32_t i = 0; i < DisparityCompute::nPhases; i++) phaseNames.push_back("phase_" + std::to_string(i));
+		computeProfiler.init(device, device.iComputeQueue, (uint32_t)computeFrames.size(), phaseNames, vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations);
+		// transfer families can't reset query pools, the upload profiler resets its pool from the host (disabled without timestamps)
+		if (device.hostQueryReset) uploadProfiler.init(device, device.iTransferQueue, 1, { "upload" }, {});
+		else VMI_LOG("    Upload timings need VK_EXT_host_query_reset, disabled");
+		if (!headless) graphicsProfiler.init(device, device.iGraphicsQueue, swapchain.get_frames_in_flight(), { "swapchain_write" }, vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations);
+	}
+	void destroy_profilers(DeviceWrapper& device) {
+		computeProfiler.destroy(device);
+		uploadProfiler.destroy(device);
+		if (!headless) graphicsProfiler.destroy(device);
+		profilerStats.destroy();
+	}
+	// light field and estimator (including its parameters) that all phases depend on
+	uint64_t get_input_hash() { return Hash::combine(lightFieldHash, get_estimator().get_hash()); }
+	// all scene dependent stages one after another
+	void create_pipelines(DeviceWrapper& device, float resolutionScale) {
+		TRACE_SCOPE("Renderer::create_pipelines");
+		decode_light_field();
+		create_frames(device, resolutionScale);
+		upload_light_field(device);
+		create_compute_pipelines(device);
+		create_metrics(device);
+		if (!headless) create_display(device);
+	}
+	void destroy_query(DeviceWrapper& device) {
+		if (!queryReady) return;
+		disparityQuery.destroy(device, allocator);
+		device.logicalDevice.destroyFence(queryFence);
+		device.logicalDevice.destroyCommandPool(queryCommandPool);
+		queryReady = false;
+	}
+	std::vector<ImageWrapper*> get_disparity_images() {
+		std::vector<ImageWrapper*> disparityImages;
+		for (ComputeFrame& frame : computeFrames) disparityImages.push_back(&frame.disparityImage);
+		return disparityImages;
+	}
+	bool load_ground_truth(DeviceWrapper& device, const std::string& filename) {
+		uint32_t width, height;
+		std::vector<float> data = PfmFile::read(filename, width, height);
+		if (data.empty()) return false;
+		groundTruthImage.init(device, allocator, vk::Extent3D(width, height, 1), vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+		groundTruthImage.load_rows(device, allocator, transferCommandPool, reinterpret_cast<const uint8_t*>(data.data()), height, 0);
+		groundTruthImage.transition_layout(device, transferCommandPool, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+		return true;
 	}
 	void destroy_pipelines(DeviceWrapper& device) {
+		if (groundTruth) {
+			disparityMetrics.destroy(device, allocator);
+			groundTruthImage.destroy(device, allocator);
+			groundTruth = false;
+		}
 		lightFieldImage.destroy(device, allocator);
-		disparityImage.destroy(device, allocator);
+		for (ComputeFrame& frame : computeFrames) frame.destroy(device, allocator);
+		memoryPools.destroy(allocator);
 		
-		disparityCompute.destroy(device);
-		swapchainWrite.destroy(device);
+		disparityCompute.destroy(device, allocator);
+		if (!headless) swapchainWrite.destroy(device);
+		sceneLoaded = false;
 	}
 
 private:
 	vma::Allocator allocator;
 	SwapchainWrapper swapchain;
+	PipelineCache pipelineCache;
+	Window* pWindow = nullptr;
+	bool resized = false;
 
 	DisparityCompute disparityCompute;
 	SwapchainWrite swapchainWrite;
 	ImguiWrapper imgui;
 
 	ImageWrapper lightFieldImage = { vk::Format::eR8G8B8A8Unorm };
-	ImageWrapper disparityImage = { vk::Format::eR32G32B32A32Sfloat };
+	uint64_t lightFieldHash = 0; // identifies the loaded light field for the phase hashes
+	std::vector<int> lightFieldIndices = { 38, 48, 57, 40, 49, 58, 41, 50, 59 }; // views of the 3x3 centre, u major
+	std::vector<uint8_t> lightFieldData; // decoded views until they are uploaded
+	vk::Extent2D lightFieldExtent;
+	std::string estimatorName = "gradient"; // kept across scenes loaded by load_scene
+	std::string kernelVariant; // tuned for the device, empty for the default
+	std::string sceneFolder = "benchmark/training/cotton/";
+
+	// headless only, if the scene has ground truth
+	ImageWrapper groundTruthImage = { vk::Format::eR32Sfloat };
+	DisparityMetrics disparityMetrics;
+	bool groundTruth = false;
+
+	// disparity outputs per frame in flight, so compute and display of consecutive frames can overlap
+	std::vector<ComputeFrame> computeFrames;
+	MemoryPools memoryPools; // of the compute frame images
+	uint32_t iComputeFrame = 0;
 
 	vk::CommandPool transientCommandPool;
 	vk::CommandPool transferCommandPool;
 	vk::DescriptorPool descPool;
+	vk::DescriptorPool displayDescPool;
+
+	// gpu timings per pass (compute phases, swapchain write, uploads)
+	ProfilerStats profilerStats;
+	GpuProfiler computeProfiler, graphicsProfiler, uploadProfiler;
+	uint64_t iFrame = 0;
+
+	// bindless batches (--batch, daemon), created on first use
+	DisparityBatch disparityBatch;
+	vk::CommandPool batchCommandPool;
+	vk::CommandBuffer batchCommandBuffer;
+	vk::Fence batchFence;
+	bool batchReady = false;
+
+	// point and region queries (query_disparity), created on first use
+	DisparityQuery disparityQuery;
+	vk::CommandPool queryCommandPool;
+	vk::CommandBuffer queryCommandBuffer;
+	vk::Fence queryFence;
+	bool queryReady = false;
+
+	// every computed disparity map is published to other processes if a name is given (headless only)
+	DisparityPublisher publisher;
+	std::string publishName;
+	uint32_t nPublishSlots = 4;
+
+	bool headless = false;
+	bool sceneLoaded = false; // batches and streams create their pipelines later
 };
\ No newline at end of file
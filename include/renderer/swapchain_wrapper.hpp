@@ -9,52 +9,72 @@ public:
 	SwapchainWrapper() = default;
 	~SwapchainWrapper() = default;
 
-	void init(DeviceWrapper& device, Window& window) {
+	// the number of frames in flight is independent of the swapchain image count
+	void init(DeviceWrapper& device, Window& window, uint32_t nFramesInFlight) {
 		choose_surface_format(device);
 		choose_present_mode(device);
 		choose_extent(device, window);
 
-		create_swapchain(device, window);
+		create_swapchain(device, window, nullptr);
 		create_images(device);
 		create_image_views(device);
-		create_sync_frames(device);
+		create_sync_frames(device, nFramesInFlight);
+		create_present_semaphores(device);
 	}
 	void destroy(DeviceWrapper& device) {
 		device.logicalDevice.destroySwapchainKHR(swapchain);
+		destroy_images(device);
+		for (SyncFrame& syncFrame : syncFrames) syncFrame.destroy(device);
+	}
+	// on resize or when out of date, device has to be idle
+	// returns false while the surface has no area (minimized), the old swapchain stays in use then
+	bool recreate(DeviceWrapper& device, Window& window) {
+		TRACE_SCOPE("SwapchainWrapper::recreate");
+		choose_extent(device, window);
+		if (extent.width == 0 || extent.height == 0) return false;
+		destroy_images(device);
 
-		for (size_t i = 0; i < images.size(); i++) {
-			device.logicalDevice.destroyImageView(imageViews[i]);
-			syncFrames[i].destroy(device);
-		}
+		vk::SwapchainKHR oldSwapchain = swapchain;
+		create_swapchain(device, window, oldSwapchain);
+		device.logicalDevice.destroySwapchainKHR(oldSwapchain);
+
+		create_images(device);
+		create_image_views(device);
+		create_present_semaphores(device);
+		VMI_LOG("Recreated swapchain (" << extent.width << "x" << extent.height << ")");
+		return true;
 	}
 
 	inline SyncFrame& get_sync_frame() { return syncFrames[curSyncFrame]; }
+	inline uint32_t get_sync_frame_index() { return curSyncFrame; }
 	inline vk::ImageView& get_image_view(uint32_t i) { return imageViews[i]; }
 	inline uint32_t get_image_count() { return images.size(); }
+	inline uint32_t get_frames_in_flight() { return syncFrames.size(); }
 	inline vk::Extent2D get_extent() { return extent; }
 	inline vk::SurfaceFormatKHR get_surface_format() { return surfaceFormat; }
 
-	uint32_t acquire_next_image(vk::Device device) {
+	// returns false if the swapchain is out of date and has to be recreated before rendering
+	bool acquire_next_image(vk::Device device, uint32_t& iSwapchainImage) {
 
 		// get next frame of sync array
 		curSyncFrame = (curSyncFrame + 1) % syncFrames.size();
 		SyncFrame& syncFrame = syncFrames[curSyncFrame];
 
-		// Acquire image
-		vk::ResultValue imgResult = device.acquireNextImageKHR(swapchain, UINT64_MAX, syncFrame.imageAvailable);
-		switch (imgResult.result) {
-			case vk::Result::eSuccess: break;
-			case vk::Result::eSuboptimalKHR: VMI_LOG("Suboptimal image acquisition."); break;
-			case vk::Result::eErrorOutOfDateKHR: VMI_ERR("Swapchain (Image Acquisition): KHR out of date."); break;
-			default: assert(false);
+		// Acquire image (non-throwing overload, out of date is expected on resize)
+		TRACE_SCOPE("vkAcquireNextImageKHR");
+		vk::Result result = device.acquireNextImageKHR(swapchain, UINT64_MAX, syncFrame.imageAvailable, nullptr, &iSwapchainImage);
+		switch (result) {
+			case vk::Result::eSuccess: return true;
+			case vk::Result::eSuboptimalKHR: outdated = true; return true; // still presentable, recreate after this frame
+			case vk::Result::eErrorOutOfDateKHR: return false;
+			default: assert(false); return false;
 		}
-
-		return imgResult.value;
 	}
 	vk::CommandBuffer record_commands(DeviceWrapper& device, uint32_t iSwapchainImage) {
 
 		// wait for fence of fetched frame before rendering to it
 		SyncFrame& syncFrame = syncFrames[curSyncFrame];
+		TRACE_SCOPE("wait_frame_fence");
 		vk::Result result = device.logicalDevice.waitForFences(syncFrame.commandBufferFence, VK_TRUE, UINT64_MAX);
 		if (result != vk::Result::eSuccess) assert(false);
 		
@@ -72,39 +92,56 @@ public:
 
 		return syncFrame.commandBuffer;
 	}
-	void present(DeviceWrapper& device, uint32_t iFrame) {
+	// optionally waits on an additional semaphore (e.g. from the compute queue) and signals another one once rendering finished
+	void present(DeviceWrapper& device, uint32_t iFrame,
+		vk::Semaphore extraWait = nullptr, vk::PipelineStageFlags extraWaitStage = {}, vk::Semaphore extraSignal = nullptr) {
 		SyncFrame& syncFrame = syncFrames[curSyncFrame];
 
 		// finalize command buffer
 		syncFrame.commandBuffer.end();
 
+		std::vector<vk::Semaphore> waitSemaphores = { syncFrame.imageAvailable };
+		std::vector<vk::PipelineStageFlags> waitStages = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+		std::vector<vk::Semaphore> signalSemaphores = { renderFinished[iFrame] };
+		if (extraWait) {
+			waitSemaphores.push_back(extraWait);
+			waitStages.push_back(extraWaitStage);
+		}
+		if (extraSignal) signalSemaphores.push_back(extraSignal);
+
 		// Render (submit commands)
-		vk::PipelineStageFlags waitStages = vk::PipelineStageFlagBits::eColorAttachmentOutput;
 		vk::SubmitInfo submitInfo = vk::SubmitInfo()
-			.setPWaitDstStageMask(&waitStages)
+			.setWaitDstStageMask(waitStages)
 			// semaphores
-			.setWaitSemaphoreCount(1).setPWaitSemaphores(&syncFrame.imageAvailable)
-			.setSignalSemaphoreCount(1).setPSignalSemaphores(&syncFrame.renderFinished)
+			.setWaitSemaphores(waitSemaphores)
+			.setSignalSemaphores(signalSemaphores)
 			// command buffers
 			.setCommandBufferCount(1).setPCommandBuffers(&syncFrame.commandBuffer);
 
-		device.graphicsQueue.submit(submitInfo, syncFrame.commandBufferFence);
+		{
+			TRACE_SCOPE("vkQueueSubmit");
+			device.graphicsQueue.submit(submitInfo, syncFrame.commandBufferFence);
+		}
 
 		// Present
 		vk::PresentInfoKHR presentInfo = vk::PresentInfoKHR()
 			.setPImageIndices(&iFrame)
 			// semaphores
-			.setWaitSemaphoreCount(1).setPWaitSemaphores(&syncFrame.renderFinished)
+			.setWaitSemaphoreCount(1).setPWaitSemaphores(&renderFinished[iFrame])
 			// swapchains
 			.setSwapchainCount(1).setPSwapchains(&swapchain);
 
+		TRACE_SCOPE("vkQueuePresentKHR");
 		vk::Result result = device.graphicsQueue.presentKHR(&presentInfo);
 		switch (result) {
 			case vk::Result::eSuccess: break;
-			case vk::Result::eErrorOutOfDateKHR: VMI_ERR("Swapchain (Present): KHR out of date."); break;
+			case vk::Result::eSuboptimalKHR:
+			case vk::Result::eErrorOutOfDateKHR: outdated = true; break;
 			default: assert(false);
 		}
 	}
+	// suboptimal or out of date during the last acquire or present
+	inline bool is_outdated() { return outdated; }
 
 private:
 	void choose_surface_format(DeviceWrapper& device) {
@@ -134,15 +171,22 @@ private:
 		presentMode = vk::PresentModeKHR::eFifo;
 	}
 	void choose_extent(DeviceWrapper& device, Window& window) {
+		// capabilities change with the window size
+		device.capabilities = device.physicalDevice.getSurfaceCapabilitiesKHR(window.get_vulkan_surface());
 		auto& capabilities = device.capabilities;
 
-		auto windowSize = window.get_size();
+		// some platforms let the swapchain define the extent
+		if (capabilities.currentExtent.width != UINT32_MAX) {
+			extent = capabilities.currentExtent;
+			return;
+		}
 
+		auto windowSize = window.get_size();
 		extent = vk::Extent2D()
-			.setWidth(windowSize.first)
-			.setHeight(windowSize.second);
+			.setWidth(std::clamp(windowSize.first, capabilities.minImageExtent.width, capabilities.maxImageExtent.width))
+			.setHeight(std::clamp(windowSize.second, capabilities.minImageExtent.height, capabilities.maxImageExtent.height));
 	}
-	void create_swapchain(DeviceWrapper& device, Window& window) {
+	void create_swapchain(DeviceWrapper& device, Window& window, vk::SwapchainKHR oldSwapchain) {
 		if (device.capabilities.minImageCount > nTargetSwapchainImages) nImages = device.capabilities.minImageCount;
 		else nImages = nTargetSwapchainImages;
 
@@ -172,10 +216,17 @@ private:
 			.setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque)
 			.setPresentMode(presentMode)
 			.setClipped(VK_TRUE)
-			.setOldSwapchain(nullptr); // pointer to old swapchain on resize
+			.setOldSwapchain(oldSwapchain); // pointer to old swapchain on resize
 
 		// finally, create swapchain
 		swapchain = device.logicalDevice.createSwapchainKHR(swapchainInfo);
+		outdated = false;
+	}
+	void destroy_images(DeviceWrapper& device) {
+		for (size_t i = 0; i < images.size(); i++) {
+			device.logicalDevice.destroyImageView(imageViews[i]);
+			device.logicalDevice.destroySemaphore(renderFinished[i]);
+		}
 	}
 
 	void create_images(DeviceWrapper& device) {
@@ -205,16 +256,24 @@ private:
 			imageViews[i] = device.logicalDevice.createImageView(imageInfo);
 		}
 	}
-	void create_sync_frames(DeviceWrapper& device) {
-		syncFrames.resize(images.size());
-		for (int i = 0; i < images.size(); i++) {
-			syncFrames[i].init(device);
+	void create_sync_frames(DeviceWrapper& device, uint32_t nFramesInFlight) {
+		syncFrames.resize(nFramesInFlight);
+		for (SyncFrame& syncFrame : syncFrames) {
+			syncFrame.init(device);
+		}
+	}
+	void create_present_semaphores(DeviceWrapper& device) {
+		// presentation has no fence, so its semaphore can only be reused once the same image is acquired again
+		vk::SemaphoreCreateInfo semaphoreInfo = vk::SemaphoreCreateInfo();
+		renderFinished.resize(images.size());
+		for (vk::Semaphore& semaphore : renderFinished) {
+			semaphore = device.logicalDevice.createSemaphore(semaphoreInfo);
 		}
 	}
 
 private:
 	// some settings
-	static constexpr uint32_t nTargetSwapchainImages = 2; // targeted max frames in flight
+	static constexpr uint32_t nTargetSwapchainImages = 2;
 	static constexpr vk::Format targetFormat = vk::Format::eB8G8R8A8Srgb;
 	static constexpr vk::ColorSpaceKHR targetColorSpace = vk::ColorSpaceKHR::eSrgbNonlinear;
 	static constexpr vk::PresentModeKHR targetPresentMode = vk::PresentModeKHR::eFifo; // vsync
@@ -231,6 +290,8 @@ private:
 	uint32_t nImages;
 	std::vector<vk::Image> images;
 	std::vector<vk::ImageView> imageViews;
-	std::vector<SyncFrame> syncFrames;
+	std::vector<vk::Semaphore> renderFinished; // per swapchain image
+	std::vector<SyncFrame> syncFrames; // per frame in flight
 	uint32_t curSyncFrame = 0;
+	bool outdated = false;
 };
\ No newline at end of file
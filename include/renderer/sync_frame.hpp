@@ -6,16 +6,19 @@ class SyncFrame
 {
 public:
 	void init(DeviceWrapper& device)
+	{
+		init(device, device.iGraphicsQueue);
+	}
+	void init(DeviceWrapper& device, uint32_t iQueueFamily)
 	{
 		create_semaphores(device);
 		create_fence(device);
-		create_command_pools(device);
+		create_command_pools(device, iQueueFamily);
 		create_command_buffer(device);
 	}
 	void destroy(DeviceWrapper& device)
 	{
 		device.logicalDevice.destroySemaphore(imageAvailable);
-		device.logicalDevice.destroySemaphore(renderFinished);
 		device.logicalDevice.destroyFence(commandBufferFence);
 		device.logicalDevice.destroyCommandPool(commandPool);
 	}
@@ -26,7 +29,6 @@ private:
 		vk::SemaphoreCreateInfo semaphoreInfo = vk::SemaphoreCreateInfo();
 
 		imageAvailable = device.logicalDevice.createSemaphore(semaphoreInfo);
-		renderFinished = device.logicalDevice.createSemaphore(semaphoreInfo);
 	}
 	void create_fence(DeviceWrapper& device)
 	{
@@ -35,12 +37,12 @@ private:
 
 		commandBufferFence = device.logicalDevice.createFence(fenceInfo);
 	}
-	void create_command_pools(DeviceWrapper& device)
+	void create_command_pools(DeviceWrapper& device, uint32_t iQueueFamily)
 	{
 		vk::CommandPoolCreateInfo commandPoolInfo;
 
 		commandPoolInfo = vk::CommandPoolCreateInfo()
-			.setQueueFamilyIndex(device.iGraphicsQueue);
+			.setQueueFamilyIndex(iQueueFamily);
 		commandPool = device.logicalDevice.createCommandPool(commandPoolInfo);
 
 	}
@@ -55,7 +57,6 @@ private:
 
 public:
 	vk::Semaphore imageAvailable;
-	vk::Semaphore renderFinished;
 	vk::Fence commandBufferFence;
 
 	vk::CommandPool commandPool;
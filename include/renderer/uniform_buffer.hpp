@@ -1,5 +1,7 @@
 #pragma once
 
+#include "utils/ring_buffer.hpp"
+
 struct BufferInfo
 {
 	DeviceWrapper& deviceWrapper;
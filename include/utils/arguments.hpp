@@ -0,0 +1,115 @@
+#pragma once
+
+// command line settings, parsed once in main()
+struct Arguments
+{
+	static Arguments parse(int argc, char* argv[]) {
+		Arguments args;
+		for (int i = 1; i < argc; i++) {
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "--headless") args.headless = true;
+			else if (arg == "--frames" && hasValue) args.nFrames = (uint32_t)std::stoul(argv[++i]);
+			else if (arg == "--frames-in-flight" && hasValue) args.nFramesInFlight = std::max(1u, (uint32_t)std::stoul(argv[++i]));
+			else if (arg == "--preview-scale" && hasValue) args.previewScale = std::clamp(std::stof(argv[++i]), 0.05f, 1.0f);
+			else if (arg == "--steps" && hasValue) args.nSteps = (uint32_t)std::stoul(argv[++i]);
+			else if (arg == "--filter-radius" && hasValue) args.filterRadius = (uint32_t)std::stoul(argv[++i]);
+			else if (arg == "--filter-edges" && hasValue) args.filterEdges = std::stof(argv[++i]);
+			else if (arg == "--estimator" && hasValue) args.estimator = argv[++i];
+			else if (arg == "--output" && hasValue) args.outputPath = argv[++i];
+			else if (arg == "--pipeline-cache" && hasValue) args.pipelineCacheFile = argv[++i];
+			else if (arg == "--autotune") args.autotune = true;
+			else if (arg == "--tuning" && hasValue) args.tuningFile = argv[++i];
+			else if (arg == "--profile" && hasValue) args.profileFile = argv[++i];
+			else if (arg == "--trace" && hasValue) args.traceFile = argv[++i];
+			else if (arg == "--batch" && hasValue) args.batchFile = argv[++i];
+			else if (arg == "--report" && hasValue) args.reportFile = argv[++i];
+			else if (arg == "--stream" && hasValue) args.streamSource = argv[++i];
+			else if (arg == "--stream-slots" && hasValue) args.nStreamSlots = std::max(2u, (uint32_t)std::stoul(argv[++i]));
+			else if (arg == "--stream-policy" && hasValue) args.streamDropOldest = std::string(argv[++i]) == "drop";
+			else if (arg == "--decoders" && hasValue) args.nDecoders = std::max(1u, (uint32_t)std::stoul(argv[++i]));
+			else if (arg == "--publish" && hasValue) args.publishName = argv[++i];
+			else if (arg == "--publish-slots" && hasValue) args.nPublishSlots = std::max(2u, (uint32_t)std::stoul(argv[++i]));
+			else if (arg == "--serve" && hasValue) args.serveSocket = argv[++i];
+			else if (arg == "--batch-window" && hasValue) args.batchWindowMs = (uint32_t)std::stoul(argv[++i]);
+			else if (arg == "--multi-device") args.multiDevice = true;
+			else if (arg == "--devices" && hasValue) {
+				args.nDevices = std::max(1u, (uint32_t)std::stoul(argv[++i]));
+				args.multiDevice = true;
+			}
+			else VMI_WARN("Ignoring unknown or incomplete argument: " << arg);
+		}
+		// batches are always processed without a window
+		if (!args.batchFile.empty() || !args.reportFile.empty() || !args.streamSource.empty() || !args.publishName.empty() || !args.serveSocket.empty() || args.multiDevice || args.autotune) args.headless = true;
+		return args;
+	}
+
+	// scene folders listed in a batch or report file, one per line
+	static std::vector<std::string> read_scenes(const std::string& filename) {
+		std::vector<std::string> scenes;
+		std::ifstream file(filename);
+		if (!file) VMI_ERR("Could not open scene list: " << filename);
+		std::string line;
+		while (std::getline(file, line)) {
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (!line.empty() && line[0] != '#') scenes.push_back(line);
+		}
+		return scenes;
+	}
+
+	// compute-only mode without window, surface or swapchain
+	bool headless = false;
+	// number of disparity computations to run in headless mode
+	uint32_t nFrames = 1;
+	// frames the cpu may record ahead of the gpu, each with its own disparity outputs and descriptor sets
+	uint32_t nFramesInFlight = 2;
+	// disparity resolution relative to the light field in the interactive viewer (headless always runs at native resolution)
+	float previewScale = 1.0f;
+	// initial confidence cutoff steps (each marks another 5% of the least confident pixels as uncertain,
+	// --batch, --serve and --multi-device use a fixed confidence of 0.00005 per step instead)
+	uint32_t nSteps = 0;
+	// edge-aware post filter radius in pixels (0 disables it, clamped to DisparityCompute::maxFilterRadius by the shader)
+	uint32_t filterRadius = 8;
+	// how strongly edges in the centre view stop the filter
+	float filterEdges = 100.0f;
+	// disparity estimator for phases 0 and 1, one of EstimatorRegistry::get_names()
+	std::string estimator = "gradient";
+	// optional .pfm export of the final disparity map (headless only), output folder in batch mode
+	std::string outputPath;
+	// persistent pipeline cache, validated against device and driver on load
+	std::string pipelineCacheFile = "pipeline_cache.bin";
+	// time every kernel variant on this device and store the fastest one that computes the same disparity (implies headless)
+	bool autotune = false;
+	// kernel variants tuned per device and driver, read on every start, written by --autotune
+	std::string tuningFile = "kernel_tuning.txt";
+	// optional stream of per-pass gpu timings (.csv, or .json by extension)
+	std::string profileFile;
+	// host side chrome trace, written on exit or on demand (F11)
+	std::string traceFile;
+	// text file listing scene folders to process with the bindless batch pipeline (implies headless)
+	std::string batchFile;
+	// text file listing scene folders to evaluate against their ground truth one after another (implies headless)
+	std::string reportFile;
+	// live light fields, a folder with one scene folder per frame or unix:<path> for a socket a capture process connects to (implies headless)
+	std::string streamSource;
+	// staging buffers between the decoders and the device, bounds the frames decoded ahead
+	uint32_t nStreamSlots = 4;
+	// when all slots are taken: drop the oldest decoded frame (bounded latency) instead of waiting for it (every frame)
+	bool streamDropOldest = false;
+	// threads decoding stream frames
+	uint32_t nDecoders = 2;
+	// posix shared memory object every computed disparity map is published to, see ShmRingReader (implies headless)
+	std::string publishName;
+	// frames in the shared memory ring, readers have until the ring wraps around to read a frame
+	uint32_t nPublishSlots = 4;
+	// daemon mode: serve disparity requests on this unix domain socket until a client sends shutdown (implies headless)
+	std::string serveSocket;
+	// how long the daemon waits for further requests to join a batch once one arrived
+	uint32_t batchWindowMs = 2;
+	// split the headless disparity map across all suitable devices (implies headless),
+	// which uses a fixed confidence threshold per step instead of the percentile of the whole image
+	bool multiDevice = false;
+	// minimum number of logical devices for --multi-device, adapters are reused in turn to reach it
+	uint32_t nDevices = 1;
+};
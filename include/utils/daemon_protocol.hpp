@@ -0,0 +1,156 @@
+#pragma once
+
+// self-contained (no pch), shared by the daemon (--serve) and its clients
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // no SIGPIPE on closed connections where supported
+#endif
+#endif
+
+// line based protocol of the disparity daemon over a unix domain socket, a connection may send any number of requests in turn:
+//   compute scene=<folder> | packed=<file> [output=<file.pfm>] [shm=<name>] [steps=N] [radius=N] [edges=F]
+//   query scene=<folder> | packed=<file> [points=x,y;x,y;...] [rects=x,y,width,height;...]
+//   metrics
+//   shutdown
+// every request is answered by one line, "ok key=value ..." or "error <message>". packed files hold one light field stream frame
+// (header of four uint32: 0x5246464c, width, height, number of views, then the rgba8 views), shm results are single slot ShmRings.
+// queries answer with the raw disparity and confidence of the points and then the texels of every rectangle row by row,
+// as comma separated lists (disparity=... confidence=...). values can't contain spaces, out of range overrides
+// (steps above 20, radius above DisparityCompute::maxFilterRadius, edges above 1000) are rejected.
+// the scenes of a batch are not reduced individually, so steps=N marks the pixels below a fixed confidence of 0.00005 * N
+// as uncertain, unlike --steps in the viewer and headless modes, which marks the least confident 5 * N percent
+struct DaemonRequest
+{
+	// of a request line, enough for the points of the largest query, longer ones are answered with an error and close the connection
+	static constexpr size_t maxLength = 1 << 22;
+
+	std::string command;
+	std::map<std::string, std::string> values;
+
+	static bool parse(const std::string& line, DaemonRequest& request) {
+		std::istringstream stream(line);
+		request = {};
+		if (!(stream >> request.command)) return false;
+		std::string token;
+		while (stream >> token) {
+			size_t iSplit = token.find('=');
+			if (iSplit == std::string::npos || iSplit == 0) return false;
+			request.values[token.substr(0, iSplit)] = token.substr(iSplit + 1);
+		}
+		return true;
+	}
+	std::string to_line() const {
+		std::string line = command;
+		for (const auto& value : values) line += " " + value.first + "=" + value.second;
+		return line + "\n";
+	}
+	inline bool has(const std::string& key) const { return values.count(key) > 0; }
+	inline std::string get(const std::string& key) const { return has(key) ? values.at(key) : ""; }
+	// value of an optional key, false if it is present but not an integer in [0, max]
+	bool get_uint(const std::string& key, uint32_t max, uint32_t& value) const {
+		if (!has(key)) return true;
+		std::string text = get(key);
+		char* pEnd = nullptr;
+		unsigned long long parsed = std::strtoull(text.c_str(), &pEnd, 10);
+		if (text.empty() || text[0] == '-' || *pEnd != '\0' || parsed > max) return false;
+		value = (uint32_t)parsed;
+		return true;
+	}
+	// value of an optional key, false if it is present but not a finite number in [0, max]
+	bool get_float(const std::string& key, float max, float& value) const {
+		if (!has(key)) return true;
+		std::string text = get(key);
+		char* pEnd = nullptr;
+		float parsed = std::strtof(text.c_str(), &pEnd);
+		if (text.empty() || *pEnd != '\0' || !std::isfinite(parsed) || parsed < 0.0f || parsed > max) return false;
+		value = parsed;
+		return true;
+	}
+	// "a,b;c,d" as tuples of n integers each, false if any of them is malformed
+	bool get_tuples(const std::string& key, size_t n, std::vector<std::vector<int32_t>>& tuples) const {
+		tuples.clear();
+		std::istringstream list(get(key));
+		std::string tuple;
+		while (std::getline(list, tuple, ';')) {
+			if (tuple.empty()) continue;
+			std::istringstream elements(tuple);
+			std::string element;
+			tuples.emplace_back();
+			while (std::getline(elements, element, ',')) {
+				char* pEnd = nullptr;
+				long value = std::strtol(element.c_str(), &pEnd, 10);
+				if (element.empty() || *pEnd != '\0') return false;
+				tuples.back().push_back((int32_t)value);
+			}
+			if (tuples.back().size() != n) return false;
+		}
+		return true;
+	}
+};
+
+// blocking line io on a connected socket
+struct DaemonSocket
+{
+	// connects to a daemon, -1 if none listens on the path
+	static int connect_to(const std::string& path) {
+#ifdef _WIN32
+		return -1;
+#else
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path)) return -1;
+		path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+			close(fd);
+			fd = -1;
+		}
+		return fd;
+#endif
+	}
+	// false once the peer closed the connection or the line exceeds maxLength (then the buffer holds more than maxLength bytes),
+	// buffer keeps bytes past the line
+	static bool read_line(int fd, std::string& buffer, std::string& line, size_t maxLength = SIZE_MAX) {
+#ifndef _WIN32
+		while (true) {
+			size_t iEnd = buffer.find('\n');
+			if (iEnd != std::string::npos) {
+				line = buffer.substr(0, iEnd);
+				buffer.erase(0, iEnd + 1);
+				if (!line.empty() && line.back() == '\r') line.pop_back();
+				return true;
+			}
+			if (buffer.size() > maxLength) return false;
+			char chunk[4096];
+			ssize_t nRead = recv(fd, chunk, sizeof(chunk), 0);
+			if (nRead <= 0) return false;
+			buffer.append(chunk, (size_t)nRead);
+		}
+#else
+		return false;
+#endif
+	}
+	static bool write_line(int fd, const std::string& line) {
+#ifndef _WIN32
+		std::string data = line.empty() || line.back() != '\n' ? line + "\n" : line;
+		for (size_t iWritten = 0; iWritten < data.size();) {
+			ssize_t nWritten = send(fd, data.data() + iWritten, data.size() - iWritten, MSG_NOSIGNAL);
+			if (nWritten <= 0) return false;
+			iWritten += (size_t)nWritten;
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+};
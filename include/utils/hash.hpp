@@ -0,0 +1,21 @@
+#pragma once
+
+// 64 bit FNV-1a, used to detect changes in pipeline inputs and parameters
+struct Hash
+{
+	static constexpr uint64_t seed = 14695981039346656037ull;
+
+	static uint64_t combine(uint64_t hash, const void* pData, size_t size) {
+		const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= pBytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+	template<class T>
+	static uint64_t combine(uint64_t hash, const T& value) {
+		static_assert(std::is_trivially_copyable<T>::value, "Only plain data can be hashed bytewise");
+		return combine(hash, &value, sizeof(T));
+	}
+};
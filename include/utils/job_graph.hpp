@@ -0,0 +1,127 @@
+#pragma once
+
+// small dependency graph of one-shot jobs, run once by a few worker threads and the calling thread,
+// jobs only start after all their dependencies finished (e.g. startup: scene decode next to device and pipeline creation)
+class JobGraph
+{
+public:
+	typedef uint32_t JobId;
+
+public:
+	// dependencies have to be added first, main thread jobs only ever run on the thread that calls run() (e.g. SDL windows)
+	JobId add(const char* name, std::vector<JobId> dependencies, std::function<void()> work, bool mainThread = false) {
+		JobId id = (JobId)jobs.size();
+		for (JobId dependency : dependencies) {
+			if (dependency >= id) VMI_ERR("Job dependency added after its dependent: " << name);
+			else jobs[dependency].dependents.push_back(id);
+		}
+		jobs.push_back({ name, std::move(dependencies), std::move(work), mainThread });
+		return id;
+	}
+	// blocks until every job ran, the longest chain of dependencies determines the wall time
+	void run(uint32_t nThreads) {
+		TRACE_SCOPE("JobGraph::run");
+		for (Job& job : jobs) job.nPending = (uint32_t)job.dependencies.size();
+		for (JobId id = 0; id < jobs.size(); id++) {
+			if (jobs[id].nPending == 0) push_ready(id);
+		}
+		nRemaining = (uint32_t)jobs.size();
+		start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> workers;
+		for (uint32_t i = 1; i < std::max(nThreads, 1u); i++) workers.emplace_back([this]() { work(false); });
+		work(true);
+		for (std::thread& worker : workers) worker.join();
+		end = std::chrono::steady_clock::now();
+	}
+	// wall time next to the summed job times and the chain of jobs that finished last, each one started by its last dependency
+	void log_critical_path(const char* label) {
+		if (jobs.empty()) return;
+		double jobMs = 0.0;
+		for (Job& job : jobs) jobMs += get_ms(job.start, job.end);
+
+		JobId id = 0;
+		for (JobId i = 1; i < jobs.size(); i++) {
+			if (jobs[i].end > jobs[id].end) id = i;
+		}
+		std::vector<JobId> path = { id };
+		while (!jobs[id].dependencies.empty()) {
+			JobId last = jobs[id].dependencies[0];
+			for (JobId dependency : jobs[id].dependencies) {
+				if (jobs[dependency].end > jobs[last].end) last = dependency;
+			}
+			path.push_back(id = last);
+		}
+
+		std::ostringstream chain;
+		for (auto it = path.rbegin(); it != path.rend(); it++) {
+			chain << (it != path.rbegin() ? " -> " : "") << jobs[*it].name << " " << std::fixed << std::setprecision(1) << get_ms(jobs[*it].start, jobs[*it].end) << " ms";
+		}
+		VMI_LOG(label << ": " << get_ms(start, end) << " ms (" << jobMs << " ms of jobs on " << nThreadsUsed << " threads)");
+		VMI_LOG("    critical path: " << chain.str());
+	}
+
+private:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+	struct Job
+	{
+		const char* name; // has to be a string literal (trace)
+		std::vector<JobId> dependencies;
+		std::function<void()> work;
+		bool mainThread;
+		std::vector<JobId> dependents;
+		uint32_t nPending = 0;
+		TimePoint start;
+		TimePoint end;
+	};
+
+	static double get_ms(TimePoint from, TimePoint to) {
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+	// requires the lock (or no running workers)
+	void push_ready(JobId id) {
+		if (jobs[id].mainThread) readyMain.push(id);
+		else ready.push(id);
+	}
+	void work(bool mainThread) {
+		bool used = false;
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			// the main thread prefers its own jobs, workers never take them
+			condition.wait(lock, [&]() { return nRemaining == 0 || !ready.empty() || (mainThread && !readyMain.empty()); });
+			if (nRemaining == 0) break;
+			std::queue<JobId>& queue = mainThread && !readyMain.empty() ? readyMain : ready;
+			JobId id = queue.front();
+			queue.pop();
+			if (!used) nThreadsUsed++;
+			used = true;
+
+			lock.unlock();
+			Job& job = jobs[id];
+			job.start = std::chrono::steady_clock::now();
+			{
+				TraceScope scope(job.name);
+				job.work();
+			}
+			job.end = std::chrono::steady_clock::now();
+			lock.lock();
+
+			for (JobId dependent : job.dependents) {
+				if (--jobs[dependent].nPending == 0) push_ready(dependent);
+			}
+			nRemaining--;
+			condition.notify_all();
+		}
+	}
+
+private:
+	std::vector<Job> jobs;
+	std::queue<JobId> ready;
+	std::queue<JobId> readyMain;
+	uint32_t nRemaining = 0;
+	uint32_t nThreadsUsed = 0;
+	std::mutex mutex;
+	std::condition_variable condition;
+	TimePoint start;
+	TimePoint end;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+// portable float map, the format used by the HCI benchmark for disparity maps
+struct PfmFile
+{
+	// writes a single channel map, taking every nth float of the (top-to-bottom) source rows
+	static void write(const std::string& filename, uint32_t width, uint32_t height, const float* pData, uint32_t stride = 1) {
+		std::ofstream file(filename, std::ios::binary);
+		if (!file) {
+			VMI_ERR("Could not open file for writing: " << filename);
+			return;
+		}
+
+		// negative scale marks little-endian data
+		file << "Pf\n" << width << " " << height << "\n-1.0\n";
+
+		// pfm stores rows bottom-to-top
+		std::vector<float> row(width);
+		for (uint32_t y = height; y-- > 0;) {
+			for (uint32_t x = 0; x < width; x++) {
+				row[x] = pData[((size_t)y * width + x) * stride];
+			}
+			file.write(reinterpret_cast<const char*>(row.data()), width * sizeof(float));
+		}
+	}
+	// reads the first channel of a map into top-to-bottom rows (empty on failure), both byte orders are accepted
+	static std::vector<float> read(const std::string& filename, uint32_t& width, uint32_t& height) {
+		std::ifstream file(filename, std::ios::binary);
+		if (!file) {
+			VMI_ERR("Could not open file for reading: " << filename);
+			return {};
+		}
+
+		// "Pf" is greyscale, "PF" rgb
+		std::string type;
+		float scale = 0.0f;
+		file >> type >> width >> height >> scale;
+		file.get(); // single whitespace before the data
+		uint32_t nChannels = type == "PF" ? 3 : 1;
+		if (!file || (type != "Pf" && type != "PF") || width == 0 || height == 0) {
+			VMI_ERR("Invalid pfm header: " << filename);
+			return {};
+		}
+
+		// the header is not trusted with the allocation, the data has to be in the file
+		std::streamoff dataStart = file.tellg();
+		file.seekg(0, std::ios::end);
+		uint64_t fileSize = (uint64_t)(file.tellg() - dataStart);
+		file.seekg(dataStart);
+		if ((uint64_t)width * height > fileSize / (nChannels * sizeof(float))) {
+			VMI_ERR("Truncated pfm data: " << filename);
+			return {};
+		}
+		std::vector<float> data((size_t)width * height * nChannels);
+		file.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(float));
+		if (!file) {
+			VMI_ERR("Truncated pfm data: " << filename);
+			return {};
+		}
+
+		// positive scale marks big-endian data
+		uint16_t endianTest = 1;
+		bool littleEndianHost = *reinterpret_cast<uint8_t*>(&endianTest) == 1;
+		if ((scale > 0.0f) == littleEndianHost) {
+			for (float& value : data) {
+				uint8_t* pBytes = reinterpret_cast<uint8_t*>(&value);
+				std::swap(pBytes[0], pBytes[3]);
+				std::swap(pBytes[1], pBytes[2]);
+			}
+		}
+
+		// pfm stores rows bottom-to-top
+		std::vector<float> map((size_t)width * height);
+		for (uint32_t y = 0; y < height; y++) {
+			for (uint32_t x = 0; x < width; x++) {
+				map[(size_t)y * width + x] = data[((size_t)(height - 1 - y) * width + x) * nChannels];
+			}
+		}
+		return map;
+	}
+};
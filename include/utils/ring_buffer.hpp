@@ -0,0 +1,31 @@
+#pragma once
+
+// fixed set of elements that are used in turn (e.g. one per frame in flight), get_next() moves on to the following one
+template<class T>
+class RingBuffer
+{
+public:
+	void set_size(uint32_t size) {
+		elements.resize(size);
+		iCurrent = 0;
+	}
+	inline uint32_t size() const { return (uint32_t)elements.size(); }
+	inline T& operator[](size_t i) { return elements[i]; }
+	inline T& get_current() { return elements[iCurrent]; }
+	inline uint32_t get_current_index() const { return iCurrent; }
+	inline T& get_next() {
+		iCurrent = (iCurrent + 1) % (uint32_t)elements.size();
+		return elements[iCurrent];
+	}
+	// destroys every element with the given arguments (e.g. the allocator of its buffer)
+	template<class... Args>
+	void destroy(Args&&... args) {
+		for (T& element : elements) element.destroy(args...);
+		elements.clear();
+		iCurrent = 0;
+	}
+
+private:
+	std::vector<T> elements;
+	uint32_t iCurrent = 0;
+};
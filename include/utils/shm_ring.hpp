@@ -0,0 +1,241 @@
+#pragma once
+
+// self-contained (no pch), other processes include this header to read published frames
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <chrono>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// posix shared memory ring of fixed size frames: a header, one sequence counter per slot and the slot data, each slot at an aligned offset.
+// one process writes, any number of processes map the same object read-only and read frames in place (seqlock: a slot's sequence is
+// odd while it is being overwritten, readers check it again after reading)
+struct ShmRing
+{
+	static constexpr uint32_t magic = 0x5044564c; // "LVDP"
+	static constexpr uint32_t version = 1;
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory counters have to be lock free");
+
+	struct Header
+	{
+		std::atomic<uint32_t> magic; // written last by the writer, readers fail to open until then
+		uint32_t version;
+		uint32_t nSlots;
+		uint32_t width, height;
+		uint32_t texelSize; // bytes per pixel, rows are tightly packed
+		uint64_t slotOffset; // data of slot i at slotOffset + i * slotStride
+		uint64_t slotStride;
+		std::atomic<uint32_t> closed; // the writer is gone, readers should reopen the name to follow a new writer
+		alignas(64) std::atomic<uint64_t> nPublished; // frames published so far, the newest one is in slot (nPublished - 1) % nSlots
+	};
+	struct Slot
+	{
+		alignas(64) std::atomic<uint64_t> sequence;
+		uint64_t iFrame; // publisher's frame number
+		uint64_t timestampNs; // get_time_ns() when the frame became readable
+	};
+
+	// CLOCK_MONOTONIC is shared by all processes, so readers can compute the age of a frame
+	static uint64_t get_time_ns() {
+#ifndef _WIN32
+		timespec time;
+		clock_gettime(CLOCK_MONOTONIC, &time);
+		return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+	static inline uint64_t align_up(uint64_t size, uint64_t alignment) { return (size + alignment - 1) / alignment * alignment; }
+	// shm_open names start with a single slash
+	static std::string get_object_name(const std::string& name) { return name.empty() || name[0] != '/' ? "/" + name : name; }
+	static inline Slot* get_slots(Header* pHeader) { return reinterpret_cast<Slot*>(pHeader + 1); }
+};
+
+// creates the shared memory object and publishes frames into it
+class ShmRingWriter
+{
+public:
+	// slot data is aligned (and padded) to the given alignment and at least a page, e.g. for importing it as device memory
+	bool create(const std::string& name, uint32_t width, uint32_t height, uint32_t texelSize, uint32_t nSlots, uint64_t alignment = 0) {
+#ifdef _WIN32
+		return false;
+#else
+		if (nSlots == 0 || width == 0 || height == 0 || texelSize == 0) return false;
+		objectName = ShmRing::get_object_name(name);
+		uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+		alignment = ShmRing::align_up(std::max<uint64_t>(alignment, pageSize), pageSize);
+		uint64_t slotOffset = ShmRing::align_up(sizeof(ShmRing::Header) + nSlots * sizeof(ShmRing::Slot), alignment);
+		uint64_t slotStride = ShmRing::align_up((uint64_t)width * height * texelSize, alignment);
+		size = slotOffset + nSlots * slotStride;
+
+		// a stale object of a previous writer stays mapped by its readers until they reopen
+		shm_unlink(objectName.c_str());
+		int fd = shm_open(objectName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		if (fd < 0) return false;
+		bool sized = ftruncate(fd, (off_t)size) == 0;
+		void* pMapping = sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		close(fd);
+		if (pMapping == MAP_FAILED) {
+			shm_unlink(objectName.c_str());
+			return false;
+		}
+		pBase = static_cast<uint8_t*>(pMapping);
+
+		// ftruncate zero fills, atomics are constructed in place
+		pHeader = new (pBase) ShmRing::Header();
+		pHeader->version = ShmRing::version;
+		pHeader->nSlots = nSlots;
+		pHeader->width = width;
+		pHeader->height = height;
+		pHeader->texelSize = texelSize;
+		pHeader->slotOffset = slotOffset;
+		pHeader->slotStride = slotStride;
+		for (uint32_t i = 0; i < nSlots; i++) new (ShmRing::get_slots(pHeader) + i) ShmRing::Slot();
+		pHeader->magic.store(ShmRing::magic, std::memory_order_release);
+		return true;
+#endif
+	}
+	void destroy() {
+#ifndef _WIN32
+		if (!pBase) return;
+		pHeader->closed.store(1, std::memory_order_release);
+		munmap(pBase, size);
+		shm_unlink(objectName.c_str());
+		pBase = nullptr;
+		pHeader = nullptr;
+#endif
+	}
+
+	inline uint8_t* get_slot_data(uint32_t iSlot) { return pBase + pHeader->slotOffset + iSlot * pHeader->slotStride; }
+	inline uint64_t get_slot_stride() { return pHeader->slotStride; }
+	inline uint32_t get_slot_count() { return pHeader->nSlots; }
+	// readers that are still reading the slot will see their frame as torn from here on
+	void begin_write(uint32_t iSlot) {
+		ShmRing::Slot& slot = ShmRing::get_slots(pHeader)[iSlot];
+		slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+	// the slot data is complete, it becomes the newest frame
+	void end_write(uint32_t iSlot, uint64_t iFrame) {
+		ShmRing::Slot& slot = ShmRing::get_slots(pHeader)[iSlot];
+		slot.iFrame = iFrame;
+		slot.timestampNs = ShmRing::get_time_ns();
+		slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		pHeader->nPublished.store(++nPublished, std::memory_order_release);
+	}
+
+private:
+	std::string objectName;
+	uint8_t* pBase = nullptr;
+	ShmRing::Header* pHeader = nullptr;
+	uint64_t size = 0;
+	uint64_t nPublished = 0;
+};
+
+// maps a writer's object read-only, frames are read in place without copies
+class ShmRingReader
+{
+public:
+	struct Frame
+	{
+		const uint8_t* pData; // points into the shared mapping
+		uint32_t width, height, texelSize;
+		uint64_t iFrame;
+		uint64_t timestampNs;
+		uint64_t iPublished; // position in the ring, later frames have higher ones
+		uint32_t iSlot;
+		uint64_t sequence;
+	};
+
+public:
+	bool open(const std::string& name) {
+#ifdef _WIN32
+		return false;
+#else
+		close();
+		int fd = shm_open(ShmRing::get_object_name(name).c_str(), O_RDONLY, 0);
+		if (fd < 0) return false;
+		struct stat info;
+		void* pMapping = fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(ShmRing::Header) ?
+			mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if (pMapping == MAP_FAILED) return false;
+		pBase = static_cast<const uint8_t*>(pMapping);
+		size = (uint64_t)info.st_size;
+		pHeader = reinterpret_cast<const ShmRing::Header*>(pBase);
+
+		// the header is untrusted, its slot table and every slot have to fit into the mapping (without overflowing on the way)
+		const ShmRing::Header& header = *pHeader;
+		bool valid = header.magic.load(std::memory_order_acquire) == ShmRing::magic && header.version == ShmRing::version &&
+			header.nSlots > 0 && header.slotOffset <= size &&
+			header.slotOffset >= sizeof(ShmRing::Header) + (uint64_t)header.nSlots * sizeof(ShmRing::Slot) &&
+			header.slotStride > 0 && header.nSlots <= (size - header.slotOffset) / header.slotStride &&
+			header.width > 0 && header.height > 0 && header.texelSize > 0 &&
+			(uint64_t)header.width * header.height <= header.slotStride / header.texelSize;
+		if (!valid) close();
+		return valid;
+#endif
+	}
+	void close() {
+#ifndef _WIN32
+		if (pBase) munmap(const_cast<uint8_t*>(pBase), size);
+		pBase = nullptr;
+		pHeader = nullptr;
+#endif
+	}
+
+	inline bool is_open() { return pBase != nullptr; }
+	// the writer stopped (or was replaced), open the name again to follow the next one
+	inline bool is_closed() { return !pHeader || pHeader->closed.load(std::memory_order_acquire) != 0; }
+	inline const ShmRing::Header* get_header() { return pHeader; }
+	// newest frame if it was published after iPublished (0 for any), false if there is none or the writer is just overwriting it
+	bool acquire_latest(Frame& frame, uint64_t iPublished = 0) {
+		uint64_t nPublished = pHeader->nPublished.load(std::memory_order_acquire);
+		if (nPublished == 0 || nPublished <= iPublished) return false;
+		uint32_t iSlot = (uint32_t)((nPublished - 1) % pHeader->nSlots);
+		const ShmRing::Slot& slot = ShmRing::get_slots(const_cast<ShmRing::Header*>(pHeader))[iSlot];
+		frame.sequence = slot.sequence.load(std::memory_order_acquire);
+		if (frame.sequence & 1) return false;
+		frame.pData = pBase + pHeader->slotOffset + iSlot * pHeader->slotStride;
+		frame.width = pHeader->width;
+		frame.height = pHeader->height;
+		frame.texelSize = pHeader->texelSize;
+		frame.iFrame = slot.iFrame;
+		frame.timestampNs = slot.timestampNs;
+		frame.iPublished = nPublished;
+		frame.iSlot = iSlot;
+		return is_intact(frame);
+	}
+	// call after reading a frame: false if the writer started overwriting it meanwhile, so the data read may be torn
+	bool is_intact(const Frame& frame) {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const ShmRing::Slot& slot = ShmRing::get_slots(const_cast<ShmRing::Header*>(pHeader))[frame.iSlot];
+		return slot.sequence.load(std::memory_order_relaxed) == frame.sequence;
+	}
+	// polls for a frame newer than iPublished, spinning briefly before it sleeps
+	bool wait_next(Frame& frame, uint64_t iPublished, uint32_t timeoutMs) {
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+		for (uint32_t i = 0; !is_closed(); i++) {
+			if (acquire_latest(frame, iPublished)) return true;
+			if (std::chrono::steady_clock::now() >= deadline) return false;
+			if (i < 1000) std::this_thread::yield();
+			else std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+		return false;
+	}
+
+private:
+	const uint8_t* pBase = nullptr;
+	const ShmRing::Header* pHeader = nullptr;
+	uint64_t size = 0;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+// bounded lock-free queue between exactly one producer and one consumer thread,
+// each side only ever writes its own index (kept on separate cache lines)
+template<typename T, size_t capacity>
+class SpscQueue
+{
+public:
+	// false (and the value left untouched) when the queue is full
+	bool try_push(T&& value) {
+		size_t tail = tailIndex.load(std::memory_order_relaxed);
+		size_t next = (tail + 1) % slots.size();
+		if (next == headIndex.load(std::memory_order_acquire)) return false;
+		slots[tail] = std::move(value);
+		tailIndex.store(next, std::memory_order_release);
+		return true;
+	}
+	bool try_pop(T& value) {
+		size_t head = headIndex.load(std::memory_order_relaxed);
+		if (head == tailIndex.load(std::memory_order_acquire)) return false;
+		value = std::move(slots[head]);
+		headIndex.store((head + 1) % slots.size(), std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::array<T, capacity + 1> slots; // one slot stays empty to tell a full queue from an empty one
+	alignas(64) std::atomic<size_t> headIndex{ 0 };
+	alignas(64) std::atomic<size_t> tailIndex{ 0 };
+};
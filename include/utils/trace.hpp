@@ -0,0 +1,93 @@
+#pragma once
+
+// host side scoped tracing, written as chrome trace json (chrome://tracing or ui.perfetto.dev)
+// events are collected into thread-local buffers, so recording only touches an uncontended lock
+class Trace
+{
+public:
+	struct Event
+	{
+		const char* name; // has to be a string literal
+		uint64_t start; // us since epoch
+		uint64_t duration; // us
+	};
+
+public:
+	static void enable() {
+		epoch = std::chrono::steady_clock::now();
+		enabled.store(true, std::memory_order_relaxed);
+	}
+	static inline bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+	static inline uint64_t now() {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+	}
+	static void add(const char* name, uint64_t start, uint64_t end) {
+		ThreadBuffer& buffer = get_thread_buffer();
+		std::lock_guard<std::mutex> lock(buffer.mutex);
+		buffer.events.push_back({ name, start, end - start });
+	}
+
+	// writes everything recorded so far, can be called at any time
+	static void write(const std::string& filename) {
+		std::ofstream file(filename, std::ios::trunc);
+		if (!file) {
+			VMI_ERR("Could not open trace output: " << filename);
+			return;
+		}
+
+		size_t nEvents = 0;
+		file << "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+		std::lock_guard<std::mutex> registryLock(registryMutex);
+		for (auto& pBuffer : buffers) {
+			std::lock_guard<std::mutex> lock(pBuffer->mutex);
+			for (const Event& event : pBuffer->events) {
+				file << (nEvents++ > 0 ? ",\n" : "");
+				file << "{ \"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << pBuffer->tid;
+				file << ", \"ts\": " << event.start << ", \"dur\": " << event.duration << " }";
+			}
+		}
+		file << "\n] }\n";
+		VMI_LOG("Wrote " << nEvents << " trace events to " << filename);
+	}
+
+private:
+	struct ThreadBuffer
+	{
+		uint32_t tid;
+		std::mutex mutex;
+		std::vector<Event> events;
+	};
+
+	static ThreadBuffer& get_thread_buffer() {
+		thread_local ThreadBuffer* pBuffer = register_thread();
+		return *pBuffer;
+	}
+	static ThreadBuffer* register_thread() {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		buffers.push_back(std::make_unique<ThreadBuffer>());
+		buffers.back()->tid = (uint32_t)buffers.size();
+		buffers.back()->events.reserve(1 << 14);
+		return buffers.back().get();
+	}
+
+private:
+	static inline std::atomic<bool> enabled{ false };
+	static inline std::chrono::steady_clock::time_point epoch;
+	static inline std::mutex registryMutex;
+	static inline std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+class TraceScope
+{
+public:
+	TraceScope(const char* name) : name(name), start(Trace::is_enabled() ? Trace::now() : 0) {}
+	~TraceScope() { if (Trace::is_enabled()) Trace::add(name, start, Trace::now()); }
+
+private:
+	const char* name;
+	uint64_t start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
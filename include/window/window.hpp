@@ -11,6 +11,7 @@ public:
 
 public:
 	void init(uint32_t width, uint32_t height) {
+		TRACE_SCOPE("Window::init");
 		this->width = width;
 		this->height = height;
 
@@ -35,14 +36,29 @@ public:
 		std::string imguiVer = ImGui::GetVersion();
 		VMI_LOG(spacing << "ImGui version: " << imguiVer);
 	}
+	// instance without WSI extensions, for compute-only use
+	void init_headless(uint32_t width, uint32_t height) {
+		TRACE_SCOPE("Window::init_headless");
+		this->width = width;
+		this->height = height;
+		headless = true;
+
+		VMI_LOG("[Initializing] Vulkan instance (headless)...");
+		create_vulkan_instance();
+
+		VMI_LOG("[Initializing] Instance-specific vulkan functions...");
+		VULKAN_HPP_DEFAULT_DISPATCHER.init(instance);
+	}
 	void destroy() {
-		ImGui_ImplSDL3_Shutdown();
-		ImGui::DestroyContext();
+		if (!headless) {
+			ImGui_ImplSDL3_Shutdown();
+			ImGui::DestroyContext();
 
-		instance.destroySurfaceKHR(surface);
+			instance.destroySurfaceKHR(surface);
 
-		SDL_DestroyWindow(pWindow);
-		SDL_Quit();
+			SDL_DestroyWindow(pWindow);
+			SDL_Quit();
+		}
 		
 		DEBUG_ONLY(instance.destroyDebugUtilsMessengerEXT(debugMessenger, nullptr, dld));
 		instance.destroy();
@@ -52,6 +68,9 @@ public:
 	vk::SurfaceKHR& get_vulkan_surface() { return surface; }
 	SDL_Window* get_window() { return pWindow; }
 	std::pair<uint32_t, uint32_t> get_size() { return { width, height }; }
+	// size in pixels as reported by the resize events
+	void resize(uint32_t width, uint32_t height) { this->width = width; this->height = height; }
+	bool is_headless() { return headless; }
 
 private:
 	void init_sdl_window() {
@@ -59,10 +78,11 @@ private:
 		if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) VMI_SDL_ERR();
 		pWindow = SDL_CreateWindow(WND_NAME.c_str(),
 			(int)width, (int)height, 
-			SDL_WINDOW_VULKAN);
+			SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
 		if (pWindow == NULL) VMI_SDL_ERR();
 	}
 	void create_vulkan_instance() {
+		TRACE_SCOPE("vkCreateInstance");
 		std::string spacing = "    ";
 		VMI_LOG(spacing << "Vulkan API version: " << VK_API_VERSION);
 
@@ -76,11 +96,14 @@ private:
 		}
 
 
-		// Get WSI extensions from SDL
-		uint32_t nExtensions;
-		if (!SDL_Vulkan_GetInstanceExtensions(&nExtensions, NULL)) VMI_SDL_ERR();
-		std::vector<const char*> extensions(nExtensions);
-		if (!SDL_Vulkan_GetInstanceExtensions(&nExtensions, extensions.data())) VMI_SDL_ERR();
+		// Get WSI extensions from SDL (none needed when headless)
+		std::vector<const char*> extensions;
+		if (!headless) {
+			uint32_t nExtensions;
+			if (!SDL_Vulkan_GetInstanceExtensions(&nExtensions, NULL)) VMI_SDL_ERR();
+			extensions.resize(nExtensions);
+			if (!SDL_Vulkan_GetInstanceExtensions(&nExtensions, extensions.data())) VMI_SDL_ERR();
+		}
 
 		// Debug Logging:
 		DEBUG_ONLY(vk::DebugUtilsMessengerCreateInfoEXT messengerInfo = Logging::SetupDebugMessenger(extensions));
@@ -131,6 +154,7 @@ private:
 	vk::Instance instance;
 	vk::SurfaceKHR surface;
 	uint32_t width, height;
+	bool headless = false;
 	DEBUG_ONLY(vk::DispatchLoaderDynamic dld);
 	DEBUG_ONLY(vk::DebugUtilsMessengerEXT debugMessenger);
 
@@ -0,0 +1,88 @@
+#include "renderer/pipelines/disparity_batch.hpp"
+#include "renderer/image_wrapper.hpp"
+#include "device/device_wrapper.hpp"
+#include "shaders/shaders.hpp"
+
+void DisparityBatch::init(DeviceWrapper& device, vk::PipelineCache pipelineCache, uint32_t nMaxScenes) {
+    cs = ShaderManager::create_shader_module(device, disparity_batch_cs, sizeof(disparity_batch_cs));
+    vk::PipelineShaderStageCreateInfo shaderInfo = vk::PipelineShaderStageCreateInfo()
+        .setStage(vk::ShaderStageFlagBits::eCompute)
+        .setModule(cs)
+        .setPName("main");
+
+    create_sampler(device);
+    create_descriptor_pool(device, nMaxScenes);
+    create_layout_bindings(device, nMaxScenes);
+
+    vk::ComputePipelineCreateInfo pipelineInfo = vk::ComputePipelineCreateInfo()
+        .setLayout(pipelineLayout)
+        .setStage(shaderInfo);
+
+    TRACE_SCOPE("vkCreateComputePipelines");
+    auto result = device.logicalDevice.createComputePipeline(pipelineCache, pipelineInfo);
+
+    switch (result.result)
+    {
+        case vk::Result::eSuccess: break;
+        case vk::Result::ePipelineCompileRequiredEXT:
+            VMI_LOG("Compute pipeline creation: PipelineCompileRequiredEXT");
+            break;
+        default: assert(false);
+    }
+    computePipeline = result.value;
+}
+
+void DisparityBatch::destroy(DeviceWrapper& device) {
+    device.logicalDevice.destroyShaderModule(cs);
+    device.logicalDevice.destroySampler(sampler);
+
+    // Stages
+    device.logicalDevice.destroyPipelineLayout(pipelineLayout);
+    device.logicalDevice.destroyPipeline(computePipeline);
+
+    // descriptors (the set goes with its pool)
+    device.logicalDevice.destroyDescriptorPool(descPool);
+    descSet = nullptr;
+    device.logicalDevice.destroyDescriptorSetLayout(descSetLayout);
+}
+
+void DisparityBatch::bind(DeviceWrapper& device, std::vector<ImageWrapper*>& inputImages, std::vector<DisparityCompute::PhaseOutputs>& outputImages) {
+    if (descSet) device.logicalDevice.freeDescriptorSets(descPool, descSet);
+    nScenes = (uint32_t)inputImages.size();
+
+    // arrays are partially bound, elements past the last scene of this batch stay unwritten
+    vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
+        .setDescriptorPool(descPool)
+        .setSetLayouts(descSetLayout);
+    descSet = device.logicalDevice.allocateDescriptorSets(allocInfo)[0];
+
+    // the dispatch covers the largest scene, smaller ones return early
+    extent = vk::Extent3D(0, 0, 1);
+    std::vector<vk::DescriptorImageInfo> inputInfos;
+    std::array<std::vector<vk::DescriptorImageInfo>, DisparityCompute::nPhases> outputInfos;
+    for (uint32_t i = 0; i < nScenes; i++) {
+        inputInfos.emplace_back(nullptr, inputImages[i]->get_image_view(), vk::ImageLayout::eShaderReadOnlyOptimal);
+        for (uint32_t iPhase = 0; iPhase < DisparityCompute::nPhases; iPhase++) {
+            outputInfos[iPhase].emplace_back(nullptr, outputImages[i][iPhase]->get_image_view(), vk::ImageLayout::eGeneral);
+        }
+        extent.width = std::max(extent.width, outputImages[i][0]->get_extent().width);
+        extent.height = std::max(extent.height, outputImages[i][0]->get_extent().height);
+    }
+
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.push_back(vk::WriteDescriptorSet()
+        .setDstSet(descSet)
+        .setDstBinding(0)
+        .setDstArrayElement(0)
+        .setDescriptorType(vk::DescriptorType::eSampledImage)
+        .setImageInfo(inputInfos));
+    for (uint32_t iPhase = 0; iPhase < DisparityCompute::nPhases; iPhase++) {
+        writes.push_back(vk::WriteDescriptorSet()
+            .setDstSet(descSet)
+            .setDstBinding(1 + iPhase)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eStorageImage)
+            .setImageInfo(outputInfos[iPhase]));
+    }
+    device.logicalDevice.updateDescriptorSets(writes, {});
+}
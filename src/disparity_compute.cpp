@@ -3,15 +3,80 @@
 #include "device/device_wrapper.hpp"
 #include "shaders/shaders.hpp"
 
-void DisparityCompute::init(DeviceWrapper& device, vk::DescriptorPool descPool, ImageWrapper& inputImage, ImageWrapper& outputImage) {
-    cs = ShaderManager::create_shader_module(device, disparity_cs, sizeof(disparity_cs));
+void DisparityCompute::init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool, ImageWrapper& inputImage,
+    std::vector<PhaseOutputs> outputImages, std::vector<vk::Buffer> statsBuffers, const std::string& estimatorName, const std::string& variantName) {
+    variant = find_kernel_variant(variantName);
+    if (!is_supported(device, variant)) variant = get_kernel_variants()[0];
+    cs = ShaderManager::create_shader_module(device, variant.pCode, variant.codeSize);
+    statsCs = ShaderManager::create_shader_module(device, disparity_stats_cs, sizeof(disparity_stats_cs));
+
+    extent = outputImages[0][0]->get_extent();
+    create_sampler(device);
+    create_layout_bindings(device, descPool, inputImage, outputImages, statsBuffers);
+
+    TRACE_SCOPE("vkCreateComputePipelines");
+    computePipeline = create_pipeline(device, pipelineCache, cs);
+    statsPipeline = create_pipeline(device, pipelineCache, statsCs);
+
+    estimator = EstimatorRegistry::create(estimatorName);
+    if (!estimator) estimator = EstimatorRegistry::create("gradient");
+    estimator->set_kernel_variant(variant);
+    estimator->init(device, allocator, pipelineCache, descPool, descSetLayout, extent, (uint32_t)descSets.size());
+}
+
+void DisparityCompute::set_estimator(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, const std::string& name) {
+    std::unique_ptr<DisparityEstimator> next = EstimatorRegistry::create(name);
+    if (!next) return;
+    estimator->destroy(device, allocator);
+    estimator = std::move(next);
+    estimator->set_kernel_variant(variant);
+    estimator->init(device, allocator, pipelineCache, descSetPool, descSetLayout, extent, (uint32_t)descSets.size());
+}
+
+void DisparityCompute::set_kernel_variant(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, const std::string& name) {
+    const KernelVariant& next = find_kernel_variant(name);
+    if (!is_supported(device, next)) {
+        VMI_WARN("Kernel variant " << next.name << " exceeds the limits of the device");
+        return;
+    }
+    variant = next;
+    device.logicalDevice.destroyPipeline(computePipeline);
+    device.logicalDevice.destroyShaderModule(cs);
+    cs = ShaderManager::create_shader_module(device, variant.pCode, variant.codeSize);
+    computePipeline = create_pipeline(device, pipelineCache, cs);
+
+    // the estimator may run phases of the same variant
+    estimator->destroy(device, allocator);
+    estimator->set_kernel_variant(variant);
+    estimator->init(device, allocator, pipelineCache, descSetPool, descSetLayout, extent, (uint32_t)descSets.size());
+}
+
+const std::vector<KernelVariant>& DisparityCompute::get_kernel_variants() {
+    static const std::vector<KernelVariant> variants = {
+        { "16x16", disparity_cs, sizeof(disparity_cs), { 16, 16 } },
+        { "8x8", disparity_8x8_cs, sizeof(disparity_8x8_cs), { 8, 8 } },
+        { "16x8", disparity_16x8_cs, sizeof(disparity_16x8_cs), { 16, 8 } },
+        { "32x8", disparity_32x8_cs, sizeof(disparity_32x8_cs), { 32, 8 } },
+        { "64x4", disparity_64x4_cs, sizeof(disparity_64x4_cs), { 64, 4 } },
+        { "32x16", disparity_32x16_cs, sizeof(disparity_32x16_cs), { 32, 16 } }
+    };
+    return variants;
+}
+
+const KernelVariant& DisparityCompute::find_kernel_variant(const std::string& name) {
+    for (const KernelVariant& variant : get_kernel_variants()) {
+        if (variant.name == name) return variant;
+    }
+    if (!name.empty()) VMI_WARN("Unknown kernel variant, using the default: " << name);
+    return get_kernel_variants()[0];
+}
+
+vk::Pipeline DisparityCompute::create_pipeline(DeviceWrapper& device, vk::PipelineCache pipelineCache, vk::ShaderModule shader) {
     vk::PipelineShaderStageCreateInfo shaderInfo = vk::PipelineShaderStageCreateInfo()
         .setStage(vk::ShaderStageFlagBits::eCompute)
-        .setModule(cs)
+        .setModule(shader)
         .setPName("main");
 
-    create_layout_bindings(device, descPool, inputImage, outputImage);
-
     vk::ComputePipelineCreateInfo pipelineInfo = vk::ComputePipelineCreateInfo()
         .setLayout(pipelineLayout)
         .setStage(shaderInfo);
@@ -26,16 +91,82 @@ void DisparityCompute::init(DeviceWrapper& device, vk::DescriptorPool descPool,
             break;
         default: assert(false);
     }
-    computePipeline = result.value;
+    return result.value;
 }
 
-void DisparityCompute::destroy(DeviceWrapper& device) {
+void DisparityCompute::destroy(DeviceWrapper& device, vma::Allocator allocator) {
+    estimator->destroy(device, allocator);
+    estimator.reset();
     device.logicalDevice.destroyShaderModule(cs);
+    device.logicalDevice.destroyShaderModule(statsCs);
+    device.logicalDevice.destroySampler(sampler);
     
     // Stages
     device.logicalDevice.destroyPipelineLayout(pipelineLayout);
     device.logicalDevice.destroyPipeline(computePipeline);
+    device.logicalDevice.destroyPipeline(statsPipeline);
 
     // descriptors
     device.logicalDevice.destroyDescriptorSetLayout(descSetLayout);
-}
\ No newline at end of file
+}
+
+void DisparityCompute::record(vk::CommandBuffer commandBuffer, PhaseOutputs outputs, PushConstants pcs, uint32_t iFirstPhase, uint32_t iOutput,
+    GpuProfiler* pProfiler, uint32_t iSlot) {
+    // estimators keep intermediates of their own (set 1) that phase 0 overwrites, after the reads of earlier submissions on this queue
+    vk::MemoryBarrier estimatorBarrier = vk::MemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, estimatorBarrier, {}, {});
+    // a partial run reads the outputs of the phases before iFirstPhase, written by an earlier submission
+    if (iFirstPhase > 0) {
+        vk::MemoryBarrier inputBarrier = vk::MemoryBarrier()
+            .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, inputBarrier, {}, {});
+    }
+
+    // every phase that runs fully overwrites its output, so previous contents are discarded
+    // (this also avoids an ownership transfer of the final output back from the graphics queue).
+    // the outputs of phases 0 and 3 alias each other (see ComputeFrame::place_images), so theirs are discarded right before
+    // the phase, after every access through the other image (phase 3 overwrites what phase 1 just read)
+    auto discard = [&](uint32_t iPhase) {
+        outputs[iPhase]->barrier(commandBuffer, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+            vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite);
+    };
+    auto is_transient = [](uint32_t iPhase) { return iPhase == 0 || iPhase == 3; };
+    for (uint32_t iPhase = iFirstPhase; iPhase < nPhases; iPhase++) {
+        if (!is_transient(iPhase)) discard(iPhase);
+    }
+
+    // stats passes accumulate with atomics, so each of them waits for all earlier reads and writes
+    // (the resolve before phase 2 may read a histogram of a previous submission)
+    vk::MemoryBarrier statsBarrier = vk::MemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    auto record_stats = [&](std::initializer_list<StatsPass> passes) {
+        for (StatsPass pass : passes) {
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, statsBarrier, {}, {});
+            execute_stats(commandBuffer, pcs, iOutput, pass);
+        }
+    };
+
+    vk::MemoryBarrier memoryBarrier = vk::MemoryBarrier().setSrcAccessMask(vk::AccessFlagBits::eShaderWrite).setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    for (uint32_t iPhase = iFirstPhase; iPhase < nPhases; iPhase++) {
+        if (iPhase > iFirstPhase) {
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+        }
+        if (is_transient(iPhase)) discard(iPhase);
+        pcs.iPhase = iPhase;
+        if (pProfiler) pProfiler->begin(commandBuffer, iSlot, iPhase);
+        if (iPhase == 2) {
+            record_stats({ fixedThreshold ? eFixedConfidence : eResolveConfidence });
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+        }
+        if (iPhase < 2) estimator->record_phase(commandBuffer, descSets[iOutput], pcs, iPhase, iOutput);
+        else execute(commandBuffer, pcs, iOutput);
+        if (iPhase == 1) record_stats({ eClearConfidence, eAccumulateConfidence });
+        if (iPhase == nPhases - 1) record_stats({ eClearDisparity, eDisparityRange, eDisparityHistogram, eResolveDisparity });
+        if (pProfiler) pProfiler->end(commandBuffer, iSlot, iPhase);
+    }
+}
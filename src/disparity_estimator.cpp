@@ -0,0 +1,15 @@
+#include "renderer/pipelines/disparity_estimator.hpp"
+#include "renderer/pipelines/gradient_estimator.hpp"
+#include "renderer/pipelines/epi_estimator.hpp"
+#include "renderer/pipelines/sweep_estimator.hpp"
+#include "renderer/pipelines/sparse_estimator.hpp"
+
+std::vector<std::pair<std::string, EstimatorRegistry::Factory>>& EstimatorRegistry::get_entries() {
+    static std::vector<std::pair<std::string, Factory>> entries = {
+        { "gradient", []() { return std::make_unique<GradientEstimator>(); } },
+        { "epi", []() { return std::make_unique<EpiEstimator>(); } },
+        { "sweep", []() { return std::make_unique<SweepEstimator>(); } },
+        { "sparse", []() { return std::make_unique<SparseEstimator>(); } }
+    };
+    return entries;
+}
@@ -0,0 +1,144 @@
+#include "renderer/pipelines/disparity_metrics.hpp"
+#include "renderer/image_wrapper.hpp"
+#include "device/device_wrapper.hpp"
+#include "shaders/shaders.hpp"
+
+void DisparityMetrics::init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+    std::vector<ImageWrapper*> disparityImages, ImageWrapper& groundTruthImage) {
+    cs = ShaderManager::create_shader_module(device, disparity_metrics_cs, sizeof(disparity_metrics_cs));
+    vk::PipelineShaderStageCreateInfo shaderInfo = vk::PipelineShaderStageCreateInfo()
+        .setStage(vk::ShaderStageFlagBits::eCompute)
+        .setModule(cs)
+        .setPName("main");
+
+    extent = disparityImages[0]->get_extent();
+    nGroupsX = (extent.width + groupSize - 1) / groupSize;
+    nGroupsY = (extent.height + groupSize - 1) / groupSize;
+    create_buffers(allocator);
+    create_layout_bindings(device, descPool, disparityImages, groundTruthImage);
+
+    vk::ComputePipelineCreateInfo pipelineInfo = vk::ComputePipelineCreateInfo()
+        .setLayout(pipelineLayout)
+        .setStage(shaderInfo);
+
+    TRACE_SCOPE("vkCreateComputePipelines");
+    auto result = device.logicalDevice.createComputePipeline(pipelineCache, pipelineInfo);
+
+    switch (result.result)
+    {
+        case vk::Result::eSuccess: break;
+        case vk::Result::ePipelineCompileRequiredEXT:
+            VMI_LOG("Compute pipeline creation: PipelineCompileRequiredEXT");
+            break;
+        default: assert(false);
+    }
+    computePipeline = result.value;
+}
+
+void DisparityMetrics::destroy(DeviceWrapper& device, vma::Allocator allocator) {
+    device.logicalDevice.destroyShaderModule(cs);
+    allocator.destroyBuffer(partialsBuffer.first, partialsBuffer.second);
+    allocator.destroyBuffer(metricsBuffer.first, metricsBuffer.second);
+
+    // Stages
+    device.logicalDevice.destroyPipelineLayout(pipelineLayout);
+    device.logicalDevice.destroyPipeline(computePipeline);
+
+    // descriptors
+    device.logicalDevice.destroyDescriptorSetLayout(descSetLayout);
+}
+
+void DisparityMetrics::record(vk::CommandBuffer commandBuffer, uint32_t iInput) {
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descSets[iInput], {});
+
+    // earlier evaluations may still read the partials or the metrics
+    vk::MemoryBarrier memoryBarrier = vk::MemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+
+    // pass 0 reduces each tile into its partial, pass 1 resolves all partials in a single group
+    PushConstants pcs;
+    pcs.iPhase = 0;
+    commandBuffer.pushConstants<PushConstants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pcs);
+    commandBuffer.dispatch(nGroupsX, nGroupsY, 1);
+
+    memoryBarrier = vk::MemoryBarrier().setSrcAccessMask(vk::AccessFlagBits::eShaderWrite).setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+    pcs.iPhase = 1;
+    commandBuffer.pushConstants<PushConstants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pcs);
+    commandBuffer.dispatch(1, 1, 1);
+
+    // make the metrics visible to the host
+    memoryBarrier = vk::MemoryBarrier().setSrcAccessMask(vk::AccessFlagBits::eShaderWrite).setDstAccessMask(vk::AccessFlagBits::eHostRead);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost, {}, memoryBarrier, {}, {});
+}
+
+void DisparityMetrics::create_buffers(vma::Allocator allocator) {
+    vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+        .setSize((vk::DeviceSize)nGroupsX * nGroupsY * sizeof(Partial))
+        .setUsage(vk::BufferUsageFlagBits::eStorageBuffer);
+    vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+        .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+    partialsBuffer = allocator.createBuffer(bufferInfo, allocCreateInfo);
+
+    bufferInfo.setSize(sizeof(Metrics));
+    allocCreateInfo = vma::AllocationCreateInfo()
+        .setUsage(vma::MemoryUsage::eAuto)
+        .setFlags(vma::AllocationCreateFlagBits::eHostAccessRandom | vma::AllocationCreateFlagBits::eMapped);
+    metricsBuffer = allocator.createBuffer(bufferInfo, allocCreateInfo, metricsInfo);
+}
+
+void DisparityMetrics::create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool, std::vector<ImageWrapper*>& disparityImages, ImageWrapper& groundTruthImage) {
+    // set binding layouts (disparity and ground truth, followed by the partials and the metrics)
+    std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i] = vk::DescriptorSetLayoutBinding()
+            .setBinding(i)
+            .setDescriptorCount(1)
+            .setDescriptorType(i < 2 ? vk::DescriptorType::eSampledImage : vk::DescriptorType::eStorageBuffer)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+    vk::DescriptorSetLayoutCreateInfo createInfo = vk::DescriptorSetLayoutCreateInfo()
+        .setBindings(bindings);
+    descSetLayout = device.logicalDevice.createDescriptorSetLayout(createInfo);
+
+    // allocate the descriptor sets using descriptor pool
+    std::vector<vk::DescriptorSetLayout> layouts(disparityImages.size(), descSetLayout);
+    vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
+        .setDescriptorPool(descPool)
+        .setSetLayouts(layouts);
+    descSets = device.logicalDevice.allocateDescriptorSets(allocInfo);
+
+    for (size_t i = 0; i < disparityImages.size(); i++) {
+        std::array<vk::DescriptorImageInfo, 2> imageInfos = {
+            vk::DescriptorImageInfo(nullptr, disparityImages[i]->get_image_view(), vk::ImageLayout::eShaderReadOnlyOptimal),
+            vk::DescriptorImageInfo(nullptr, groundTruthImage.get_image_view(), vk::ImageLayout::eShaderReadOnlyOptimal)
+        };
+        std::array<vk::DescriptorBufferInfo, 2> bufferInfos = {
+            vk::DescriptorBufferInfo(partialsBuffer.first, 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(metricsBuffer.first, 0, VK_WHOLE_SIZE)
+        };
+        std::array<vk::WriteDescriptorSet, 4> descWrites;
+        for (uint32_t j = 0; j < descWrites.size(); j++) {
+            descWrites[j] = vk::WriteDescriptorSet()
+                .setDstSet(descSets[i])
+                .setDstBinding(j)
+                .setDstArrayElement(0)
+                .setDescriptorType(bindings[j].descriptorType);
+            if (j < 2) descWrites[j].setImageInfo(imageInfos[j]);
+            else descWrites[j].setBufferInfo(bufferInfos[j - 2]);
+        }
+        device.logicalDevice.updateDescriptorSets(descWrites, {});
+    }
+
+    // push constants
+    vk::PushConstantRange pushConstantRange = PushConstants::get_range();
+
+    // create pipeline layout
+    vk::PipelineLayoutCreateInfo layoutInfo = vk::PipelineLayoutCreateInfo()
+        .setPushConstantRanges(pushConstantRange)
+        .setSetLayouts(descSetLayout);
+    pipelineLayout = device.logicalDevice.createPipelineLayout(layoutInfo);
+}
@@ -0,0 +1,187 @@
+#include "renderer/pipelines/disparity_query.hpp"
+#include "renderer/image_wrapper.hpp"
+#include "device/device_wrapper.hpp"
+#include "shaders/shaders.hpp"
+
+void DisparityQuery::init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool) {
+    cs = ShaderManager::create_shader_module(device, disparity_query_cs, sizeof(disparity_query_cs));
+    vk::PipelineShaderStageCreateInfo shaderInfo = vk::PipelineShaderStageCreateInfo()
+        .setStage(vk::ShaderStageFlagBits::eCompute)
+        .setModule(cs)
+        .setPName("main");
+
+    maxGroupsX = device.deviceProperties.limits.maxComputeWorkGroupCount[0];
+    // same sampling as the disparity phases (see DisparityCompute::create_sampler)
+    vk::SamplerCreateInfo samplerInfo = vk::SamplerCreateInfo()
+        .setMagFilter(vk::Filter::eLinear)
+        .setMinFilter(vk::Filter::eLinear)
+        .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+        .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+        .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+        .setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+    sampler = device.logicalDevice.createSampler(samplerInfo);
+    create_buffers(allocator);
+    create_layout_bindings(device, descPool);
+
+    vk::ComputePipelineCreateInfo pipelineInfo = vk::ComputePipelineCreateInfo()
+        .setLayout(pipelineLayout)
+        .setStage(shaderInfo);
+
+    TRACE_SCOPE("vkCreateComputePipelines");
+    auto result = device.logicalDevice.createComputePipeline(pipelineCache, pipelineInfo);
+
+    switch (result.result)
+    {
+        case vk::Result::eSuccess: break;
+        case vk::Result::ePipelineCompileRequiredEXT:
+            VMI_LOG("Compute pipeline creation: PipelineCompileRequiredEXT");
+            break;
+        default: assert(false);
+    }
+    computePipeline = result.value;
+}
+
+void DisparityQuery::destroy(DeviceWrapper& device, vma::Allocator allocator) {
+    device.logicalDevice.destroyShaderModule(cs);
+    device.logicalDevice.destroySampler(sampler);
+    allocator.destroyBuffer(jobsBuffer.first, jobsBuffer.second);
+    allocator.destroyBuffer(resultsBuffer.first, resultsBuffer.second);
+
+    // Stages
+    device.logicalDevice.destroyPipelineLayout(pipelineLayout);
+    device.logicalDevice.destroyPipeline(computePipeline);
+
+    // descriptors
+    device.logicalDevice.freeDescriptorSets(descSetPool, descSet);
+    device.logicalDevice.destroyDescriptorSetLayout(descSetLayout);
+}
+
+void DisparityQuery::bind(DeviceWrapper& device, ImageWrapper& lightField) {
+    vk::DescriptorImageInfo imageInfo = vk::DescriptorImageInfo(nullptr, lightField.get_image_view(), vk::ImageLayout::eShaderReadOnlyOptimal);
+    vk::WriteDescriptorSet descImageWrite = vk::WriteDescriptorSet()
+        .setDstSet(descSet)
+        .setDstBinding(0)
+        .setDstArrayElement(0)
+        .setDescriptorType(vk::DescriptorType::eSampledImage)
+        .setImageInfo(imageInfo);
+    device.logicalDevice.updateDescriptorSets(descImageWrite, {});
+}
+
+bool DisparityQuery::record(vk::CommandBuffer commandBuffer, vma::Allocator allocator, const std::vector<vk::Offset2D>& points, const std::vector<vk::Rect2D>& rects) {
+    uint64_t nQueried = points.size();
+    for (const vk::Rect2D& rect : rects) nQueried += (uint64_t)rect.extent.width * rect.extent.height;
+    if (nQueried > maxResults) {
+        VMI_ERR("Disparity query of " << nQueried << " texels exceeds " << maxResults);
+        return false;
+    }
+
+    // one job per point, then one per tile of each rectangle (every job has at least one result, so they fit as well)
+    Job* pJobs = reinterpret_cast<Job*>(jobsInfo.pMappedData);
+    uint32_t nJobs = 0;
+    nResults = 0;
+    for (const vk::Offset2D& point : points) {
+        pJobs[nJobs++] = { point.x, point.y, 1, 1, nResults++, 1 };
+    }
+    uint32_t nPoints = nJobs;
+    for (const vk::Rect2D& rect : rects) {
+        for (uint32_t y = 0; y < rect.extent.height; y += tileSize) {
+            for (uint32_t x = 0; x < rect.extent.width; x += tileSize) {
+                pJobs[nJobs++] = { rect.offset.x + (int32_t)x, rect.offset.y + (int32_t)y,
+                    std::min(tileSize, rect.extent.width - x), std::min(tileSize, rect.extent.height - y),
+                    nResults + y * rect.extent.width + x, rect.extent.width };
+            }
+        }
+        nResults += rect.extent.width * rect.extent.height;
+    }
+    allocator.flushAllocation(jobsBuffer.second, 0, nJobs * sizeof(Job));
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, descSet, {});
+    // earlier queries recorded into the same command buffer write the same results
+    vk::MemoryBarrier memoryBarrier = vk::MemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+    dispatch_jobs(commandBuffer, 0, 0, nPoints, tileSize * tileSize);
+    dispatch_jobs(commandBuffer, 1, nPoints, nJobs - nPoints, 1);
+
+    // make the results visible to the host
+    memoryBarrier = vk::MemoryBarrier().setSrcAccessMask(vk::AccessFlagBits::eShaderWrite).setDstAccessMask(vk::AccessFlagBits::eHostRead);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eHost, {}, memoryBarrier, {}, {});
+    return true;
+}
+
+void DisparityQuery::dispatch_jobs(vk::CommandBuffer commandBuffer, uint32_t iPass, uint32_t iFirstJob, uint32_t nJobs, uint32_t jobsPerGroup) {
+    // split where a single dispatch would exceed the group count limit
+    uint32_t maxJobs = (uint32_t)std::min<uint64_t>((uint64_t)maxGroupsX * jobsPerGroup, UINT32_MAX);
+    for (uint32_t iJob = 0; iJob < nJobs; iJob += maxJobs) {
+        Constants constants = { iPass, iFirstJob + iJob, std::min(maxJobs, nJobs - iJob), 0 };
+        commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, constants);
+        commandBuffer.dispatch((constants.nJobs + jobsPerGroup - 1) / jobsPerGroup, 1, 1);
+    }
+}
+
+void DisparityQuery::create_buffers(vma::Allocator allocator) {
+    vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+        .setSize(maxResults * sizeof(Job))
+        .setUsage(vk::BufferUsageFlagBits::eStorageBuffer);
+    vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+        .setUsage(vma::MemoryUsage::eAuto)
+        .setFlags(vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped);
+    jobsBuffer = allocator.createBuffer(bufferInfo, allocCreateInfo, jobsInfo);
+
+    bufferInfo.setSize(maxResults * sizeof(Result));
+    allocCreateInfo.setFlags(vma::AllocationCreateFlagBits::eHostAccessRandom | vma::AllocationCreateFlagBits::eMapped);
+    resultsBuffer = allocator.createBuffer(bufferInfo, allocCreateInfo, resultsInfo);
+}
+
+void DisparityQuery::create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool) {
+    // set binding layouts (light field, its sampler, followed by the jobs and the results)
+    std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+    std::array<vk::DescriptorType, 4> types = { vk::DescriptorType::eSampledImage, vk::DescriptorType::eSampler,
+        vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eStorageBuffer };
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i] = vk::DescriptorSetLayoutBinding()
+            .setBinding(i)
+            .setDescriptorCount(1)
+            .setDescriptorType(types[i])
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+    bindings[1].setImmutableSamplers(sampler);
+    vk::DescriptorSetLayoutCreateInfo createInfo = vk::DescriptorSetLayoutCreateInfo()
+        .setBindings(bindings);
+    descSetLayout = device.logicalDevice.createDescriptorSetLayout(createInfo);
+
+    vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
+        .setDescriptorPool(descPool)
+        .setSetLayouts(descSetLayout);
+    descSet = device.logicalDevice.allocateDescriptorSets(allocInfo)[0];
+    descSetPool = descPool;
+
+    // the light field is written by bind
+    std::array<vk::DescriptorBufferInfo, 2> bufferInfos = {
+        vk::DescriptorBufferInfo(jobsBuffer.first, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(resultsBuffer.first, 0, VK_WHOLE_SIZE)
+    };
+    for (uint32_t i = 0; i < bufferInfos.size(); i++) {
+        vk::WriteDescriptorSet descBufferWrites = vk::WriteDescriptorSet()
+            .setDstSet(descSet)
+            .setDstBinding(2 + i)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setBufferInfo(bufferInfos[i]);
+        device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+    }
+
+    // push constants
+    vk::PushConstantRange pushConstantRange = vk::PushConstantRange()
+        .setSize(sizeof(Constants))
+        .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+        .setOffset(0);
+
+    // create pipeline layout
+    vk::PipelineLayoutCreateInfo layoutInfo = vk::PipelineLayoutCreateInfo()
+        .setPushConstantRanges(pushConstantRange)
+        .setSetLayouts(descSetLayout);
+    pipelineLayout = device.logicalDevice.createPipelineLayout(layoutInfo);
+}
@@ -0,0 +1,82 @@
+#include "renderer/pipelines/epi_estimator.hpp"
+#include "device/device_wrapper.hpp"
+#include "shaders/shaders.hpp"
+
+void EpiEstimator::init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+    vk::DescriptorSetLayout sharedLayout, vk::Extent3D extent, uint32_t nOutputs) {
+    this->extent = extent;
+    cs = ShaderManager::create_shader_module(device, epi_estimator_cs, sizeof(epi_estimator_cs));
+    create_buffers(allocator, nOutputs);
+    create_layout_bindings(device, descPool, nOutputs);
+    pipelineLayout = create_pipeline_layout(device, { sharedLayout, descSetLayout });
+    computePipeline = create_pipeline(device, pipelineCache, pipelineLayout, cs);
+}
+
+void EpiEstimator::destroy(DeviceWrapper& device, vma::Allocator allocator) {
+    device.logicalDevice.destroyShaderModule(cs);
+    for (auto& buffer : horizontalEpis) allocator.destroyBuffer(buffer.first, buffer.second);
+    for (auto& buffer : verticalEpis) allocator.destroyBuffer(buffer.first, buffer.second);
+    horizontalEpis.clear();
+    verticalEpis.clear();
+
+    // Stages
+    device.logicalDevice.destroyPipelineLayout(pipelineLayout);
+    device.logicalDevice.destroyPipeline(computePipeline);
+
+    // descriptors
+    if (!descSets.empty()) device.logicalDevice.freeDescriptorSets(descSetPool, descSets);
+    descSets.clear();
+    device.logicalDevice.destroyDescriptorSetLayout(descSetLayout);
+}
+
+void EpiEstimator::create_buffers(vma::Allocator allocator, uint32_t nOutputs) {
+    // every EPI holds all views along one direction for a row or a column of the outputs
+    vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+        .setSize((vk::DeviceSize)extent.width * extent.height * nViews * sizeof(float))
+        .setUsage(vk::BufferUsageFlagBits::eStorageBuffer);
+    vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+        .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+    for (uint32_t i = 0; i < nOutputs; i++) {
+        horizontalEpis.push_back(allocator.createBuffer(bufferInfo, allocCreateInfo));
+        verticalEpis.push_back(allocator.createBuffer(bufferInfo, allocCreateInfo));
+    }
+}
+
+void EpiEstimator::create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool, uint32_t nOutputs) {
+    // set 1: horizontal and vertical EPIs
+    std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i] = vk::DescriptorSetLayoutBinding()
+            .setBinding(i)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+    vk::DescriptorSetLayoutCreateInfo createInfo = vk::DescriptorSetLayoutCreateInfo()
+        .setBindings(bindings);
+    descSetLayout = device.logicalDevice.createDescriptorSetLayout(createInfo);
+
+    // allocate the descriptor sets using descriptor pool
+    std::vector<vk::DescriptorSetLayout> layouts(nOutputs, descSetLayout);
+    vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
+        .setDescriptorPool(descPool)
+        .setSetLayouts(layouts);
+    descSets = device.logicalDevice.allocateDescriptorSets(allocInfo);
+    descSetPool = descPool;
+
+    for (uint32_t i = 0; i < nOutputs; i++) {
+        std::array<vk::DescriptorBufferInfo, 2> bufferInfos = {
+            vk::DescriptorBufferInfo(horizontalEpis[i].first, 0, VK_WHOLE_SIZE),
+            vk::DescriptorBufferInfo(verticalEpis[i].first, 0, VK_WHOLE_SIZE)
+        };
+        for (uint32_t j = 0; j < bufferInfos.size(); j++) {
+            vk::WriteDescriptorSet descBufferWrites = vk::WriteDescriptorSet()
+                .setDstSet(descSets[i])
+                .setDstBinding(j)
+                .setDstArrayElement(0)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setBufferInfo(bufferInfos[j]);
+            device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+        }
+    }
+}
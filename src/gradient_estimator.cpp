@@ -0,0 +1,17 @@
+#include "renderer/pipelines/gradient_estimator.hpp"
+#include "device/device_wrapper.hpp"
+#include "shaders/shaders.hpp"
+
+void GradientEstimator::init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+    vk::DescriptorSetLayout sharedLayout, vk::Extent3D extent, uint32_t nOutputs) {
+    this->extent = extent;
+    cs = ShaderManager::create_shader_module(device, kernelVariant.pCode, kernelVariant.codeSize);
+    pipelineLayout = create_pipeline_layout(device, { sharedLayout });
+    computePipeline = create_pipeline(device, pipelineCache, pipelineLayout, cs);
+}
+
+void GradientEstimator::destroy(DeviceWrapper& device, vma::Allocator allocator) {
+    device.logicalDevice.destroyShaderModule(cs);
+    device.logicalDevice.destroyPipelineLayout(pipelineLayout);
+    device.logicalDevice.destroyPipeline(computePipeline);
+}
@@ -4,6 +4,6 @@
 int main(int argc, char *argv[])
 {
     DEBUG_ONLY(VMI_LOG("Running in Debug mode."));
-    Application app;
+    Application app(Arguments::parse(argc, argv));
     app.run();
 }
\ No newline at end of file
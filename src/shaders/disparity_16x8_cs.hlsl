@@ -0,0 +1,4 @@
+// 16x8 groups variant of disparity_cs, the filter passes run 128 threads per segment
+#define GROUP_NX 16
+#define GROUP_NY 8
+#include "disparity_cs.hlsl"
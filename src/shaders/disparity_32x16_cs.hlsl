@@ -0,0 +1,4 @@
+// 32x16 groups variant of disparity_cs, the filter passes run 512 threads per segment
+#define GROUP_NX 32
+#define GROUP_NY 16
+#include "disparity_cs.hlsl"
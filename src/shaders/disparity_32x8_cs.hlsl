@@ -0,0 +1,4 @@
+// 32x8 groups variant of disparity_cs, the filter passes run 256 threads per segment
+#define GROUP_NX 32
+#define GROUP_NY 8
+#include "disparity_cs.hlsl"
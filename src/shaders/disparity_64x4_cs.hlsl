@@ -0,0 +1,4 @@
+// 64x4 groups variant of disparity_cs, the filter passes run 256 threads per segment
+#define GROUP_NX 64
+#define GROUP_NY 4
+#include "disparity_cs.hlsl"
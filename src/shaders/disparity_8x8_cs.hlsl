@@ -0,0 +1,4 @@
+// 8x8 groups variant of disparity_cs, the filter passes run 64 threads per segment
+#define GROUP_NX 8
+#define GROUP_NY 8
+#include "disparity_cs.hlsl"
@@ -0,0 +1,45 @@
+// bindless variant of disparity_cs, a batch of scenes is bound as arrays and the scene index is taken from z
+[[vk::binding(0)]] Texture3D<float4> lightFields[];
+[[vk::binding(1)]] RWTexture2D<float4> gradientTexs[]; // Lx, Ly, Lu, Lv
+[[vk::binding(2)]] RWTexture2D<float4> estimateTexs[]; // disparity edges, confidence, raw disparity, uncertain marker
+[[vk::binding(3)]] RWTexture2D<float4> cutoffTexs[]; // disparity edges, confidence, uncertain flag, raw disparity
+[[vk::binding(4)]] RWTexture2D<float4> filterTexs[]; // horizontally filtered disparity, mean weight, unused, unused
+[[vk::binding(5)]] RWTexture2D<float4> disparityTexs[]; // disparity edges, confidence, uncertain flag, filtered disparity
+[[vk::binding(6)]] SamplerState lightFieldSampler;
+
+// push constant for runtime control
+struct PCS { uint iPhase; uint nSteps; uint filterRadius; float filterEdges; };
+[[vk::push_constant]] PCS pcs;
+
+// workgroups never span multiple scenes, so the index is uniform within each of them
+static uint iScene;
+#define LIGHT_FIELD lightFields[iScene]
+#define GRADIENT_TEX gradientTexs[iScene]
+#define ESTIMATE_TEX estimateTexs[iScene]
+#define CUTOFF_TEX cutoffTexs[iScene]
+#define FILTER_TEX filterTexs[iScene]
+#define DISPARITY_TEX disparityTexs[iScene]
+// scenes are not reduced individually, so the cutoff stays a fixed confidence per step (documented for --batch and the daemon)
+#include "disparity_stats.hlsli"
+#define CONFIDENCE_THRESHOLD (STATS_FIXED_THRESHOLD_PER_STEP * (float)pcs.nSteps)
+#include "disparity_phases.hlsli"
+
+[numthreads(GROUP_NX, GROUP_NY, 1)]
+void main(int3 threadIdx : SV_DispatchThreadID, int3 groupIdx : SV_GroupID, uint iLocal : SV_GroupIndex)
+{
+    iScene = groupIdx.z;
+    if (pcs.iPhase == 3) { phase_3(groupIdx.xy, iLocal); return; }
+    if (pcs.iPhase == 4) { phase_4(groupIdx.xy, iLocal); return; }
+
+    // scenes may differ in size, the dispatch covers the largest one
+    uint2 outputSize;
+    DISPARITY_TEX.GetDimensions(outputSize.x, outputSize.y);
+    if (any(threadIdx.xy >= (int2)outputSize)) return;
+
+    int3 pixelIdx = int3(threadIdx.xy, 0);
+    switch (pcs.iPhase) {
+        case 0: phase_0(pixelIdx); break;
+        case 1: phase_1(pixelIdx); break;
+        case 2: phase_2(pixelIdx); break;
+    }
+}
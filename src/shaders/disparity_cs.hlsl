@@ -1,115 +1,45 @@
 Texture3D<float4> lightField : register(t0);
-RWTexture2D<float4> disparityTex : register(u1);
+// one output per phase, kept between frames so that only stale phases need to run again
+RWTexture2D<float4> gradientTex : register(u1); // Lx, Ly, Lu, Lv
+RWTexture2D<float4> estimateTex : register(u2); // disparity edges, confidence, raw disparity, uncertain marker
+RWTexture2D<float4> cutoffTex : register(u3); // disparity edges, confidence, uncertain flag, raw disparity
+RWTexture2D<float4> filterTex : register(u4); // horizontally filtered disparity, mean weight, unused, unused
+RWTexture2D<float4> disparityTex : register(u5); // disparity edges, confidence, uncertain flag, filtered disparity
+// outputs may be smaller than the light field (preview), which is then resampled
+SamplerState lightFieldSampler : register(s6);
+// reduced by disparity_stats_cs between the phases
+#include "disparity_stats.hlsli"
+RWStructuredBuffer<DisparityStats> stats : register(u7);
 
 // push constant for runtime control
-struct PCS { uint iPhase; uint nSteps; };
+struct PCS { uint iPhase; uint nSteps; uint filterRadius; float filterEdges; };
 [[vk::push_constant]] PCS pcs;
 
-#define BRIGHTNESS_GREY(col) dot(col, float3(0.333333f, 0.333333f, 0.333333f)); // using standard greyscale
-#define BRIGHTNESS_REAL(col) dot(col, float3(0.299f, 0.587f, 0.114f)); // using luminance construction
-// compute group patch size
-#define GROUP_NX 16
-#define GROUP_NY 16
-// camera patch size
-#define CAMERA_NU 3
-#define CAMERA_NV 3
-// pixel patch size
-#define PATCH_NX 3
-#define PATCH_NY 3
-
-float4 get_gradients(int3 threadIdx) {
-    // cam-specific filters
-    float p[] = { 0.229879f, 0.540242f, 0.229879f };
-    float d[] = { -0.425287f, 0.000000f, 0.425287f };
-    
-    // lightfield derivatives
-    float Lx = 0.0f, Ly = 0.0f;
-    float Lu = 0.0f, Lv = 0.0f;
-
-    // iterate over 2D patch of pixels (3x3)
-    for (int x = 0; x < PATCH_NX; x++) {
-        for (int y = 0; y < PATCH_NY; y++) {
-            for (int u = 0; u < CAMERA_NU; u++) {
-                for (int v = 0; v < CAMERA_NV; v++) {
-                    int camIndex = u * 3 + v;
-                    int3 texOffset = int3(x - 1, y - 1, camIndex);
-
-                    float3 color = lightField[threadIdx + texOffset].rgb;
-                    float luma = BRIGHTNESS_GREY(color);
-                    
-                    // approximate derivatives using 3-tap filter
-                    Lx += d[x] * p[y] * p[u] * p[v] * luma;
-                    Ly += p[x] * d[y] * p[u] * p[v] * luma;
-                    Lu += p[x] * p[y] * d[u] * p[v] * luma;
-                    Lv += p[x] * p[y] * p[u] * d[v] * luma;
-                }
-            }
-        }
-    }
-    
-    return float4(Lx, Ly, Lu, Lv);
-}
-float2 get_disparity(float4 gradients) {
-    float a = gradients.x * gradients.z + gradients.y * gradients.w;
-    float confidence = gradients.x * gradients.x + gradients.y * gradients.y;
-    float disparity = a / confidence;
-    return float2(disparity, confidence);
-}
-
-void phase_0(int3 threadIdx) {
-    // calc and write disparities to texture
-    float4 gradients = get_gradients(threadIdx);
-    float2 disparity = get_disparity(gradients);
-    disparityTex[threadIdx.xy].xy = disparity;
-}
-void phase_1(int3 threadIdx) {
-    // sobel operator on 3x3 patch
-    float3x3 pixelPatch;
-    for (int x = 0; x < PATCH_NX; x++) {
-        for (int y = 0; y < PATCH_NY; y++) {
-            pixelPatch[x][y] = disparityTex[threadIdx.xy + int2(x - 1, y - 1)].x;
-        }
-    }
-
-    float3x3 hori = {
-        1, 0, -1,
-        2, 0, -2,
-        1, 0, -1
-    };
-    float3x3 veri = {
-        1, 2, 1,
-        0, 0, 0,
-        -1, -2, -1
-    };
-
-    // component-wise multiplication
-    hori = pixelPatch * hori;
-    veri = pixelPatch * veri;
-
-    // square component-wise (theres no dot for float3x3, only for float3)
-    float accHori = 0.0f, accVeri = 0.0f;
-    for (int i = 0; i < 3; i++) {
-        accHori += dot(hori[i], hori[i]);
-        accVeri += dot(veri[i], veri[i]);
-    }
-    float2 disparity;
-    disparity.x = sqrt(accHori + accVeri) * 0.5f;
-
-
-    float4 output;
-    output.xy = disparity;
-    output.zw = 0.0f;
-
-    float cutoff = 0.00005f * (float)pcs.nSteps;
-    if (disparity.y < cutoff) output.z = 1.0f; // show black dot for "uncertain"
-    disparityTex[threadIdx.xy] = output;
-}
+#define LIGHT_FIELD lightField
+#define GRADIENT_TEX gradientTex
+#define ESTIMATE_TEX estimateTex
+#define CUTOFF_TEX cutoffTex
+#define FILTER_TEX filterTex
+#define DISPARITY_TEX disparityTex
+// percentile of the confidence histogram (nSteps in 5% steps)
+#define CONFIDENCE_THRESHOLD stats[0].confidenceThreshold
+#include "disparity_phases.hlsli"
 
 [numthreads(GROUP_NX, GROUP_NY, 1)]
-void main(int3 threadIdx : SV_DispatchThreadID, int3 localIdx : SV_GroupThreadID)
+void main(int3 threadIdx : SV_DispatchThreadID, uint3 groupIdx : SV_GroupID, uint iLocal : SV_GroupIndex)
 {
+    // filter passes map their groups to line segments and synchronize, so they check bounds themselves
+    if (pcs.iPhase == 3) { phase_3(groupIdx.xy, iLocal); return; }
+    if (pcs.iPhase == 4) { phase_4(groupIdx.xy, iLocal); return; }
+
+    // output size is not necessarily a multiple of the group size
+    uint2 outputSize;
+    disparityTex.GetDimensions(outputSize.x, outputSize.y);
+    if (any(threadIdx.xy >= (int2)outputSize)) return;
+
     switch (pcs.iPhase) {
         case 0: phase_0(threadIdx); break;
         case 1: phase_1(threadIdx); break;
+        case 2: phase_2(threadIdx); break;
     }
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+// gradient based disparity of a single pixel, shared by the disparity phases and the queries,
+// the including shader defines LIGHT_FIELD and lightFieldSampler
+
+#define BRIGHTNESS_GREY(col) dot(col, float3(0.333333f, 0.333333f, 0.333333f)); // using standard greyscale
+#define BRIGHTNESS_REAL(col) dot(col, float3(0.299f, 0.587f, 0.114f)); // using luminance construction
+// camera patch size
+#define CAMERA_NU 3
+#define CAMERA_NV 3
+// pixel patch size
+#define PATCH_NX 3
+#define PATCH_NY 3
+
+// light field derivatives at a pixel of an output with the given size
+float4 get_gradients(int3 threadIdx, uint2 outputSize) {
+    float3 invSize = 1.0f / float3(outputSize, CAMERA_NU * CAMERA_NV);
+
+    // cam-specific filters
+    float p[] = { 0.229879f, 0.540242f, 0.229879f };
+    float d[] = { -0.425287f, 0.000000f, 0.425287f };
+    
+    // lightfield derivatives
+    float Lx = 0.0f, Ly = 0.0f;
+    float Lu = 0.0f, Lv = 0.0f;
+
+    // iterate over 2D patch of pixels (3x3)
+    for (int x = 0; x < PATCH_NX; x++) {
+        for (int y = 0; y < PATCH_NY; y++) {
+            for (int u = 0; u < CAMERA_NU; u++) {
+                for (int v = 0; v < CAMERA_NV; v++) {
+                    int camIndex = u * 3 + v;
+                    int3 texOffset = int3(x - 1, y - 1, camIndex);
+
+                    float3 texCoord = (float3(threadIdx + texOffset) + 0.5f) * invSize;
+                    float3 color = LIGHT_FIELD.SampleLevel(lightFieldSampler, texCoord, 0).rgb;
+                    float luma = BRIGHTNESS_GREY(color);
+                    
+                    // approximate derivatives using 3-tap filter
+                    Lx += d[x] * p[y] * p[u] * p[v] * luma;
+                    Ly += p[x] * d[y] * p[u] * p[v] * luma;
+                    Lu += p[x] * p[y] * d[u] * p[v] * luma;
+                    Lv += p[x] * p[y] * p[u] * d[v] * luma;
+                }
+            }
+        }
+    }
+    
+    // keep the spatial derivatives in native light field pixels, so disparities do not depend on the output resolution
+    uint3 lightFieldSize;
+    LIGHT_FIELD.GetDimensions(lightFieldSize.x, lightFieldSize.y, lightFieldSize.z);
+    float2 scale = float2(outputSize) / float2(lightFieldSize.xy);
+    return float4(Lx * scale.x, Ly * scale.y, Lu, Lv);
+}
+float2 get_disparity(float4 gradients) {
+    float a = gradients.x * gradients.z + gradients.y * gradients.w;
+    float confidence = gradients.x * gradients.x + gradients.y * gradients.y;
+    // no disparity without gradients (flat pixels, tiles skipped by the sparse estimator) instead of 0/0
+    float disparity = confidence > 0.0f ? a / confidence : 0.0f;
+    return float2(disparity, confidence);
+}
+// sobel edges of the disparities of a 3x3 pixel patch, with the disparity and confidence of its centre (the estimate of phase 1)
+float4 get_estimate(float3x3 pixelPatch, float2 disparity) {
+    float3x3 hori = {
+        1, 0, -1,
+        2, 0, -2,
+        1, 0, -1
+    };
+    float3x3 veri = {
+        1, 2, 1,
+        0, 0, 0,
+        -1, -2, -1
+    };
+
+    // component-wise multiplication
+    hori = pixelPatch * hori;
+    veri = pixelPatch * veri;
+
+    // square component-wise (theres no dot for float3x3, only for float3)
+    float accHori = 0.0f, accVeri = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        accHori += dot(hori[i], hori[i]);
+        accVeri += dot(veri[i], veri[i]);
+    }
+
+    float4 output;
+    output.x = sqrt(accHori + accVeri) * 0.5f;
+    output.y = disparity.y;
+    output.z = disparity.x;
+    output.w = 0.0f;
+    return output;
+}
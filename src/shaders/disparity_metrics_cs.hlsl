@@ -0,0 +1,102 @@
+// HCI benchmark metrics of the final disparity against ground truth, reduced per group and resolved by a single group
+Texture2D<float4> disparityTex : register(t0); // disparity edges, confidence, uncertain flag, filtered disparity
+Texture2D<float> groundTruthTex : register(t1);
+
+// mirrored by DisparityMetrics::Partial and DisparityMetrics::Metrics
+#define METRICS_THRESHOLDS 3
+static const float badPixThresholds[METRICS_THRESHOLDS] = { 0.01f, 0.03f, 0.07f };
+#define BOUNDARY_OFFSET 15 // ground truth pixels along each border that the HCI evaluation toolkit leaves out
+struct Partial { float squaredError; uint nBad[METRICS_THRESHOLDS]; uint nPixels; uint3 pad; };
+struct Metrics { float mseX100; float badPix[METRICS_THRESHOLDS]; uint nPixels; uint3 pad; };
+RWStructuredBuffer<Partial> partials : register(u2);
+RWStructuredBuffer<Metrics> metrics : register(u3);
+
+// push constant for runtime control (iPhase selects the pass)
+struct PCS { uint iPhase; uint nSteps; uint filterRadius; float filterEdges; };
+[[vk::push_constant]] PCS pcs;
+
+#define GROUP_NX 16
+#define GROUP_NY 16
+#define GROUP_N (GROUP_NX * GROUP_NY)
+
+groupshared float sharedErrors[GROUP_N];
+groupshared uint sharedBad[METRICS_THRESHOLDS];
+groupshared uint sharedPixels;
+
+void reset_shared(uint iLocal) {
+    if (iLocal < METRICS_THRESHOLDS) sharedBad[iLocal] = 0;
+    if (iLocal == 0) sharedPixels = 0;
+    GroupMemoryBarrierWithGroupSync();
+}
+// sum of squared errors over the group, valid in thread 0 (also completes the shared counters)
+float reduce_errors(uint iLocal, float value) {
+    sharedErrors[iLocal] = value;
+    GroupMemoryBarrierWithGroupSync();
+    for (uint stride = GROUP_N / 2; stride > 0; stride >>= 1) {
+        if (iLocal < stride) sharedErrors[iLocal] += sharedErrors[iLocal + stride];
+        GroupMemoryBarrierWithGroupSync();
+    }
+    return sharedErrors[0];
+}
+
+void accumulate(uint2 pixel, uint iGroup, uint iLocal) {
+    reset_shared(iLocal);
+    uint2 outputSize, groundTruthSize;
+    disparityTex.GetDimensions(outputSize.x, outputSize.y);
+    groundTruthTex.GetDimensions(groundTruthSize.x, groundTruthSize.y);
+
+    // ground truth is taken at the nearest pixel if the resolutions differ
+    float squaredError = 0.0f;
+    uint2 groundTruthPixel = min(pixel * groundTruthSize / outputSize, groundTruthSize - 1);
+    if (all(pixel < outputSize) && all(groundTruthPixel >= BOUNDARY_OFFSET) && all(groundTruthPixel + BOUNDARY_OFFSET < groundTruthSize)) {
+        float groundTruth = groundTruthTex.Load(int3(groundTruthPixel, 0));
+        float error = abs(disparityTex.Load(int3(pixel, 0)).w - groundTruth);
+        if (!isnan(groundTruth) && !isinf(groundTruth)) {
+            // missing disparities count as wrong, far beyond the benchmark disparity range
+            if (isnan(error) || isinf(error)) error = 100.0f;
+            squaredError = error * error;
+            InterlockedAdd(sharedPixels, 1);
+            for (uint i = 0; i < METRICS_THRESHOLDS; i++) {
+                if (error > badPixThresholds[i]) InterlockedAdd(sharedBad[i], 1);
+            }
+        }
+    }
+    float sum = reduce_errors(iLocal, squaredError);
+    if (iLocal != 0) return;
+    partials[iGroup].squaredError = sum;
+    for (uint i = 0; i < METRICS_THRESHOLDS; i++) partials[iGroup].nBad[i] = sharedBad[i];
+    partials[iGroup].nPixels = sharedPixels;
+}
+void resolve(uint iLocal, uint nGroups) {
+    reset_shared(iLocal);
+    float squaredError = 0.0f;
+    uint nBad[METRICS_THRESHOLDS] = { 0, 0, 0 };
+    uint nPixels = 0;
+    for (uint iGroup = iLocal; iGroup < nGroups; iGroup += GROUP_N) {
+        squaredError += partials[iGroup].squaredError;
+        for (uint i = 0; i < METRICS_THRESHOLDS; i++) nBad[i] += partials[iGroup].nBad[i];
+        nPixels += partials[iGroup].nPixels;
+    }
+    for (uint i = 0; i < METRICS_THRESHOLDS; i++) InterlockedAdd(sharedBad[i], nBad[i]);
+    InterlockedAdd(sharedPixels, nPixels);
+    float sum = reduce_errors(iLocal, squaredError);
+    if (iLocal != 0) return;
+
+    // same units as the benchmark tables: mse times 100 and percentages of bad pixels
+    float scale = 100.0f / max(sharedPixels, 1u);
+    metrics[0].mseX100 = sum * scale;
+    for (uint j = 0; j < METRICS_THRESHOLDS; j++) metrics[0].badPix[j] = sharedBad[j] * scale;
+    metrics[0].nPixels = sharedPixels;
+}
+
+[numthreads(GROUP_NX, GROUP_NY, 1)]
+void main(uint3 threadIdx : SV_DispatchThreadID, uint3 groupIdx : SV_GroupID, uint iLocal : SV_GroupIndex)
+{
+    uint2 outputSize;
+    disparityTex.GetDimensions(outputSize.x, outputSize.y);
+    uint nGroupsX = (outputSize.x + GROUP_NX - 1) / GROUP_NX;
+    uint nGroups = nGroupsX * ((outputSize.y + GROUP_NY - 1) / GROUP_NY);
+
+    if (pcs.iPhase == 0) accumulate(threadIdx.xy, groupIdx.y * nGroupsX + groupIdx.x, iLocal);
+    else resolve(iLocal, nGroups);
+}
@@ -0,0 +1,152 @@
+// disparity phases shared by the single and the batched compute shader,
+// the including shader defines LIGHT_FIELD, GRADIENT_TEX, ESTIMATE_TEX, CUTOFF_TEX, FILTER_TEX, DISPARITY_TEX, lightFieldSampler and pcs
+
+#include "disparity_gradients.hlsli"
+
+// compute group patch size, kernel variants of disparity_cs define their own (see DisparityCompute::get_kernel_variants)
+#ifndef GROUP_NX
+#define GROUP_NX 16
+#define GROUP_NY 16
+#endif
+
+void phase_0(int3 threadIdx) {
+    // calc and write gradients to texture
+    uint2 outputSize;
+    GRADIENT_TEX.GetDimensions(outputSize.x, outputSize.y);
+    GRADIENT_TEX[threadIdx.xy] = get_gradients(threadIdx, outputSize);
+}
+void phase_1(int3 threadIdx) {
+    // sobel operator on 3x3 patch
+    float3x3 pixelPatch;
+    for (int x = 0; x < PATCH_NX; x++) {
+        for (int y = 0; y < PATCH_NY; y++) {
+            pixelPatch[x][y] = get_disparity(GRADIENT_TEX[threadIdx.xy + int2(x - 1, y - 1)]).x;
+        }
+    }
+
+    ESTIMATE_TEX[threadIdx.xy] = get_estimate(pixelPatch, get_disparity(GRADIENT_TEX[threadIdx.xy]));
+}
+void phase_2(int3 threadIdx) {
+    // cheap confidence cutoff, the only phase depending on nSteps (through CONFIDENCE_THRESHOLD)
+    float4 estimate = ESTIMATE_TEX[threadIdx.xy];
+    float4 output = float4(estimate.x, estimate.y, 0.0f, estimate.z);
+
+    // show black dot for "uncertain", estimators mark pixels they did not estimate at all in the last channel
+    if (estimate.y < CONFIDENCE_THRESHOLD || estimate.w > 0.5f) output.z = 1.0f;
+    CUTOFF_TEX[threadIdx.xy] = output;
+}
+
+// edge-aware post filter: normalized convolution in the domain transform of the centre view (Gastal and Oliveira 2011),
+// weighted by confidence, as a horizontal and a vertical pass over line segments in shared memory.
+// every group loads its segment with the largest supported halo and scans it once, so the cost does not depend on the radius
+#define FILTER_MAX_RADIUS 32
+#define FILTER_THREADS (GROUP_NX * GROUP_NY)
+#define FILTER_TILE (2 * FILTER_THREADS)
+#define FILTER_SEGMENT (FILTER_TILE - 2 * FILTER_MAX_RADIUS)
+
+groupshared float filterGuide[FILTER_TILE];
+groupshared float3 filterPrefix[FILTER_TILE]; // inclusive prefix sums of domain steps, weighted disparity and weight
+groupshared float3 filterScan[FILTER_THREADS];
+
+float get_guide(int2 pixel) {
+    // luma of the centre view, which the disparity map is aligned with
+    uint2 outputSize;
+    DISPARITY_TEX.GetDimensions(outputSize.x, outputSize.y);
+    float3 texCoord = (float3(pixel, CAMERA_NU * CAMERA_NV / 2) + 0.5f) / float3(outputSize, CAMERA_NU * CAMERA_NV);
+    float3 color = LIGHT_FIELD.SampleLevel(lightFieldSampler, texCoord, 0).rgb;
+    return BRIGHTNESS_GREY(color);
+}
+// disparity and weight of a sample, uncertain samples get no weight
+float2 get_filter_sample(int2 pixel, bool vertical) {
+    if (vertical) return FILTER_TEX[pixel].xy;
+    float4 cutoff = CUTOFF_TEX[pixel];
+    return float2(cutoff.w, cutoff.z > 0.5f ? 0.0f : cutoff.y);
+}
+void filter_pass(uint2 groupIdx, uint iLocal, bool vertical) {
+    uint2 outputSize;
+    DISPARITY_TEX.GetDimensions(outputSize.x, outputSize.y);
+    int length = vertical ? outputSize.y : outputSize.x;
+    uint iLine = vertical ? groupIdx.x : groupIdx.y;
+    int iStart = (int)((vertical ? groupIdx.y : groupIdx.x) * FILTER_SEGMENT) - FILTER_MAX_RADIUS;
+    // uniform per group (batched scenes may be smaller than the dispatch)
+    if (iLine >= (vertical ? outputSize.x : outputSize.y) || iStart + FILTER_MAX_RADIUS >= length) return;
+
+    // two consecutive samples per thread, zero weight outside the image
+    float2 samples[2];
+    for (uint k = 0; k < 2; k++) {
+        uint t = 2 * iLocal + k;
+        int pos = iStart + (int)t;
+        int2 pixel = vertical ? int2(iLine, pos) : int2(pos, iLine);
+        samples[k] = 0.0f;
+        filterGuide[t] = 0.0f;
+        if (pos >= 0 && pos < length) {
+            samples[k] = get_filter_sample(pixel, vertical);
+            filterGuide[t] = get_guide(pixel);
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // every step in the transformed domain costs 1 plus the scaled guide difference, so edges separate samples
+    float3 elements[2];
+    for (uint k = 0; k < 2; k++) {
+        uint t = 2 * iLocal + k;
+        float step = 1.0f + pcs.filterEdges * abs(filterGuide[t] - filterGuide[max(t, 1) - 1]);
+        elements[k] = float3(step, samples[k].x * samples[k].y, samples[k].y);
+    }
+
+    // scan of the per thread totals (Hillis-Steele), then the prefix of each element
+    filterScan[iLocal] = elements[0] + elements[1];
+    GroupMemoryBarrierWithGroupSync();
+    for (uint offset = 1; offset < FILTER_THREADS; offset <<= 1) {
+        float3 previous = filterScan[iLocal >= offset ? iLocal - offset : 0];
+        if (iLocal < offset) previous = 0.0f;
+        GroupMemoryBarrierWithGroupSync();
+        filterScan[iLocal] += previous;
+        GroupMemoryBarrierWithGroupSync();
+    }
+    float3 base = filterScan[max(iLocal, 1) - 1];
+    if (iLocal == 0) base = 0.0f;
+    filterPrefix[2 * iLocal] = base + elements[0];
+    filterPrefix[2 * iLocal + 1] = base + elements[0] + elements[1];
+    GroupMemoryBarrierWithGroupSync();
+
+    // box of the given radius in the transformed domain, the domain grows by at least 1 per sample,
+    // so its bounds lie within the radius in samples and are found by binary search
+    int radius = (int)min(pcs.filterRadius, FILTER_MAX_RADIUS);
+    for (uint k = 0; k < 2; k++) {
+        int t = (int)(2 * iLocal + k);
+        int pos = iStart + t;
+        if (t < FILTER_MAX_RADIUS || t >= FILTER_MAX_RADIUS + FILTER_SEGMENT || pos >= length) continue;
+
+        float domain = filterPrefix[t].x;
+        int lo = t - radius, hi = t;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (filterPrefix[mid].x < domain - radius) lo = mid + 1;
+            else hi = mid;
+        }
+        int iFirst = lo;
+        lo = t; hi = t + radius;
+        while (lo < hi) {
+            int mid = (lo + hi + 1) / 2;
+            if (filterPrefix[mid].x > domain + radius) hi = mid - 1;
+            else lo = mid;
+        }
+        int iLast = lo;
+        float3 sums = filterPrefix[iLast];
+        if (iFirst > 0) sums -= filterPrefix[iFirst - 1];
+
+        // samples without any confident neighbour keep their value
+        float disparity = sums.z > 0.0f ? sums.y / sums.z : samples[k].x;
+        float weight = sums.z / (float)(iLast - iFirst + 1);
+        int2 pixel = vertical ? int2(iLine, pos) : int2(pos, iLine);
+        if (vertical) DISPARITY_TEX[pixel] = float4(CUTOFF_TEX[pixel].xyz, disparity);
+        else FILTER_TEX[pixel] = float4(disparity, weight, 0.0f, 0.0f);
+    }
+}
+void phase_3(uint2 groupIdx, uint iLocal) {
+    filter_pass(groupIdx, iLocal, false);
+}
+void phase_4(uint2 groupIdx, uint iLocal) {
+    filter_pass(groupIdx, iLocal, true);
+}
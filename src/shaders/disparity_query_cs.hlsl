@@ -0,0 +1,81 @@
+// disparity estimate at queried points and rectangles of a light field (DisparityQuery), the same gradients, disparity and sobel edges
+// as phases 0 and 1 at the native light field resolution, but only for the groups that cover the query
+Texture3D<float4> lightField : register(t0);
+SamplerState lightFieldSampler : register(s1);
+// mirrors DisparityQuery::Job, results of a rectangle tile are stored row by row with the stride of its rectangle
+struct Job { int2 origin; uint2 size; uint iResult; uint stride; uint2 pad; };
+StructuredBuffer<Job> jobs : register(t2);
+RWStructuredBuffer<float4> results : register(u3); // disparity edges, confidence, raw disparity, unused
+
+// push constant for runtime control (iPass selects points or rectangle tiles)
+struct PCS { uint iPass; uint iFirstJob; uint nJobs; uint pad; };
+[[vk::push_constant]] PCS pcs;
+
+#define LIGHT_FIELD lightField
+#include "disparity_gradients.hlsli"
+
+#define GROUP_NX 16 // matches DisparityQuery::tileSize
+#define GROUP_NY 16
+#define GROUP_N (GROUP_NX * GROUP_NY)
+#define HALO_NX (GROUP_NX + 2)
+#define HALO_NY (GROUP_NY + 2)
+
+// disparity and confidence of the tile and a one pixel halo for the sobel edges
+groupshared float2 haloDisparities[HALO_NX * HALO_NY];
+
+// pixels outside the light field have no gradients, like reads past the phase 0 output
+float2 get_pixel_disparity(int2 pixel, uint2 size) {
+    if (any(pixel < 0) || any(pixel >= (int2)size)) return 0.0f;
+    return get_disparity(get_gradients(int3(pixel, 0), size));
+}
+bool is_inside(int2 pixel, uint2 size) {
+    return all(pixel >= 0) && all(pixel < (int2)size);
+}
+
+[numthreads(GROUP_NX, GROUP_NY, 1)]
+void main(uint3 groupIdx : SV_GroupID, uint3 localIdx : SV_GroupThreadID, uint iLocal : SV_GroupIndex)
+{
+    uint3 lightFieldSize;
+    lightField.GetDimensions(lightFieldSize.x, lightFieldSize.y, lightFieldSize.z);
+    uint2 size = lightFieldSize.xy;
+
+    // points: a thread per point, each with the gradients of its own 3x3 patch
+    if (pcs.iPass == 0) {
+        uint iJob = groupIdx.x * GROUP_N + iLocal;
+        if (iJob >= pcs.nJobs) return;
+        Job job = jobs[pcs.iFirstJob + iJob];
+        float4 estimate = 0.0f;
+        if (is_inside(job.origin, size)) {
+            float3x3 pixelPatch;
+            for (int x = 0; x < PATCH_NX; x++) {
+                for (int y = 0; y < PATCH_NY; y++) {
+                    pixelPatch[x][y] = get_pixel_disparity(job.origin + int2(x - 1, y - 1), size).x;
+                }
+            }
+            estimate = get_estimate(pixelPatch, get_pixel_disparity(job.origin, size));
+        }
+        results[job.iResult] = estimate;
+        return;
+    }
+
+    // rectangle tiles: a group per tile, the gradients of the tile and its halo are computed once and shared
+    Job job = jobs[pcs.iFirstJob + groupIdx.x];
+    uint2 haloSize = job.size + 2;
+    for (uint i = iLocal; i < haloSize.x * haloSize.y; i += GROUP_N) {
+        haloDisparities[i] = get_pixel_disparity(job.origin - 1 + int2(i % haloSize.x, i / haloSize.x), size);
+    }
+    GroupMemoryBarrierWithGroupSync();
+    if (any(localIdx.xy >= job.size)) return;
+
+    float4 estimate = 0.0f;
+    if (is_inside(job.origin + (int2)localIdx.xy, size)) {
+        float3x3 pixelPatch;
+        for (int x = 0; x < PATCH_NX; x++) {
+            for (int y = 0; y < PATCH_NY; y++) {
+                pixelPatch[x][y] = haloDisparities[(localIdx.y + y) * haloSize.x + localIdx.x + x].x;
+            }
+        }
+        estimate = get_estimate(pixelPatch, haloDisparities[(localIdx.y + 1) * haloSize.x + localIdx.x + 1]);
+    }
+    results[job.iResult + localIdx.y * job.stride + localIdx.x] = estimate;
+}
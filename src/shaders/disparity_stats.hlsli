@@ -0,0 +1,30 @@
+// statistics of the disparity outputs, reduced on the gpu and read by later passes and the display without any readback
+// (mirrored by DisparityCompute::Stats)
+#define STATS_BINS 128
+// confidence spans many orders of magnitude, so its histogram has fixed bins over log2(confidence)
+#define STATS_LOG_MIN -48.0f
+#define STATS_BINS_PER_OCTAVE 2.0f
+// cutoff per step where no percentile over the whole image is available (bands of multiple devices, batches of scenes)
+#define STATS_FIXED_THRESHOLD_PER_STEP 0.00005f
+// colour map range of the certain disparities
+#define STATS_LOW_PERCENTILE 0.01f
+#define STATS_HIGH_PERCENTILE 0.99f
+
+struct DisparityStats
+{
+    uint confidenceMin, confidenceMax, disparityMin, disparityMax; // order preserving encodings (see encode_ordered)
+    float confidenceMean, confidenceThreshold, disparityMean, disparityLow;
+    float disparityHigh;
+    uint nPixels, nCertain, pad;
+    uint confidenceHistogram[STATS_BINS];
+    uint disparityHistogram[STATS_BINS]; // between disparityMin and disparityMax
+};
+
+// floats as uints that compare in the same order, for atomic min/max
+uint encode_ordered(float value) {
+    uint bits = asuint(value);
+    return (bits & 0x80000000u) != 0 ? ~bits : (bits | 0x80000000u);
+}
+float decode_ordered(uint bits) {
+    return asfloat((bits & 0x80000000u) != 0 ? (bits & 0x7fffffffu) : ~bits);
+}
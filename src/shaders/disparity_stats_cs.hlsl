@@ -0,0 +1,171 @@
+// reduction passes over the outputs of disparity_cs, sharing its descriptor set layout
+#include "disparity_stats.hlsli"
+
+RWTexture2D<float4> estimateTex : register(u2); // disparity edges, confidence, raw disparity, unused
+RWTexture2D<float4> disparityTex : register(u5); // disparity edges, confidence, uncertain flag, filtered disparity
+RWStructuredBuffer<DisparityStats> stats : register(u7);
+RWStructuredBuffer<float4> partials : register(u8); // per group: confidence sum, pixels, disparity sum, certain pixels
+
+// push constant for runtime control (iPhase selects the pass)
+struct PCS { uint iPhase; uint nSteps; uint filterRadius; float filterEdges; };
+[[vk::push_constant]] PCS pcs;
+
+#define GROUP_NX 16
+#define GROUP_NY 16
+#define GROUP_N (GROUP_NX * GROUP_NY)
+#define PASS_CLEAR_CONFIDENCE 0
+#define PASS_ACCUMULATE_CONFIDENCE 1
+#define PASS_RESOLVE_CONFIDENCE 2
+#define PASS_CLEAR_DISPARITY 3
+#define PASS_DISPARITY_RANGE 4
+#define PASS_DISPARITY_HISTOGRAM 5
+#define PASS_RESOLVE_DISPARITY 6
+#define PASS_FIXED_CONFIDENCE 7
+
+groupshared float2 sharedSums[GROUP_N];
+groupshared uint sharedMin, sharedMax;
+groupshared uint sharedHistogram[STATS_BINS];
+
+// sum over the group, valid in thread 0
+float2 reduce_sum(uint iLocal, float2 value) {
+    sharedSums[iLocal] = value;
+    GroupMemoryBarrierWithGroupSync();
+    for (uint stride = GROUP_N / 2; stride > 0; stride >>= 1) {
+        if (iLocal < stride) sharedSums[iLocal] += sharedSums[iLocal + stride];
+        GroupMemoryBarrierWithGroupSync();
+    }
+    return sharedSums[0];
+}
+// value at the given fraction of the histogram, interpolated linearly within its bin (in bin units)
+float find_percentile(uint histogram[STATS_BINS], uint total, float fraction) {
+    float target = fraction * total;
+    uint accumulated = 0;
+    for (uint i = 0; i < STATS_BINS; i++) {
+        uint count = histogram[i];
+        if (accumulated + count >= target && count > 0) return i + (target - accumulated) / count;
+        accumulated += count;
+    }
+    return STATS_BINS;
+}
+
+void clear(uint iLocal, bool confidence) {
+    if (iLocal < STATS_BINS) {
+        if (confidence) stats[0].confidenceHistogram[iLocal] = 0;
+        else stats[0].disparityHistogram[iLocal] = 0;
+    }
+    if (iLocal != 0) return;
+    if (confidence) {
+        stats[0].confidenceMin = 0xffffffffu;
+        stats[0].confidenceMax = 0;
+        stats[0].nPixels = 0;
+    } else {
+        stats[0].disparityMin = 0xffffffffu;
+        stats[0].disparityMax = 0;
+        stats[0].nCertain = 0;
+    }
+}
+void accumulate(uint2 pixel, uint iGroup, uint iLocal, uint pass) {
+    uint2 outputSize;
+    disparityTex.GetDimensions(outputSize.x, outputSize.y);
+    bool inside = all(pixel < outputSize);
+
+    // confidence of every pixel, disparity of certain pixels only
+    float value = 0.0f;
+    bool valid = inside;
+    if (inside && pass == PASS_ACCUMULATE_CONFIDENCE) value = estimateTex[pixel].y;
+    if (inside && pass != PASS_ACCUMULATE_CONFIDENCE) {
+        float4 disparity = disparityTex[pixel];
+        value = disparity.w;
+        valid = disparity.z < 0.5f && !isnan(value) && !isinf(value);
+    }
+
+    if (iLocal == 0) {
+        sharedMin = 0xffffffffu;
+        sharedMax = 0;
+    }
+    if (iLocal < STATS_BINS) sharedHistogram[iLocal] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    if (pass == PASS_DISPARITY_HISTOGRAM) {
+        float low = decode_ordered(stats[0].disparityMin);
+        float high = decode_ordered(stats[0].disparityMax);
+        uint bin = (uint)clamp((value - low) / max(high - low, 1e-6f) * STATS_BINS, 0.0f, STATS_BINS - 1.0f);
+        if (valid) InterlockedAdd(sharedHistogram[bin], 1);
+    }
+    else if (valid) {
+        InterlockedMin(sharedMin, encode_ordered(value));
+        InterlockedMax(sharedMax, encode_ordered(value));
+        if (pass == PASS_ACCUMULATE_CONFIDENCE) {
+            float octave = log2(max(value, 1e-30f)) - STATS_LOG_MIN;
+            uint bin = (uint)clamp(octave * STATS_BINS_PER_OCTAVE, 0.0f, STATS_BINS - 1.0f);
+            InterlockedAdd(sharedHistogram[bin], 1);
+        }
+    }
+    float2 sums = reduce_sum(iLocal, valid ? float2(value, 1.0f) : float2(0.0f, 0.0f));
+
+    // one atomic per group and bin instead of one per pixel
+    if (iLocal < STATS_BINS && sharedHistogram[iLocal] > 0) {
+        if (pass == PASS_ACCUMULATE_CONFIDENCE) InterlockedAdd(stats[0].confidenceHistogram[iLocal], sharedHistogram[iLocal]);
+        if (pass == PASS_DISPARITY_HISTOGRAM) InterlockedAdd(stats[0].disparityHistogram[iLocal], sharedHistogram[iLocal]);
+    }
+    if (iLocal != 0 || pass == PASS_DISPARITY_HISTOGRAM) return;
+    if (pass == PASS_ACCUMULATE_CONFIDENCE) {
+        InterlockedMin(stats[0].confidenceMin, sharedMin);
+        InterlockedMax(stats[0].confidenceMax, sharedMax);
+        partials[iGroup].xy = sums;
+    } else {
+        InterlockedMin(stats[0].disparityMin, sharedMin);
+        InterlockedMax(stats[0].disparityMax, sharedMax);
+        partials[iGroup].zw = sums;
+    }
+}
+void resolve(uint iLocal, uint nGroups, bool confidence, bool fixedThreshold = false) {
+    // sums of all group partials
+    float2 sums = 0.0f;
+    for (uint i = iLocal; i < nGroups; i += GROUP_N) sums += confidence ? partials[i].xy : partials[i].zw;
+    sums = reduce_sum(iLocal, sums);
+    if (iLocal != 0) return;
+
+    uint count = (uint)sums.y;
+    float mean = count > 0 ? sums.x / count : 0.0f;
+    if (confidence) {
+        stats[0].nPixels = count;
+        stats[0].confidenceMean = mean;
+        // nSteps marks the least confident 5% steps of the pixels as uncertain
+        float fraction = min(0.05f * pcs.nSteps, 1.0f);
+        float bin = find_percentile(stats[0].confidenceHistogram, count, fraction);
+        float threshold = exp2(STATS_LOG_MIN + bin / STATS_BINS_PER_OCTAVE);
+        threshold = clamp(threshold, decode_ordered(stats[0].confidenceMin), decode_ordered(stats[0].confidenceMax));
+        if (fixedThreshold) threshold = STATS_FIXED_THRESHOLD_PER_STEP * pcs.nSteps;
+        stats[0].confidenceThreshold = pcs.nSteps == 0 || count == 0 ? 0.0f : threshold;
+    } else {
+        stats[0].nCertain = count;
+        stats[0].disparityMean = mean;
+        float low = count > 0 ? decode_ordered(stats[0].disparityMin) : 0.0f;
+        float high = count > 0 ? decode_ordered(stats[0].disparityMax) : 1.0f;
+        float binSize = (high - low) / STATS_BINS;
+        stats[0].disparityLow = low + binSize * find_percentile(stats[0].disparityHistogram, count, STATS_LOW_PERCENTILE);
+        stats[0].disparityHigh = low + binSize * find_percentile(stats[0].disparityHistogram, count, STATS_HIGH_PERCENTILE);
+    }
+}
+
+[numthreads(GROUP_NX, GROUP_NY, 1)]
+void main(uint3 threadIdx : SV_DispatchThreadID, uint3 groupIdx : SV_GroupID, uint iLocal : SV_GroupIndex)
+{
+    // accumulation passes cover the image with one group per tile, the others run as a single group
+    uint2 outputSize;
+    disparityTex.GetDimensions(outputSize.x, outputSize.y);
+    uint nGroupsX = (outputSize.x + GROUP_NX - 1) / GROUP_NX;
+    uint nGroups = nGroupsX * ((outputSize.y + GROUP_NY - 1) / GROUP_NY);
+
+    switch (pcs.iPhase) {
+        case PASS_CLEAR_CONFIDENCE: clear(iLocal, true); break;
+        case PASS_CLEAR_DISPARITY: clear(iLocal, false); break;
+        case PASS_ACCUMULATE_CONFIDENCE:
+        case PASS_DISPARITY_RANGE:
+        case PASS_DISPARITY_HISTOGRAM: accumulate(threadIdx.xy, groupIdx.y * nGroupsX + groupIdx.x, iLocal, pcs.iPhase); break;
+        case PASS_RESOLVE_CONFIDENCE: resolve(iLocal, nGroups, true); break;
+        case PASS_RESOLVE_DISPARITY: resolve(iLocal, nGroups, false); break;
+        case PASS_FIXED_CONFIDENCE: resolve(iLocal, nGroups, true, true); break;
+    }
+}
@@ -0,0 +1,110 @@
+// epipolar plane image estimator: the horizontal and vertical EPIs through the centre view are extracted into contiguous buffers,
+// the disparity is the orientation of the structure tensor in each of them (Wanner and Goldluecke 2012)
+Texture3D<float4> lightField : register(t0);
+RWTexture2D<float4> gradientTex : register(u1); // horizontal EPI tensor (Jxx, Jxu, Juu, unused) between the passes of phase 1
+RWTexture2D<float4> estimateTex : register(u2); // disparity edges (unused), confidence, raw disparity, unused
+SamplerState lightFieldSampler : register(s6);
+// views along u (centre v) of every row as [y][u][x] and views along v (centre u) of every column as [x][v][y],
+// so that consecutive threads access consecutive elements in both passes of phase 1
+[[vk::binding(0, 1)]] RWStructuredBuffer<float> horizontalEpis;
+[[vk::binding(1, 1)]] RWStructuredBuffer<float> verticalEpis;
+
+// push constant for runtime control (iPhase selects the pass), followed by the estimator parameters
+struct PCS { uint iPhase; uint nSteps; uint filterRadius; float filterEdges; float4 parameters; uint iStep; uint3 pad; };
+[[vk::push_constant]] PCS pcs;
+#define WINDOW_RADIUS ((int)pcs.parameters.x)
+
+#define BRIGHTNESS_GREY(col) dot(col, float3(0.333333f, 0.333333f, 0.333333f));
+#define GROUP_NX 16
+#define GROUP_NY 16
+#define CAMERA_N 3 // views along u and v
+
+groupshared float transposeTile[CAMERA_N][GROUP_NY][GROUP_NX];
+
+float get_luma(int2 pixel, uint slice, uint2 outputSize) {
+    float3 texCoord = (float3(pixel, slice) + 0.5f) / float3(outputSize, CAMERA_N * CAMERA_N);
+    float3 color = lightField.SampleLevel(lightFieldSampler, texCoord, 0).rgb;
+    return BRIGHTNESS_GREY(color);
+}
+void extract(uint2 groupIdx, uint2 localIdx, uint2 outputSize) {
+    // horizontal EPIs are written along x directly
+    uint2 pixel = groupIdx * uint2(GROUP_NX, GROUP_NY) + localIdx;
+    bool inside = all(pixel < outputSize);
+    for (uint u = 0; u < CAMERA_N; u++) {
+        if (inside) horizontalEpis[(pixel.y * CAMERA_N + u) * outputSize.x + pixel.x] = get_luma(pixel, u * CAMERA_N + 1, outputSize);
+    }
+
+    // vertical EPIs go through a transposed tile, so that consecutive threads write along y
+    for (uint v = 0; v < CAMERA_N; v++) transposeTile[v][localIdx.y][localIdx.x] = get_luma(pixel, CAMERA_N + v, outputSize);
+    GroupMemoryBarrierWithGroupSync();
+    uint2 transposed = groupIdx * uint2(GROUP_NX, GROUP_NY) + localIdx.yx;
+    if (any(transposed >= outputSize)) return;
+    for (uint w = 0; w < CAMERA_N; w++) {
+        verticalEpis[(transposed.x * CAMERA_N + w) * outputSize.y + transposed.y] = transposeTile[w][localIdx.x][localIdx.y];
+    }
+}
+
+// structure tensor (Jii, Jis, Jss) at position i of an EPI of the given length along i (s being the view),
+// derivatives use the same 3-tap filters as the gradient estimator, the window is gaussian along i
+float3 get_tensor(RWStructuredBuffer<float> epis, uint iLine, int i, int epiLength, float scale) {
+    const float p[] = { 0.229879f, 0.540242f, 0.229879f };
+    const float d[] = { -0.425287f, 0.000000f, 0.425287f };
+    int radius = clamp(WINDOW_RADIUS, 0, 8);
+    float sigma = max(radius, 1) * 0.5f;
+    uint base = iLine * CAMERA_N * epiLength;
+
+    float3 tensor = 0.0f;
+    for (int k = -radius; k <= radius; k++) {
+        float Ii = 0.0f, Is = 0.0f;
+        for (int a = 0; a < 3; a++) {
+            int j = clamp(i + k + a - 1, 0, epiLength - 1);
+            for (int s = 0; s < CAMERA_N; s++) {
+                float luma = epis[base + s * epiLength + j];
+                Ii += d[a] * p[s] * luma;
+                Is += p[a] * d[s] * luma;
+            }
+        }
+        // spatial derivatives in native light field pixels, like the gradient estimator
+        Ii *= scale;
+        tensor += exp(-k * k / (2.0f * sigma * sigma)) * float3(Ii * Ii, Ii * Is, Is * Is);
+    }
+    return tensor;
+}
+// how strongly the tensor is dominated by a single orientation (0 to 1)
+float get_coherence(float3 tensor) {
+    return sqrt((tensor.z - tensor.x) * (tensor.z - tensor.x) + 4.0f * tensor.y * tensor.y) / max(tensor.x + tensor.z, 1e-12f);
+}
+
+[numthreads(GROUP_NX, GROUP_NY, 1)]
+void main(uint3 groupIdx : SV_GroupID, uint3 localIdx : SV_GroupThreadID)
+{
+    uint2 outputSize;
+    estimateTex.GetDimensions(outputSize.x, outputSize.y);
+    uint3 lightFieldSize;
+    lightField.GetDimensions(lightFieldSize.x, lightFieldSize.y, lightFieldSize.z);
+    float2 scale = float2(outputSize) / float2(lightFieldSize.xy);
+
+    if (pcs.iPhase == 0) {
+        extract(groupIdx.xy, localIdx.xy, outputSize);
+        return;
+    }
+    if (pcs.iPhase == 1) {
+        // horizontal EPIs with consecutive threads along x
+        uint2 pixel = groupIdx.xy * uint2(GROUP_NX, GROUP_NY) + localIdx.xy;
+        if (any(pixel >= outputSize)) return;
+        gradientTex[pixel] = float4(get_tensor(horizontalEpis, pixel.y, pixel.x, outputSize.x, scale.x), 0.0f);
+        return;
+    }
+
+    // vertical EPIs with consecutive threads along y, then both orientations are merged by coherence
+    uint2 pixel = groupIdx.xy * uint2(GROUP_NX, GROUP_NY) + localIdx.yx;
+    if (any(pixel >= outputSize)) return;
+    float3 horizontal = gradientTex[pixel].xyz;
+    float3 vertical = get_tensor(verticalEpis, pixel.x, pixel.y, outputSize.y, scale.y);
+    float2 coherence = float2(get_coherence(horizontal), get_coherence(vertical));
+
+    float confidence = coherence.x * horizontal.x + coherence.y * vertical.x;
+    // no disparity without structure (flat pixels) instead of 0/0, as in get_disparity
+    float disparity = confidence > 0.0f ? (coherence.x * horizontal.y + coherence.y * vertical.y) / confidence : 0.0f;
+    estimateTex[pixel] = float4(0.0f, confidence, disparity, 0.0f);
+}
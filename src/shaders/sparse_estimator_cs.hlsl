@@ -0,0 +1,99 @@
+// texture adaptive gradient estimator: a cheap pass classifies every tile by the gradient energy of the centre view and compacts
+// the textured and the flat tiles into two lists, each preceded by the arguments of an indirect dispatch over its tiles.
+// the gradients and the disparity (phases 0 and 1 of disparity_cs) only run on textured tiles, flat tiles get no confidence
+// and an explicit uncertain marker, so the cutoff flags them and the edge-aware filter fills them in from their confident neighbours
+Texture3D<float4> lightField : register(t0);
+RWTexture2D<float4> gradientTex : register(u1); // Lx, Ly, Lu, Lv
+RWTexture2D<float4> estimateTex : register(u2); // disparity edges, confidence, raw disparity, uncertain marker
+RWTexture2D<float4> cutoffTex : register(u3);
+RWTexture2D<float4> filterTex : register(u4);
+RWTexture2D<float4> disparityTex : register(u5);
+SamplerState lightFieldSampler : register(s6);
+#include "disparity_stats.hlsli"
+RWStructuredBuffer<DisparityStats> stats : register(u7);
+// dispatch arguments of the textured and the flat tiles (each followed by the length of its list), then both lists of tiles as x | y << 16
+[[vk::binding(0, 1)]] RWStructuredBuffer<uint> tiles;
+
+// push constant for runtime control (iPhase selects the pass), followed by the estimator parameters
+struct PCS { uint iPhase; uint nSteps; uint filterRadius; float filterEdges; float4 parameters; uint iStep; uint3 pad; };
+[[vk::push_constant]] PCS pcs;
+#define TEXTURE_THRESHOLD (pcs.parameters.x) // mean squared gradient of the centre view luma below which a tile is flat
+
+#define LIGHT_FIELD lightField
+#define GRADIENT_TEX gradientTex
+#define ESTIMATE_TEX estimateTex
+#define CUTOFF_TEX cutoffTex
+#define FILTER_TEX filterTex
+#define DISPARITY_TEX disparityTex
+#define CONFIDENCE_THRESHOLD stats[0].confidenceThreshold
+#include "disparity_phases.hlsli"
+
+#define TILE_ARGUMENTS 8 // matches SparseEstimator::argumentsSize
+// the lists are dispatched as rows of this many groups, far below the limit of maxComputeWorkGroupCount in any dimension
+#define TILE_GRID_X 1024
+#define TILE_THREADS (GROUP_NX * GROUP_NY)
+
+groupshared float tileEnergy[TILE_THREADS];
+
+uint2 get_tile_count(uint2 outputSize) {
+    return (outputSize + uint2(GROUP_NX - 1, GROUP_NY - 1)) / uint2(GROUP_NX, GROUP_NY);
+}
+// one group per tile, all threads take part in the reduction
+void classify(int3 threadIdx, uint2 groupIdx, uint iLocal) {
+    uint2 outputSize;
+    gradientTex.GetDimensions(outputSize.x, outputSize.y);
+    bool inside = all(threadIdx.xy < (int2)outputSize);
+
+    // central differences of the guide, which costs a single view per sample instead of the whole 3x3 camera patch
+    float energy = 0.0f;
+    if (inside) {
+        float gx = 0.5f * (get_guide(threadIdx.xy + int2(1, 0)) - get_guide(threadIdx.xy - int2(1, 0)));
+        float gy = 0.5f * (get_guide(threadIdx.xy + int2(0, 1)) - get_guide(threadIdx.xy - int2(0, 1)));
+        energy = gx * gx + gy * gy;
+    }
+    tileEnergy[iLocal] = energy;
+    GroupMemoryBarrierWithGroupSync();
+    for (uint offset = TILE_THREADS / 2; offset > 0; offset >>= 1) {
+        if (iLocal < offset) tileEnergy[iLocal] += tileEnergy[iLocal + offset];
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    // tiles at the border are partial
+    uint2 tileSize = min(uint2(GROUP_NX, GROUP_NY), outputSize - groupIdx * uint2(GROUP_NX, GROUP_NY));
+    bool textured = tileEnergy[0] / (tileSize.x * tileSize.y) > TEXTURE_THRESHOLD;
+    if (iLocal == 0) {
+        uint2 tileCount = get_tile_count(outputSize);
+        uint iArguments = textured ? 0 : 4;
+        uint iTile;
+        InterlockedAdd(tiles[iArguments + 3], 1, iTile);
+        InterlockedMax(tiles[iArguments], min(iTile + 1, TILE_GRID_X));
+        InterlockedMax(tiles[iArguments + 1], iTile / TILE_GRID_X + 1);
+        tiles[TILE_ARGUMENTS + (textured ? 0 : tileCount.x * tileCount.y) + iTile] = groupIdx.x | (groupIdx.y << 16);
+    }
+    // neighbours of flat tiles read their gradients in the disparity pass
+    if (!textured && inside) gradientTex[threadIdx.xy] = 0.0f;
+}
+
+[numthreads(GROUP_NX, GROUP_NY, 1)]
+void main(int3 threadIdx : SV_DispatchThreadID, uint3 groupIdx : SV_GroupID, uint3 localIdx : SV_GroupThreadID, uint iLocal : SV_GroupIndex)
+{
+    // classification synchronizes the group, so it checks bounds itself
+    if (pcs.iPhase == 0) { classify(threadIdx, groupIdx.xy, iLocal); return; }
+
+    // indirect passes run one group per tile of their list, the last row of groups is partial
+    uint2 outputSize;
+    gradientTex.GetDimensions(outputSize.x, outputSize.y);
+    uint2 tileCount = get_tile_count(outputSize);
+    uint iTile = groupIdx.y * TILE_GRID_X + groupIdx.x;
+    if (iTile >= tiles[pcs.iPhase == 3 ? 7 : 3]) return; // length of the list
+    uint tile = tiles[TILE_ARGUMENTS + (pcs.iPhase == 3 ? tileCount.x * tileCount.y : 0) + iTile];
+    int3 pixel = int3(uint2(tile & 0xffff, tile >> 16) * uint2(GROUP_NX, GROUP_NY) + localIdx.xy, 0);
+    if (any(pixel.xy >= (int2)outputSize)) return;
+
+    switch (pcs.iPhase) {
+        case 1: phase_0(pixel); break; // textured tiles
+        case 2: phase_1(pixel); break; // textured tiles
+        // flat tiles: no edges, confidence or disparity, and uncertain whatever the confidence threshold (even 0 with nSteps 0)
+        case 3: estimateTex[pixel.xy] = float4(0.0f, 0.0f, 0.0f, 1.0f); break;
+    }
+}
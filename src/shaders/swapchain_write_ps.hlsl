@@ -1,4 +1,10 @@
+#include "disparity_stats.hlsli"
+
 Texture2D<float4> disparityTex : register(t0);
+// disparity may be computed at a different resolution than the swapchain
+SamplerState disparitySampler : register(s1);
+// colour map range, reduced on the compute queue together with the disparity
+StructuredBuffer<DisparityStats> stats : register(t2);
 
 float4 get_heat(float val)
 {
@@ -7,12 +13,14 @@ float4 get_heat(float val)
     return float4(sin(heatLvl), sin(heatLvl * 2), cos(heatLvl), 1.0f);
 }
 
-float4 main(float4 inputPos : SV_Position) : SV_Target
+float4 main(float4 inputPos : SV_Position, float2 texCoord : TEXCOORD0) : SV_Target
 {
     // confidence cutoff
-    float4 disparity = disparityTex[(uint2)inputPos.xy];
-    // float4 heatCol = get_heat(disparity.x);
-    float4 heatCol = disparity.xxxx;
+    float4 disparity = disparityTex.SampleLevel(disparitySampler, texCoord, 0);
     if (disparity.z > 0.5f) return 0.0f;
-    return heatCol;
+
+    // filtered disparity between the 1st and 99th percentile of the certain pixels
+    float low = stats[0].disparityLow;
+    float high = stats[0].disparityHigh;
+    return get_heat(saturate((disparity.w - low) / max(high - low, 1e-6f)));
 }
@@ -1,4 +1,14 @@
-float4 main(uint vertID : SV_VertexID) : SV_Position
+struct VSOutput
 {
-    return float4((vertID == 0) ? 3.0f : -1.0f, (vertID == 2) ? -3.0f : 1.0f, 1.0f, 1.0f);
-}
\ No newline at end of file
+    float4 pos : SV_Position;
+    float2 texCoord : TEXCOORD0;
+};
+
+VSOutput main(uint vertID : SV_VertexID)
+{
+    // fullscreen triangle, texture coordinates cover [0, 1] over the visible part
+    VSOutput output;
+    output.pos = float4((vertID == 0) ? 3.0f : -1.0f, (vertID == 2) ? -3.0f : 1.0f, 1.0f, 1.0f);
+    output.texCoord = output.pos.xy * 0.5f + 0.5f;
+    return output;
+}
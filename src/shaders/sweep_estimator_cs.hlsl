@@ -0,0 +1,189 @@
+// plane sweep estimator: matching costs of every view against the centre view for a fixed set of disparity planes,
+// aggregated semi-globally (Hirschmueller 2008) along five paths in a single top to bottom sweep,
+// so that only the previous row of each path and a strip of matching and summed costs are ever stored instead of the full cost volume
+Texture3D<float4> lightField : register(t0);
+RWTexture2D<float4> gradientTex : register(u1); // winner of phase 0: disparity, confidence, aggregated cost, unused
+RWTexture2D<float4> estimateTex : register(u2); // disparity edges, confidence, raw disparity, unused
+SamplerState lightFieldSampler : register(s6);
+// path costs of the previous and the current row as [row & 1][path][x][plane], their minima over all planes as [row & 1][path][x]
+[[vk::binding(0, 1)]] RWStructuredBuffer<float> pathCosts;
+[[vk::binding(1, 1)]] RWStructuredBuffer<float> pathMinima;
+// sums of all paths for the rows of the current strip as [y % stripHeight][x][plane]
+[[vk::binding(2, 1)]] RWStructuredBuffer<float> stripCosts;
+// matching costs of the same rows in the same layout, computed once by the sweep from above and reused by the left and right paths
+[[vk::binding(3, 1)]] RWStructuredBuffer<float> stripMatches;
+
+// push constant for runtime control (iPhase selects the pass, iStep the row), followed by the estimator parameters
+struct PCS { uint iPhase; uint nSteps; uint filterRadius; float filterEdges; float4 parameters; uint iStep; uint3 pad; };
+[[vk::push_constant]] PCS pcs;
+#define DISPARITY_RANGE (pcs.parameters.x)
+#define PENALTY_NEAR (pcs.parameters.y) // P1, for disparity changes of a single plane
+#define PENALTY_FAR max(pcs.parameters.z, pcs.parameters.y) // P2, for larger jumps
+
+#define SWEEP_PLANES 64 // matches SweepEstimator::nPlanes
+#define SWEEP_ROWS 4 // columns of a row (or rows of a strip) per group
+#define SWEEP_PATHS 3 // from the top left, top and top right, left and right are aggregated per strip
+#define CAMERA_N 3 // views along u and v
+#define GROUP_NX 16
+#define GROUP_NY 16
+
+groupshared float planeCosts[SWEEP_ROWS][SWEEP_PLANES];
+groupshared float scanCosts[2][SWEEP_ROWS][SWEEP_PLANES]; // path costs of consecutive steps of a scan
+groupshared float scanTotals[2][SWEEP_ROWS][SWEEP_PLANES];
+
+float get_plane(float iPlane) {
+    return DISPARITY_RANGE * (2.0f * iPlane / (SWEEP_PLANES - 1) - 1.0f);
+}
+// mean absolute colour difference of all views to the centre view, with every view sampled where the plane maps the pixel to
+// (disparities are in native light field pixels, the bilinear sampler provides the sub-pixel shifts)
+float get_cost(int2 pixel, float disparity, uint2 outputSize, float2 scale) {
+    float3 invSize = 1.0f / float3(outputSize, CAMERA_N * CAMERA_N);
+    float3 centre = lightField.SampleLevel(lightFieldSampler, (float3(pixel, CAMERA_N * CAMERA_N / 2) + 0.5f) * invSize, 0).rgb;
+    float cost = 0.0f;
+    for (int u = 0; u < CAMERA_N; u++) {
+        for (int v = 0; v < CAMERA_N; v++) {
+            float2 shift = -disparity * float2(u - CAMERA_N / 2, v - CAMERA_N / 2) * scale;
+            float3 texCoord = (float3(pixel + shift, u * CAMERA_N + v) + 0.5f) * invSize;
+            float3 difference = abs(lightField.SampleLevel(lightFieldSampler, texCoord, 0).rgb - centre);
+            cost += dot(difference, float3(0.333333f, 0.333333f, 0.333333f));
+        }
+    }
+    return cost / (CAMERA_N * CAMERA_N - 1);
+}
+// SGM recursion: cost of the plane plus the cheapest predecessor, with penalties for changing the plane,
+// minus the minimum of the predecessors so that path costs stay bounded
+float get_path_cost(float cost, float previous, float previousNeighbours, float previousMin) {
+    return cost + min(min(previous, previousNeighbours + PENALTY_NEAR), previousMin + PENALTY_FAR) - previousMin;
+}
+// all threads of a group take part, the minimum ends up in planeCosts[iRow][0]
+void reduce_min(uint iRow, uint iPlane) {
+    for (uint offset = SWEEP_PLANES / 2; offset > 0; offset >>= 1) {
+        if (iPlane < offset) planeCosts[iRow][iPlane] = min(planeCosts[iRow][iPlane], planeCosts[iRow][iPlane + offset]);
+        GroupMemoryBarrierWithGroupSync();
+    }
+}
+
+// one row of the paths from above, every thread handles a plane of a pixel
+void aggregate_row(uint groupIdx, uint iRow, uint iPlane, uint2 outputSize, float2 scale) {
+    int x = (int)(groupIdx * SWEEP_ROWS + iRow);
+    int y = (int)pcs.iStep;
+    bool inside = x < (int)outputSize.x;
+    float cost = inside ? get_cost(int2(x, y), get_plane(iPlane), outputSize, scale) : 0.0f;
+
+    uint current = y & 1, previous = current ^ 1;
+    uint nStrip, stride;
+    stripCosts.GetDimensions(nStrip, stride);
+    float total = 0.0f;
+    for (int iPath = 0; iPath < SWEEP_PATHS; iPath++) {
+        // paths start at the image border with the plain cost
+        int xPrevious = x + iPath - 1;
+        float pathCost = cost;
+        if (inside && y > 0 && xPrevious >= 0 && xPrevious < (int)outputSize.x) {
+            uint base = ((previous * SWEEP_PATHS + iPath) * outputSize.x + xPrevious) * SWEEP_PLANES;
+            float neighbours = min(pathCosts[base + max(iPlane, 1) - 1], pathCosts[base + min(iPlane + 1, SWEEP_PLANES - 1)]);
+            float previousMin = pathMinima[(previous * SWEEP_PATHS + iPath) * outputSize.x + xPrevious];
+            pathCost = get_path_cost(cost, pathCosts[base + iPlane], neighbours, previousMin);
+        }
+        total += pathCost;
+
+        planeCosts[iRow][iPlane] = pathCost;
+        GroupMemoryBarrierWithGroupSync();
+        reduce_min(iRow, iPlane);
+        if (inside) {
+            pathCosts[((current * SWEEP_PATHS + iPath) * outputSize.x + x) * SWEEP_PLANES + iPlane] = pathCost;
+            if (iPlane == 0) pathMinima[(current * SWEEP_PATHS + iPath) * outputSize.x + x] = planeCosts[iRow][0];
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    uint stripHeight = nStrip / (outputSize.x * SWEEP_PLANES);
+    uint index = ((y % stripHeight) * outputSize.x + x) * SWEEP_PLANES + iPlane;
+    if (inside) {
+        stripCosts[index] = total;
+        stripMatches[index] = cost;
+    }
+}
+
+// left and right paths of the rows of a strip starting at pcs.iStep, each scanned sequentially by the planes of a row,
+// the right to left scan completes the sums and picks the winning plane with a parabola through its neighbours
+void aggregate_strip(uint groupIdx, uint iRow, uint iPlane, uint2 outputSize) {
+    int y = (int)(pcs.iStep + groupIdx * SWEEP_ROWS + iRow);
+    uint nStrip, stride;
+    stripCosts.GetDimensions(nStrip, stride);
+    uint stripHeight = nStrip / (outputSize.x * SWEEP_PLANES);
+    bool inside = y < (int)outputSize.y && y < (int)(pcs.iStep + stripHeight);
+    uint stripBase = (y % stripHeight) * outputSize.x * SWEEP_PLANES;
+
+    // all threads run the same number of steps (barriers), rows outside the image only skip the memory accesses
+    for (uint iScan = 0; iScan < 2; iScan++) {
+        float previousMin = 0.0f;
+        for (int i = 0; i < (int)outputSize.x; i++) {
+            int x = iScan == 0 ? i : (int)outputSize.x - 1 - i;
+            uint slot = i & 1;
+            uint index = stripBase + x * SWEEP_PLANES + iPlane;
+            float cost = inside ? stripMatches[index] : 0.0f;
+            float pathCost = cost;
+            if (i > 0) {
+                float neighbours = min(scanCosts[slot ^ 1][iRow][max(iPlane, 1) - 1], scanCosts[slot ^ 1][iRow][min(iPlane + 1, SWEEP_PLANES - 1)]);
+                pathCost = get_path_cost(cost, scanCosts[slot ^ 1][iRow][iPlane], neighbours, previousMin);
+            }
+            scanCosts[slot][iRow][iPlane] = pathCost;
+
+            // the first scan adds its path to the strip, the second one has the complete sum
+            float total = inside ? stripCosts[index] + pathCost : 0.0f;
+            if (inside && iScan == 0) stripCosts[index] = total;
+            scanTotals[slot][iRow][iPlane] = total;
+            GroupMemoryBarrierWithGroupSync();
+
+            // every thread reads the whole row of path costs (broadcasts) instead of reducing it with more barriers
+            previousMin = scanCosts[slot][iRow][0];
+            for (uint k = 1; k < SWEEP_PLANES; k++) previousMin = min(previousMin, scanCosts[slot][iRow][k]);
+            if (iScan == 0 || iPlane != 0 || !inside) continue;
+
+            uint best = 0;
+            for (uint k = 1; k < SWEEP_PLANES; k++) {
+                if (scanTotals[slot][iRow][k] < scanTotals[slot][iRow][best]) best = k;
+            }
+            float centre = scanTotals[slot][iRow][best];
+            float below = scanTotals[slot][iRow][max(best, 1) - 1];
+            float above = scanTotals[slot][iRow][min(best + 1, SWEEP_PLANES - 1)];
+            // planes at the ends of the range are not refined and get no confidence, the true disparity may lie beyond them
+            float curvature = best > 0 && best < SWEEP_PLANES - 1 ? below + above - 2.0f * centre : 0.0f;
+            float offset = curvature > 0.0f ? clamp(0.5f * (below - above) / curvature, -0.5f, 0.5f) : 0.0f;
+            gradientTex[int2(x, y)] = float4(get_plane(best + offset), curvature, centre, 0.0f);
+        }
+    }
+}
+
+// sobel magnitude of the winning disparities, like the edges of the gradient estimator
+void finish(uint2 groupIdx, uint iLocal, uint2 outputSize) {
+    int2 pixel = int2(groupIdx * uint2(GROUP_NX, GROUP_NY) + uint2(iLocal % GROUP_NX, iLocal / GROUP_NX));
+    if (any(pixel >= (int2)outputSize)) return;
+    float3x3 window;
+    for (int x = 0; x < 3; x++) {
+        for (int y = 0; y < 3; y++) {
+            window[x][y] = gradientTex[clamp(pixel + int2(x - 1, y - 1), 0, (int2)outputSize - 1)].x;
+        }
+    }
+    float horizontal = window[0][0] + 2.0f * window[0][1] + window[0][2] - window[2][0] - 2.0f * window[2][1] - window[2][2];
+    float vertical = window[0][0] + 2.0f * window[1][0] + window[2][0] - window[0][2] - 2.0f * window[1][2] - window[2][2];
+
+    float4 winner = gradientTex[pixel];
+    estimateTex[pixel] = float4(sqrt(horizontal * horizontal + vertical * vertical) * 0.5f, winner.y, winner.x, 0.0f);
+}
+
+[numthreads(SWEEP_PLANES, SWEEP_ROWS, 1)]
+void main(uint3 groupIdx : SV_GroupID, uint3 localIdx : SV_GroupThreadID)
+{
+    uint2 outputSize;
+    estimateTex.GetDimensions(outputSize.x, outputSize.y);
+    uint3 lightFieldSize;
+    lightField.GetDimensions(lightFieldSize.x, lightFieldSize.y, lightFieldSize.z);
+    float2 scale = float2(outputSize) / float2(lightFieldSize.xy);
+
+    switch (pcs.iPhase) {
+        case 0: aggregate_row(groupIdx.x, localIdx.y, localIdx.x, outputSize, scale); break;
+        case 1: aggregate_strip(groupIdx.x, localIdx.y, localIdx.x, outputSize); break;
+        default: finish(groupIdx.xy, localIdx.y * SWEEP_PLANES + localIdx.x, outputSize); break;
+    }
+}
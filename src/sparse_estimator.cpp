@@ -0,0 +1,115 @@
+#include "renderer/pipelines/sparse_estimator.hpp"
+#include "device/device_wrapper.hpp"
+#include "shaders/shaders.hpp"
+
+void SparseEstimator::init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+    vk::DescriptorSetLayout sharedLayout, vk::Extent3D extent, uint32_t nOutputs) {
+    this->extent = extent;
+    vk::Extent2D tileCount = DisparityCompute::get_group_count(0, extent);
+    nTiles = tileCount.width * tileCount.height;
+    if ((uint64_t)nTiles > (uint64_t)tileGridWidth * device.deviceProperties.limits.maxComputeWorkGroupCount[1]) VMI_ERR("Sparse dispatch exceeds the group count limit");
+    VMI_LOG("    Sparse dispatch: " << tileCount.width << "x" << tileCount.height << " tiles");
+
+    cs = ShaderManager::create_shader_module(device, sparse_estimator_cs, sizeof(sparse_estimator_cs));
+    create_buffers(allocator, nOutputs);
+    create_layout_bindings(device, descPool, nOutputs);
+    pipelineLayout = create_pipeline_layout(device, { sharedLayout, descSetLayout });
+    computePipeline = create_pipeline(device, pipelineCache, pipelineLayout, cs);
+}
+
+void SparseEstimator::destroy(DeviceWrapper& device, vma::Allocator allocator) {
+    device.logicalDevice.destroyShaderModule(cs);
+    for (auto& buffer : tileBuffers) allocator.destroyBuffer(buffer.first, buffer.second);
+    tileBuffers.clear();
+
+    // Stages
+    device.logicalDevice.destroyPipelineLayout(pipelineLayout);
+    device.logicalDevice.destroyPipeline(computePipeline);
+
+    // descriptors
+    if (!descSets.empty()) device.logicalDevice.freeDescriptorSets(descSetPool, descSets);
+    descSets.clear();
+    device.logicalDevice.destroyDescriptorSetLayout(descSetLayout);
+}
+
+void SparseEstimator::record_phase(vk::CommandBuffer commandBuffer, vk::DescriptorSet sharedSet, PushConstants pcs, uint32_t iPhase, uint32_t iOutput) {
+    vk::Buffer tileBuffer = tileBuffers[iOutput].first;
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, { sharedSet, descSets[iOutput] }, {});
+    if (iPhase == 1) {
+        // the lists were completed (and made visible to the indirect reads) in phase 0
+        commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, 2));
+        commandBuffer.dispatchIndirect(tileBuffer, 0);
+        commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, 3));
+        commandBuffer.dispatchIndirect(tileBuffer, 4 * sizeof(uint32_t));
+        return;
+    }
+
+    // empty lists, after the indirect reads of an earlier recording
+    vk::MemoryBarrier resetBarrier = vk::MemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead)
+        .setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eTransfer, {}, resetBarrier, {}, {});
+    std::array<uint32_t, argumentsSize> arguments = { 0, 1, 1, 0, 0, 1, 1, 0 };
+    commandBuffer.updateBuffer<uint32_t>(tileBuffer, 0, arguments);
+    vk::MemoryBarrier classifyBarrier = vk::MemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, classifyBarrier, {}, {});
+
+    vk::Extent2D tileCount = DisparityCompute::get_group_count(0, extent);
+    commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, 0));
+    commandBuffer.dispatch(tileCount.width, tileCount.height, 1);
+
+    // the gradients of the textured tiles need their list and its group count
+    vk::MemoryBarrier indirectBarrier = vk::MemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead);
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,
+        {}, indirectBarrier, {}, {});
+    commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, 1));
+    commandBuffer.dispatchIndirect(tileBuffer, 0);
+}
+
+void SparseEstimator::create_buffers(vma::Allocator allocator, uint32_t nOutputs) {
+    // arguments, then room for every tile in both lists
+    vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+        .setSize((argumentsSize + 2ull * nTiles) * sizeof(uint32_t))
+        .setUsage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst);
+    vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+        .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+    for (uint32_t i = 0; i < nOutputs; i++) {
+        tileBuffers.push_back(allocator.createBuffer(bufferInfo, allocCreateInfo));
+    }
+}
+
+void SparseEstimator::create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool, uint32_t nOutputs) {
+    // set 1: dispatch arguments and tile lists
+    vk::DescriptorSetLayoutBinding binding = vk::DescriptorSetLayoutBinding()
+        .setBinding(0)
+        .setDescriptorCount(1)
+        .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+        .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    vk::DescriptorSetLayoutCreateInfo createInfo = vk::DescriptorSetLayoutCreateInfo()
+        .setBindings(binding);
+    descSetLayout = device.logicalDevice.createDescriptorSetLayout(createInfo);
+
+    std::vector<vk::DescriptorSetLayout> layouts(nOutputs, descSetLayout);
+    vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
+        .setDescriptorPool(descPool)
+        .setSetLayouts(layouts);
+    descSets = device.logicalDevice.allocateDescriptorSets(allocInfo);
+    descSetPool = descPool;
+
+    for (uint32_t i = 0; i < nOutputs; i++) {
+        vk::DescriptorBufferInfo bufferInfo = vk::DescriptorBufferInfo(tileBuffers[i].first, 0, VK_WHOLE_SIZE);
+        vk::WriteDescriptorSet descBufferWrites = vk::WriteDescriptorSet()
+            .setDstSet(descSets[i])
+            .setDstBinding(0)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setBufferInfo(bufferInfo);
+        device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+    }
+}
@@ -1,16 +1,18 @@
 #include "renderer/pipelines/swapchain_write.hpp"
 #include "shaders/shaders.hpp"
 
-void SwapchainWrite::init(DeviceWrapper& device, SwapchainWrapper& swapchain, vk::DescriptorPool descPool, ImageWrapper& inputImage) {
+void SwapchainWrite::init(DeviceWrapper& device, SwapchainWrapper& swapchain, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+    std::vector<ImageWrapper*> inputImages, std::vector<vk::Buffer> statsBuffers) {
     create_shader_modules(device);
-    create_render_pass(device, swapchain, inputImage);
-    create_framebuffer(device, swapchain, inputImage);
+    create_render_pass(device, swapchain);
+    create_framebuffer(device, swapchain);
 
+    create_sampler(device, inputImages[0]->colorFormat);
     create_desc_set_layout(device);
-    create_desc_set(device, descPool, inputImage);
+    create_desc_sets(device, descPool, inputImages, statsBuffers);
 
     create_pipeline_layout(device);
-    create_pipeline(device, swapchain);
+    create_pipeline(device, swapchain, pipelineCache);
 
     fullscreenRect = vk::Rect2D({ 0, 0 }, swapchain.get_extent());
 }
@@ -22,9 +24,7 @@ void SwapchainWrite::destroy(DeviceWrapper& device) {
 
     // Render Pass
     device.logicalDevice.destroyRenderPass(renderPass);
-    for (size_t i = 0; i < framebuffers.size(); i++) {
-        device.logicalDevice.destroyFramebuffer(framebuffers[i]);
-    }
+    destroy_framebuffers(device);
 
     // Stages
     device.logicalDevice.destroyPipelineLayout(pipelineLayout);
@@ -32,6 +32,7 @@ void SwapchainWrite::destroy(DeviceWrapper& device) {
 
     // descriptors
     device.logicalDevice.destroyDescriptorSetLayout(descSetLayout);
+    device.logicalDevice.destroySampler(sampler);
 }
 
 void SwapchainWrite::create_shader_modules(DeviceWrapper& device) {
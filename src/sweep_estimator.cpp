@@ -0,0 +1,111 @@
+#include "renderer/pipelines/sweep_estimator.hpp"
+#include "device/device_wrapper.hpp"
+#include "shaders/shaders.hpp"
+
+void SweepEstimator::init(DeviceWrapper& device, vma::Allocator allocator, vk::PipelineCache pipelineCache, vk::DescriptorPool descPool,
+    vk::DescriptorSetLayout sharedLayout, vk::Extent3D extent, uint32_t nOutputs) {
+    this->extent = extent;
+    // as many rows as fit into the budget, all of them aggregated concurrently by the left and right paths
+    // (each row stores its summed and its matching costs)
+    vk::DeviceSize rowSize = 2ull * extent.width * nPlanes * sizeof(float);
+    stripHeight = (uint32_t)std::clamp<vk::DeviceSize>(stripBudget / rowSize, 1, extent.height);
+    VMI_LOG("    Plane sweep: " << nPlanes << " planes, strips of " << stripHeight << " rows (" << rowSize * stripHeight / (1 << 20) << " MiB)");
+
+    cs = ShaderManager::create_shader_module(device, sweep_estimator_cs, sizeof(sweep_estimator_cs));
+    create_buffers(allocator);
+    create_layout_bindings(device, descPool);
+    pipelineLayout = create_pipeline_layout(device, { sharedLayout, descSetLayout });
+    computePipeline = create_pipeline(device, pipelineCache, pipelineLayout, cs);
+}
+
+void SweepEstimator::destroy(DeviceWrapper& device, vma::Allocator allocator) {
+    device.logicalDevice.destroyShaderModule(cs);
+    for (auto& buffer : buffers) allocator.destroyBuffer(buffer.first, buffer.second);
+
+    // Stages
+    device.logicalDevice.destroyPipelineLayout(pipelineLayout);
+    device.logicalDevice.destroyPipeline(computePipeline);
+
+    // descriptors
+    device.logicalDevice.freeDescriptorSets(descSetPool, descSet);
+    device.logicalDevice.destroyDescriptorSetLayout(descSetLayout);
+}
+
+void SweepEstimator::record_phase(vk::CommandBuffer commandBuffer, vk::DescriptorSet sharedSet, PushConstants pcs, uint32_t iPhase, uint32_t iOutput) {
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, computePipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0, { sharedSet, descSet }, {});
+    if (iPhase == 1) {
+        commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, 2));
+        vk::Extent2D groupCount = DisparityCompute::get_group_count(0, extent);
+        commandBuffer.dispatch(groupCount.width, groupCount.height, 1);
+        return;
+    }
+
+    // every row reads the path state of the previous one, every strip reuses the sums of the previous strip
+    vk::MemoryBarrier memoryBarrier = vk::MemoryBarrier()
+        .setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite)
+        .setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+    auto barrier = [&]() {
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, memoryBarrier, {}, {});
+    };
+    for (uint32_t iFirstRow = 0; iFirstRow < extent.height; iFirstRow += stripHeight) {
+        uint32_t nRows = std::min(stripHeight, extent.height - iFirstRow);
+        for (uint32_t y = iFirstRow; y < iFirstRow + nRows; y++) {
+            if (y > 0) barrier();
+            commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, 0, y));
+            commandBuffer.dispatch((extent.width + groupRows - 1) / groupRows, 1, 1);
+        }
+        barrier();
+        commandBuffer.pushConstants<Constants>(pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, get_constants(pcs, 1, iFirstRow));
+        commandBuffer.dispatch((nRows + groupRows - 1) / groupRows, 1, 1);
+    }
+}
+
+void SweepEstimator::create_buffers(vma::Allocator allocator) {
+    std::array<vk::DeviceSize, 4> sizes = {
+        2ull * nPaths * extent.width * nPlanes * sizeof(float), // previous and current row
+        2ull * nPaths * extent.width * sizeof(float),
+        (vk::DeviceSize)stripHeight * extent.width * nPlanes * sizeof(float), // the shader derives the strip height from this size
+        (vk::DeviceSize)stripHeight * extent.width * nPlanes * sizeof(float)
+    };
+    vma::AllocationCreateInfo allocCreateInfo = vma::AllocationCreateInfo()
+        .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+    for (size_t i = 0; i < buffers.size(); i++) {
+        vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+            .setSize(sizes[i])
+            .setUsage(vk::BufferUsageFlagBits::eStorageBuffer);
+        buffers[i] = allocator.createBuffer(bufferInfo, allocCreateInfo);
+    }
+}
+
+void SweepEstimator::create_layout_bindings(DeviceWrapper& device, vk::DescriptorPool descPool) {
+    // set 1: path costs, path minima, summed and matching costs of the strip
+    std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i] = vk::DescriptorSetLayoutBinding()
+            .setBinding(i)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+    vk::DescriptorSetLayoutCreateInfo createInfo = vk::DescriptorSetLayoutCreateInfo()
+        .setBindings(bindings);
+    descSetLayout = device.logicalDevice.createDescriptorSetLayout(createInfo);
+
+    vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
+        .setDescriptorPool(descPool)
+        .setSetLayouts(descSetLayout);
+    descSet = device.logicalDevice.allocateDescriptorSets(allocInfo)[0];
+    descSetPool = descPool;
+
+    for (uint32_t i = 0; i < buffers.size(); i++) {
+        vk::DescriptorBufferInfo bufferInfo = vk::DescriptorBufferInfo(buffers[i].first, 0, VK_WHOLE_SIZE);
+        vk::WriteDescriptorSet descBufferWrites = vk::WriteDescriptorSet()
+            .setDstSet(descSet)
+            .setDstBinding(i)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setBufferInfo(bufferInfo);
+        device.logicalDevice.updateDescriptorSets(descBufferWrites, {});
+    }
+}